@@ -0,0 +1,159 @@
+/**
+  @file arena.c
+  @author Adrian Chan (amchan)
+  Region allocator that frees all its memory at once.
+*/
+
+#include "arena.h"
+#include <stdlib.h>
+
+/** Size of a normal block, in bytes.  Bigger requests get a block of
+    their own. */
+#define BLOCK_SIZE 65536
+
+/** Every allocation is rounded up to a multiple of this, so it's
+    aligned for pointers, ints and doubles. */
+#define ALIGNMENT 16
+
+/** One block of memory allocations are carved out of. */
+typedef struct BlockStruct {
+  /** Next block in the arena's list. */
+  struct BlockStruct *next;
+
+  /** Number of bytes of memory after the header. */
+  size_t size;
+} Block;
+
+/** Size of a block header, rounded up so the memory after it is
+    aligned. */
+#define HEADER_SIZE \
+  ( ( sizeof( Block ) + ALIGNMENT - 1 ) / ALIGNMENT * ALIGNMENT )
+
+/** Function to call when the arena is reset, kept in a list in the
+    arena itself. */
+typedef struct CleanupStruct {
+  void (*cleanup)( void * );
+  void *data;
+  struct CleanupStruct *next;
+} Cleanup;
+
+// Hidden implementation of the arena.
+struct ArenaStruct {
+  /** List of all the blocks, in the order they're used. */
+  Block *first;
+
+  /** Block allocations are coming from. */
+  Block *current;
+
+  /** Number of bytes used in the current block. */
+  size_t used;
+
+  /** Bytes allocated since the last reset, in blocks before current. */
+  size_t usedBefore;
+
+  /** Most bytes ever allocated between resets. */
+  size_t highWater;
+
+  /** Functions to call at the next reset, most recent first. */
+  Cleanup *cleanups;
+};
+
+/** Make a new block with room for at least the given number of bytes.
+    @param size number of bytes needed.
+    @return new block.
+*/
+static Block *makeBlock( size_t size )
+{
+  if ( size < BLOCK_SIZE )
+    size = BLOCK_SIZE;
+  Block *block = (Block *) malloc( HEADER_SIZE + size );
+  block->next = NULL;
+  block->size = size;
+  return block;
+}
+
+Arena *makeArena()
+{
+  Arena *arena = (Arena *) malloc( sizeof( Arena ) );
+  arena->first = arena->current = makeBlock( BLOCK_SIZE );
+  arena->used = 0;
+  arena->usedBefore = 0;
+  arena->highWater = 0;
+  arena->cleanups = NULL;
+  return arena;
+}
+
+void *arenaAlloc( Arena *arena, size_t size )
+{
+  size = ( size + ALIGNMENT - 1 ) / ALIGNMENT * ALIGNMENT;
+
+  if ( arena->used + size > arena->current->size ) {
+    // Move on to the next block, adding a new one if the next one
+    // isn't there or isn't big enough.
+    Block *block = arena->current;
+    if ( !block->next || block->next->size < size ) {
+      Block *fresh = makeBlock( size );
+      fresh->next = block->next;
+      block->next = fresh;
+    }
+
+    arena->usedBefore += arena->used;
+    arena->current = block->next;
+    arena->used = 0;
+  }
+
+  void *mem = (char *) arena->current + HEADER_SIZE + arena->used;
+  arena->used += size;
+
+  if ( arena->usedBefore + arena->used > arena->highWater )
+    arena->highWater = arena->usedBefore + arena->used;
+  return mem;
+}
+
+void arenaOnReset( Arena *arena, void (*cleanup)( void * ), void *data )
+{
+  Cleanup *c = (Cleanup *) arenaAlloc( arena, sizeof( Cleanup ) );
+  c->cleanup = cleanup;
+  c->data = data;
+  c->next = arena->cleanups;
+  arena->cleanups = c;
+}
+
+void resetArena( Arena *arena )
+{
+  // The cleanup list lives in the arena, so run it before anything is
+  // reused.
+  for ( Cleanup *c = arena->cleanups; c; c = c->next )
+    c->cleanup( c->data );
+  arena->cleanups = NULL;
+
+  arena->current = arena->first;
+  arena->used = 0;
+  arena->usedBefore = 0;
+}
+
+void freeArena( Arena *arena )
+{
+  resetArena( arena );
+
+  Block *block = arena->first;
+  while ( block ) {
+    Block *next = block->next;
+    free( block );
+    block = next;
+  }
+  free( arena );
+}
+
+size_t arenaHighWater( Arena const *arena )
+{
+  return arena->highWater;
+}
+
+size_t arenaReserved( Arena const *arena )
+{
+  size_t total = 0;
+  for ( Block *block = arena->first; block; block = block->next )
+    total += block->size;
+  return total;
+}
@@ -0,0 +1,65 @@
+/**
+  @file arena.h
+  @author Adrian Chan (amchan)
+
+  Region allocator for memory that all goes away at the same time, like
+  the syntax tree for a statement.  Allocations are bumped off the end
+  of large blocks, then freed all at once by resetting the arena.
+*/
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+/** A short name to use for the Arena type.  Its definition is an
+    implementation detail, not visible to client code. */
+typedef struct ArenaStruct Arena;
+
+/** Create a new, empty arena.
+    @return new, dynamically allocated arena.  The caller must
+    eventually free this with freeArena().
+*/
+Arena *makeArena();
+
+/** Allocate memory from the given arena.  The memory stays valid until
+    the arena is reset or freed.
+    @param arena arena to allocate from.
+    @param size number of bytes needed.
+    @return pointer to the new memory, aligned for any of our structs.
+*/
+void *arenaAlloc( Arena *arena, size_t size );
+
+/** Register a function to call the next time the arena is reset or
+    freed, for things in the arena that hold resources of their own.
+    @param arena arena the resource belongs to.
+    @param cleanup function to call.
+    @param data parameter to pass to cleanup.
+*/
+void arenaOnReset( Arena *arena, void (*cleanup)( void * ), void *data );
+
+/** Free everything allocated from the arena at once.  The arena keeps
+    its blocks, so they can be reused by later allocations.
+    @param arena arena to reset.
+*/
+void resetArena( Arena *arena );
+
+/** Free all the memory used by the arena.
+    @param arena arena to free.
+*/
+void freeArena( Arena *arena );
+
+/** Return the most bytes that have been allocated from the arena
+    between resets.
+    @param arena arena to report on.
+    @return high-water mark, in bytes.
+*/
+size_t arenaHighWater( Arena const *arena );
+
+/** Return the number of bytes of blocks the arena holds.
+    @param arena arena to report on.
+    @return size of all the arena's blocks, in bytes.
+*/
+size_t arenaReserved( Arena const *arena );
+
+#endif
@@ -0,0 +1,183 @@
+#!/bin/bash
+# Generate the benchmark workloads.  Each one is a script for the
+# interpreter, starting with a "# ops:" line that tells the harness how
+# many basic operations it does, so it can report operations per second.
+#
+# usage: gen.sh <output-directory> [scale]
+#
+# The scale multiplies the size of every workload (default 1).
+
+if [ $# -lt 1 ]; then
+  echo "usage: gen.sh <output-directory> [scale]" >&2
+  exit 1
+fi
+
+DIR="$1"
+SCALE="${2:-1}"
+mkdir -p "$DIR"
+
+# Tight integer loop: arithmetic and comparisons on ints only.
+N=$(( 2000000 * SCALE ))
+cat > "$DIR/intloop.txt" <<EOF
+# ops: $N
+# Tight integer loop.
+i = 0;
+s = 0;
+while ( i < $N ) {
+  s = s + i * 3 - i / 2;
+  i = i + 1;
+}
+print s;
+print "\n";
+EOF
+
+# Build a long list one push at a time.
+N=$(( 1000000 * SCALE ))
+cat > "$DIR/push.txt" <<EOF
+# ops: $N
+# Push-heavy list building.
+list = [];
+i = 0;
+while ( i < $N ) {
+  push list, i;
+  i = i + 1;
+}
+print len list;
+print "\n";
+EOF
+
+# Concatenation: appending to a string in place, copying two short
+# strings into a new one, and joining two long ones.
+N=$(( 200000 * SCALE ))
+cat > "$DIR/concat.txt" <<EOF
+# ops: $(( N * 3 ))
+# Concatenation, in place and into new sequences.
+s = "";
+w = "abc";
+big = "abcdefghij" * 30;
+n = 0;
+i = 0;
+while ( i < $N ) {
+  s = s + "ab";
+  u = w + w;
+  t = big + "xy";
+  n = n + len u;
+  n = n + len t;
+  i = i + 1;
+}
+print n + len s;
+print "\n";
+EOF
+
+# Repetition with *.
+N=$(( 200000 * SCALE ))
+cat > "$DIR/repeat.txt" <<EOF
+# ops: $N
+# Repetition of sequences with *.
+unit = "abcdefgh";
+total = 0;
+i = 0;
+while ( i < $N ) {
+  r = unit * ( i / 1000 + 1 );
+  total = total + len r;
+  i = i + 1;
+}
+print total;
+print "\n";
+EOF
+
+# Comparing long sequences of ints and of characters with == and <.
+SIZE=10000
+N=$(( 3000 * SCALE ))
+cat > "$DIR/compare.txt" <<EOF
+# ops: $(( N * 3 ))
+# Comparison of long sequences.
+a = [ 1000, 2000, 3000, 4000 ] * $(( SIZE / 4 ));
+b = [ 1000, 2000, 3000, 4000 ] * $(( SIZE / 4 ));
+a[ $(( SIZE - 1 )) ] = 1;
+s = "x" * $SIZE;
+t = "x" * $SIZE;
+n = 0;
+i = 0;
+while ( i < $N ) {
+  n = n + ( a == b ) + ( b < a ) + ( s == t );
+  i = i + 1;
+}
+print n;
+print "\n";
+EOF
+
+# Indexed reads and writes over a list.
+SIZE=1000
+N=$(( 1000 * SCALE ))
+cat > "$DIR/index.txt" <<EOF
+# ops: $(( SIZE * N * 2 ))
+# Indexed reads and writes.
+a = [ 0 ] * $SIZE;
+j = 0;
+while ( j < $N ) {
+  i = 0;
+  while ( i < $SIZE ) {
+    a[ i ] = a[ i ] + i;
+    i = i + 1;
+  }
+  j = j + 1;
+}
+print a[ $(( SIZE - 1 )) ];
+print "\n";
+EOF
+
+# Printing strings and ints.
+N=$(( 500000 * SCALE ))
+cat > "$DIR/print.txt" <<EOF
+# ops: $(( N * 3 ))
+# String and int printing.
+i = 0;
+while ( i < $N ) {
+  print "line ";
+  print i;
+  print "\n";
+  i = i + 1;
+}
+EOF
+
+# Deep nesting: a loop around a long chain of nested ifs and blocks.
+DEPTH=100
+N=$(( 20000 * SCALE ))
+{
+  echo "# ops: $(( N * DEPTH ))"
+  echo "# Deeply nested ifs and blocks."
+  echo "i = 0;"
+  echo "n = 0;"
+  echo "while ( i < $N ) {"
+  for (( d = 0; d < DEPTH; d++ )); do
+    echo "if ( $d < i + $DEPTH ) {"
+  done
+  echo "n = n + 1;"
+  for (( d = 0; d < DEPTH; d++ )); do
+    echo "}"
+  done
+  echo "i = i + 1;"
+  echo "}"
+  echo "print n;"
+  echo 'print "\n";'
+} > "$DIR/nesting.txt"
+
+# Built-in functions over a long list: adding up, searching, sorting.
+SIZE=10000
+N=$(( 300 * SCALE ))
+cat > "$DIR/builtins.txt" <<EOF2
+# ops: $(( SIZE * N * 4 ))
+# Built-in functions on a long list.
+a = [ 7000, -3, 1200, 5 ] * $(( SIZE / 4 ));
+n = 0;
+i = 0;
+while ( i < $N ) {
+  n = n + sum( a ) + count( a, 5 ) + find( a, i );
+  b = sort( a );
+  n = n + b[ 0 ];
+  i = i + 1;
+}
+print n;
+print "\n";
+EOF2
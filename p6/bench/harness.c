@@ -0,0 +1,281 @@
+/**
+  @file harness.c
+  @author Adrian Chan (amchan)
+
+  Benchmark harness for the interpreter.  It runs each workload script
+  several times and reports the median wall-clock time, the number of
+  operations per second and the peak resident set size, both as a
+  table and as a JSON file, so results from different versions can be
+  compared.
+*/
+
+// Needed for wait4(), which reports the resources used by one child.
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+/** Default number of times to run each workload. */
+#define DEFAULT_RUNS 5
+
+/** Most arguments we pass along to the interpreter. */
+#define MAX_ARGS 32
+
+/** Longest first line we look at in a workload. */
+#define LINE_LIMIT 256
+
+/** Nanoseconds in a second. */
+#define NSEC_PER_SEC 1e9
+
+/** Default file for the results. */
+#define DEFAULT_OUTPUT "bench/results.json"
+
+/** Results of running one workload. */
+typedef struct {
+  /** Name of the workload, its file name without the directory or the
+      extension. */
+  char name[ LINE_LIMIT ];
+
+  /** Workload file. */
+  char const *file;
+
+  /** Number of operations the workload does, from its "# ops:" line. */
+  long long ops;
+
+  /** Fastest, median and slowest time, in seconds. */
+  double min, median, max;
+
+  /** Largest resident set size in any run, in kilobytes. */
+  long peakRss;
+
+  /** Number of runs that didn't exit successfully. */
+  int failures;
+} Result;
+
+/** Print a usage message then exit unsuccessfully. */
+static void usage()
+{
+  fprintf( stderr, "usage: harness [-n runs] [-o results-file] "
+           "[-a interpreter-arg]... <interpreter> <workload>...\n" );
+  exit( EXIT_FAILURE );
+}
+
+/** Read the clock.
+    @return current time, in seconds.
+*/
+static double now()
+{
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec + ts.tv_nsec / NSEC_PER_SEC;
+}
+
+/** Compare two times, for sorting.
+    @param a pointer to the first time.
+    @param b pointer to the second time.
+    @return negative, zero or positive, like strcmp().
+*/
+static int compareTimes( void const *a, void const *b )
+{
+  double t1 = *(double const *) a;
+  double t2 = *(double const *) b;
+  return t1 < t2 ? -1 : t1 > t2;
+}
+
+/** Get the number of operations a workload does, from the "# ops: N"
+    line at its start.
+    @param file workload file.
+    @return number of operations, or zero if it doesn't say.
+*/
+static long long workloadOps( char const *file )
+{
+  FILE *fp = fopen( file, "r" );
+  if ( !fp )
+    return 0;
+
+  char line[ LINE_LIMIT ];
+  long long ops = 0;
+  if ( fgets( line, sizeof( line ), fp ) &&
+       sscanf( line, "# ops: %lld", &ops ) != 1 )
+    ops = 0;
+  fclose( fp );
+  return ops;
+}
+
+/** Run the interpreter once on a workload, with its output thrown away.
+    @param argv interpreter command, with a spot for the workload filled
+    in.
+    @param seconds pointer to the wall-clock time the run took.
+    @param rss pointer to the peak resident set size, in kilobytes.
+    @return true if the interpreter exited successfully.
+*/
+static bool runOnce( char *argv[], double *seconds, long *rss )
+{
+  double start = now();
+  pid_t pid = fork();
+  if ( pid < 0 ) {
+    perror( "fork" );
+    exit( EXIT_FAILURE );
+  }
+
+  if ( pid == 0 ) {
+    int fd = open( "/dev/null", O_WRONLY );
+    dup2( fd, STDOUT_FILENO );
+    dup2( fd, STDERR_FILENO );
+    close( fd );
+    execv( argv[ 0 ], argv );
+    _exit( EXIT_FAILURE );
+  }
+
+  int status;
+  struct rusage usage;
+  wait4( pid, &status, 0, &usage );
+  *seconds = now() - start;
+  *rss = usage.ru_maxrss;
+  return WIFEXITED( status ) && WEXITSTATUS( status ) == 0;
+}
+
+/** Run a workload several times and summarize the results.
+    @param argv interpreter command, with the last spot for the workload.
+    @param argc number of entries in argv, including the workload.
+    @param file workload file.
+    @param runs number of times to run it.
+    @param result results to fill in.
+*/
+static void runWorkload( char *argv[], int argc, char const *file, int runs,
+                         Result *result )
+{
+  // Name the result after the file, without its directory or extension.
+  char const *base = strrchr( file, '/' ) ? strrchr( file, '/' ) + 1 : file;
+  snprintf( result->name, sizeof( result->name ), "%s", base );
+  char *dot = strrchr( result->name, '.' );
+  if ( dot )
+    *dot = '\0';
+
+  result->file = file;
+  result->ops = workloadOps( file );
+  result->peakRss = 0;
+  result->failures = 0;
+
+  argv[ argc - 1 ] = (char *) file;
+  double times[ runs ];
+  for ( int i = 0; i < runs; i++ ) {
+    long rss;
+    if ( !runOnce( argv, &times[ i ], &rss ) )
+      result->failures++;
+    if ( rss > result->peakRss )
+      result->peakRss = rss;
+  }
+
+  qsort( times, runs, sizeof( double ), compareTimes );
+  result->min = times[ 0 ];
+  result->max = times[ runs - 1 ];
+  result->median = runs % 2 ? times[ runs / 2 ] :
+    ( times[ runs / 2 - 1 ] + times[ runs / 2 ] ) / 2;
+}
+
+/** Write a string as a JSON string literal.
+    @param fp file to write to.
+    @param str string to write.
+*/
+static void writeString( FILE *fp, char const *str )
+{
+  fputc( '"', fp );
+  for ( ; *str; str++ ) {
+    if ( *str == '"' || *str == '\\' )
+      fputc( '\\', fp );
+    fputc( *str, fp );
+  }
+  fputc( '"', fp );
+}
+
+int main( int argc, char *argv[] )
+{
+  int runs = DEFAULT_RUNS;
+  char const *output = DEFAULT_OUTPUT;
+
+  // Command to run the interpreter, with room for the workload and the
+  // null pointer at the end.
+  char *cmd[ MAX_ARGS + 3 ];
+  int cmdLen = 1;
+
+  int argPos = 1;
+  for ( ; argPos < argc && argv[ argPos ][ 0 ] == '-'; argPos++ ) {
+    if ( argPos + 1 >= argc )
+      usage();
+    if ( strcmp( argv[ argPos ], "-n" ) == 0 ) {
+      runs = atoi( argv[ ++argPos ] );
+      if ( runs < 1 )
+        usage();
+    } else if ( strcmp( argv[ argPos ], "-o" ) == 0 ) {
+      output = argv[ ++argPos ];
+    } else if ( strcmp( argv[ argPos ], "-a" ) == 0 && cmdLen <= MAX_ARGS ) {
+      cmd[ cmdLen++ ] = argv[ ++argPos ];
+    } else
+      usage();
+  }
+
+  // Then the interpreter and at least one workload.
+  if ( argc - argPos < 2 )
+    usage();
+  cmd[ 0 ] = argv[ argPos++ ];
+  cmd[ cmdLen + 1 ] = NULL;
+
+  int count = argc - argPos;
+  Result *results = (Result *) malloc( count * sizeof( Result ) );
+
+  printf( "%-12s %12s %10s %14s %10s\n", "workload", "ops", "median s",
+          "ops/sec", "peak KB" );
+  for ( int i = 0; i < count; i++ ) {
+    Result *r = &results[ i ];
+    runWorkload( cmd, cmdLen + 1, argv[ argPos + i ], runs, r );
+    printf( "%-12s %12lld %10.3f %14.0f %10ld%s\n", r->name, r->ops,
+            r->median, r->median > 0 ? r->ops / r->median : 0.0, r->peakRss,
+            r->failures ? "  FAILED" : "" );
+  }
+
+  FILE *fp = fopen( output, "w" );
+  if ( !fp ) {
+    perror( output );
+    exit( EXIT_FAILURE );
+  }
+
+  fprintf( fp, "{\n  \"interpreter\": " );
+  writeString( fp, cmd[ 0 ] );
+  fprintf( fp, ",\n  \"args\": [" );
+  for ( int i = 1; i < cmdLen; i++ ) {
+    fprintf( fp, i > 1 ? ", " : " " );
+    writeString( fp, cmd[ i ] );
+  }
+  fprintf( fp, " ],\n  \"runs\": %d,\n  \"workloads\": [\n", runs );
+  for ( int i = 0; i < count; i++ ) {
+    Result *r = &results[ i ];
+    fprintf( fp, "    { \"name\": " );
+    writeString( fp, r->name );
+    fprintf( fp, ", \"file\": " );
+    writeString( fp, r->file );
+    fprintf( fp, ", \"ops\": %lld, \"median_sec\": %.6f, \"min_sec\": %.6f, "
+             "\"max_sec\": %.6f, \"ops_per_sec\": %.0f, \"peak_rss_kb\": %ld, "
+             "\"failures\": %d }%s\n", r->ops, r->median, r->min, r->max,
+             r->median > 0 ? r->ops / r->median : 0.0, r->peakRss,
+             r->failures, i + 1 < count ? "," : "" );
+  }
+  fprintf( fp, "  ]\n}\n" );
+  fclose( fp );
+
+  // Failed runs make the whole benchmark fail, so they're noticed.
+  bool failed = false;
+  for ( int i = 0; i < count; i++ )
+    failed = failed || results[ i ].failures > 0;
+  free( results );
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,346 @@
+/**
+  @file cache.c
+  @author Adrian Chan (amchan)
+  Persistent cache of compiled programs.
+*/
+
+// Needed for getpid().
+#define _POSIX_C_SOURCE 200809L
+
+#include "cache.h"
+#include "symbol.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+/** Marker at the start of every cache file.  It reads differently on a
+    machine with the other byte order, so those files are rejected. */
+#define CACHE_MAGIC 0x50364331
+
+/** Version of the cache file layout.  Change this if the layout or the
+    meaning of any instruction changes. */
+#define CACHE_VERSION 2
+
+/** Initial capacity for the resizable buffer */
+#define INITIAL_CAPACITY 1024
+
+/** Double the capacity of an array */
+#define DOUBLE_CAPACITY 2
+
+/** Starting value for the FNV-1a hash. */
+#define FNV_OFFSET 14695981039346656037ULL
+
+/** Multiplier for the FNV-1a hash. */
+#define FNV_PRIME 1099511628211ULL
+
+/** Bytes to hold one int in the file. */
+#define WORD_SIZE sizeof( int32_t )
+
+/** Bytes to hold a hash in the file. */
+#define HASH_SIZE sizeof( uint64_t )
+
+/** A resizable block of bytes, for building the cache file in memory. */
+typedef struct {
+  /** The bytes written so far. */
+  unsigned char *data;
+
+  /** Number of bytes used in data. */
+  size_t len;
+
+  /** Capacity of data. */
+  size_t cap;
+} Buffer;
+
+/** A position in a cache file that's being read. */
+typedef struct {
+  /** Contents of the file. */
+  unsigned char const *data;
+
+  /** Number of bytes in data. */
+  size_t len;
+
+  /** Offset of the next byte to read. */
+  size_t pos;
+
+  /** False once we've tried to read past the end. */
+  bool ok;
+} Reader;
+
+/** Compute the 64-bit FNV-1a hash of a block of bytes.
+    @param data bytes to hash.
+    @param len number of bytes.
+    @return hash of the bytes.
+*/
+static uint64_t hashBytes( void const *data, size_t len )
+{
+  unsigned char const *bytes = (unsigned char const *) data;
+  uint64_t hash = FNV_OFFSET;
+  for ( size_t i = 0; i < len; i++ ) {
+    hash ^= bytes[ i ];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+/** Add some bytes to the end of a buffer.
+    @param buf buffer to add to.
+    @param data bytes to add.
+    @param len number of bytes.
+*/
+static void putBytes( Buffer *buf, void const *data, size_t len )
+{
+  if ( buf->len + len > buf->cap ) {
+    while ( buf->len + len > buf->cap )
+      buf->cap *= DOUBLE_CAPACITY;
+    buf->data = (unsigned char *) realloc( buf->data, buf->cap );
+  }
+  memcpy( buf->data + buf->len, data, len );
+  buf->len += len;
+}
+
+/** Add an int to the end of a buffer.
+    @param buf buffer to add to.
+    @param val value to add.
+*/
+static void putWord( Buffer *buf, int val )
+{
+  int32_t word = val;
+  putBytes( buf, &word, WORD_SIZE );
+}
+
+/** Read some bytes from a cache file.
+    @param r reader for the file.
+    @param len number of bytes to read.
+    @return pointer to the bytes, or null if there aren't enough left.
+*/
+static void const *getBytes( Reader *r, size_t len )
+{
+  if ( !r->ok || len > r->len - r->pos ) {
+    r->ok = false;
+    return NULL;
+  }
+  void const *bytes = r->data + r->pos;
+  r->pos += len;
+  return bytes;
+}
+
+/** Read an int from a cache file.
+    @param r reader for the file.
+    @return the value read, or zero if there wasn't one.
+*/
+static int getWord( Reader *r )
+{
+  int32_t word = 0;
+  void const *bytes = getBytes( r, WORD_SIZE );
+  if ( bytes )
+    memcpy( &word, bytes, WORD_SIZE );
+  return word;
+}
+
+/** Read a count from a cache file, making sure it's not negative and
+    that there's room left in the file for that many items.
+    @param r reader for the file.
+    @param size bytes needed for each item.
+    @return the count read, or zero if it wasn't valid.
+*/
+static int getCount( Reader *r, size_t size )
+{
+  int count = getWord( r );
+  if ( count < 0 || (size_t) count > ( r->len - r->pos ) / size ) {
+    r->ok = false;
+    return 0;
+  }
+  return count;
+}
+
+/** Read a list of ints from a cache file.
+    @param r reader for the file.
+    @param vals array to fill in.
+    @param len number of ints to read.
+*/
+static void getWords( Reader *r, int *vals, int len )
+{
+  for ( int i = 0; i < len; i++ )
+    vals[ i ] = getWord( r );
+}
+
+/** Get the name of the cache file for a program.
+    @param filename name of the program's source file.
+    @return new, dynamically allocated name of the cache file.
+*/
+static char *cacheName( char const *filename )
+{
+  char *name = (char *) malloc( strlen( filename ) + sizeof( CACHE_SUFFIX ) );
+  strcpy( name, filename );
+  strcat( name, CACHE_SUFFIX );
+  return name;
+}
+
+/** Read a whole file into memory.
+    @param name name of the file.
+    @param len pointer to the number of bytes read.
+    @return new, dynamically allocated contents of the file, or null if
+    it can't be read.
+*/
+static unsigned char *readFile( char const *name, size_t *len )
+{
+  FILE *fp = fopen( name, "rb" );
+  if ( !fp )
+    return NULL;
+
+  size_t cap = INITIAL_CAPACITY;
+  unsigned char *data = (unsigned char *) malloc( cap );
+  *len = 0;
+
+  size_t n;
+  while ( ( n = fread( data + *len, 1, cap - *len, fp ) ) > 0 ) {
+    *len += n;
+    if ( *len == cap ) {
+      cap *= DOUBLE_CAPACITY;
+      data = (unsigned char *) realloc( data, cap );
+    }
+  }
+
+  fclose( fp );
+  return data;
+}
+
+/** Write the header that says which source and settings a cache file
+    is for.
+    @param buf buffer to write to.
+    @param src source the code was compiled from.
+    @param optLevel optimization level the code was compiled at.
+*/
+static void putHeader( Buffer *buf, Source const *src, int optLevel )
+{
+  putWord( buf, CACHE_MAGIC );
+  putWord( buf, CACHE_VERSION );
+
+  // Instructions are numbered by their order in OpCode, so adding one
+  // invalidates old files.
+  putWord( buf, HaltOp );
+  putWord( buf, optLevel );
+  putWord( buf, src->size );
+  uint64_t hash = hashBytes( src->text, src->size );
+  putBytes( buf, &hash, HASH_SIZE );
+}
+
+Code *loadCache( char const *filename, Source const *src, int optLevel )
+{
+  char *name = cacheName( filename );
+  size_t len;
+  unsigned char *data = readFile( name, &len );
+  free( name );
+  if ( !data )
+    return NULL;
+
+  // The file has to start with exactly the header we'd write, and end
+  // with a checksum of everything before it.
+  Buffer header = { (unsigned char *) malloc( INITIAL_CAPACITY ), 0,
+                    INITIAL_CAPACITY };
+  putHeader( &header, src, optLevel );
+
+  uint64_t sum;
+  bool valid = len >= header.len + HASH_SIZE &&
+    memcmp( data, header.data, header.len ) == 0;
+  if ( valid ) {
+    memcpy( &sum, data + len - HASH_SIZE, HASH_SIZE );
+    valid = sum == hashBytes( data, len - HASH_SIZE );
+  }
+
+  Reader r = { data, len - HASH_SIZE, header.len, valid };
+  free( header.data );
+
+  // Give the variables the slots they had when this was compiled.
+  // Nothing else has been parsed yet, so they'll get the same numbers
+  // as long as the names are all different.
+  int vars = getCount( &r, WORD_SIZE );
+  for ( int i = 0; r.ok && i < vars; i++ ) {
+    int nameLen = getCount( &r, 1 );
+    char const *text = (char const *) getBytes( &r, nameLen );
+    if ( !text || nameLen == 0 || nameLen > MAX_VAR_NAME ||
+         variableSlot( internSymbol( text, nameLen ) ) != i )
+      r.ok = false;
+  }
+
+  Code *code = (Code *) malloc( sizeof( Code ) );
+  code->maxStack = getWord( &r );
+  code->len = code->cap = getCount( &r, WORD_SIZE );
+  code->code = (int *) malloc( ( code->cap + 1 ) * sizeof( int ) );
+  getWords( &r, code->code, code->len );
+
+  code->constCount = 0;
+  code->constCap = getCount( &r, WORD_SIZE );
+  code->consts = (Sequence **) malloc( ( code->constCap + 1 ) *
+                                       sizeof( Sequence * ) );
+  while ( r.ok && code->constCount < code->constCap ) {
+    int seqLen = getCount( &r, WORD_SIZE );
+    int *vals = (int *) malloc( ( seqLen + 1 ) * sizeof( int ) );
+    getWords( &r, vals, seqLen );
+    code->consts[ code->constCount++ ] = makeConstSequence( seqLen, vals );
+    free( vals );
+  }
+
+  // Everything should have been used, and the code shouldn't be able to
+  // make the VM read outside of its arrays.
+  free( data );
+  if ( !r.ok || r.pos != r.len || code->maxStack < 0 ||
+       !checkCode( code, variableCount() ) ) {
+    freeCode( code );
+    return NULL;
+  }
+  return code;
+}
+
+void saveCache( char const *filename, Source const *src, int optLevel,
+                Code const *code )
+{
+  Buffer buf = { (unsigned char *) malloc( INITIAL_CAPACITY ), 0,
+                 INITIAL_CAPACITY };
+  putHeader( &buf, src, optLevel );
+
+  // Names of the variables, in slot order.
+  int vars = variableCount();
+  putWord( &buf, vars );
+  for ( int i = 0; i < vars; i++ ) {
+    char const *var = variableName( i );
+    int nameLen = strlen( var );
+    putWord( &buf, nameLen );
+    putBytes( &buf, var, nameLen );
+  }
+
+  putWord( &buf, code->maxStack );
+  putWord( &buf, code->len );
+  for ( int i = 0; i < code->len; i++ )
+    putWord( &buf, code->code[ i ] );
+
+  putWord( &buf, code->constCount );
+  for ( int i = 0; i < code->constCount; i++ ) {
+    Sequence *seq = code->consts[ i ];
+    putWord( &buf, seq->len );
+    for ( int j = 0; j < seq->len; j++ )
+      putWord( &buf, sequenceElement( seq, j ) );
+  }
+
+  uint64_t sum = hashBytes( buf.data, buf.len );
+  putBytes( &buf, &sum, HASH_SIZE );
+
+  // Write to a temporary file first, then rename it into place, so
+  // another run never sees a partly written cache.
+  char *name = cacheName( filename );
+  char *temp = (char *) malloc( strlen( name ) + INITIAL_CAPACITY );
+  sprintf( temp, "%s.%ld", name, (long) getpid() );
+
+  FILE *fp = fopen( temp, "wb" );
+  if ( fp ) {
+    bool written = fwrite( buf.data, 1, buf.len, fp ) == buf.len;
+    if ( fclose( fp ) != 0 || !written || rename( temp, name ) != 0 )
+      remove( temp );
+  }
+
+  free( temp );
+  free( name );
+  free( buf.data );
+}
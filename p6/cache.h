@@ -0,0 +1,43 @@
+/**
+  @file cache.h
+  @author Adrian Chan (amchan)
+
+  Persistent cache of compiled programs.  After a whole program is
+  compiled, its bytecode is saved in a file next to the source, keyed
+  by a hash of the source text.  Later runs of the same, unchanged
+  source load the bytecode instead of tokenizing, parsing, optimizing
+  and compiling it again.
+*/
+
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+#include "compile.h"
+#include "lex.h"
+
+/** Suffix added to the program's file name to get its cache file. */
+#define CACHE_SUFFIX ".p6c"
+
+/** Load the compiled code for a program from its cache file, if there's
+    a valid one for exactly this source and optimization level.  This
+    also gives the program's variables the same slots they had when it
+    was compiled, so it must be called before anything else is parsed.
+    @param filename name of the program's source file.
+    @param src source text of the program.
+    @param optLevel optimization level the code must be compiled at.
+    @return new, dynamically allocated code, or null if there's no usable
+    cache file.
+*/
+Code *loadCache( char const *filename, Source const *src, int optLevel );
+
+/** Save the compiled code for a program to its cache file.  Failures
+    are ignored, since the cache is just an optimization.
+    @param filename name of the program's source file.
+    @param src source text the code was compiled from.
+    @param optLevel optimization level the code was compiled at.
+    @param code code to save.
+*/
+void saveCache( char const *filename, Source const *src, int optLevel,
+                Code const *code );
+
+#endif
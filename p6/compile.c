@@ -0,0 +1,352 @@
+/**
+  @file compile.c
+  @author Adrian Chan (amchan)
+  Compiler from the Stmt/Expr tree to bytecode for the virtual machine.
+*/
+
+#include "compile.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+/** Initial capacity for the resizable arrays */
+#define INITIAL_CAPACITY 5
+
+/** Double the capacity of an array */
+#define DOUBLE_CAPACITY 2
+
+/** Stack depth of the code we're currently compiling. */
+static int depth;
+
+/** Add one int (an instruction or operand) to the end of the code.
+    @param code code we're building.
+    @param val instruction or operand to add.
+    @return position of the new int in the code array.
+*/
+static int emit( Code *code, int val )
+{
+  if ( code->len >= code->cap ) {
+    code->cap *= DOUBLE_CAPACITY;
+    code->code = (int *) realloc( code->code, code->cap * sizeof( int ) );
+  }
+  code->code[ code->len ] = val;
+  return code->len++;
+}
+
+/** Keep up with the stack depth as instructions push and pop values.
+    @param code code we're building.
+    @param change net number of values pushed by the last instruction.
+*/
+static void adjustDepth( Code *code, int change )
+{
+  depth += change;
+  if ( depth > code->maxStack )
+    code->maxStack = depth;
+}
+
+/** Add a sequence to the list of constants for the code.
+    @param code code we're building.
+    @param seq constant sequence, with a reference that now belongs to
+    the code.
+    @return index of the new constant.
+*/
+static int addConstant( Code *code, Sequence *seq )
+{
+  if ( code->constCount >= code->constCap ) {
+    code->constCap *= DOUBLE_CAPACITY;
+    code->consts = (Sequence **) realloc( code->consts,
+                                          code->constCap * sizeof( Sequence * ) );
+  }
+  code->consts[ code->constCount ] = seq;
+  return code->constCount++;
+}
+
+/** Fill in the target of a jump we emitted before we knew where it
+    should go, so it jumps to the end of the code so far.
+    @param code code we're building.
+    @param pos position of the jump's target operand.
+*/
+static void patchJump( Code *code, int pos )
+{
+  code->code[ pos ] = code->len;
+}
+
+/** Emit code to evaluate the given expression, leaving its value on the
+    top of the stack.
+    @param code code we're building.
+    @param expr expression to compile.
+*/
+static void compileExpr( Code *code, Expr *expr )
+{
+  switch ( expr->kind ) {
+  case LiteralIntKind:
+    emit( code, IntOp );
+    emit( code, ( (LiteralInt *) expr )->val );
+    adjustDepth( code, 1 );
+    break;
+
+  case SeqLiteralKind: {
+    // Add this literal to the list of constants for the code.
+    Sequence *seq = ( (SeqLiteral *) expr )->seq;
+    grabSequence( seq );
+
+    emit( code, ConstOp );
+    emit( code, addConstant( code, seq ) );
+    adjustDepth( code, 1 );
+    break;
+  }
+
+  case VariableKind:
+    emit( code, LoadOp );
+    emit( code, ( (VariableExpr *) expr )->slot );
+    adjustDepth( code, 1 );
+    break;
+
+  case SeqInitKind: {
+    SequenceExpr *seq = (SequenceExpr *) expr;
+    for ( int i = 0; i < seq->len; i++ )
+      compileExpr( code, seq->expList[ i ] );
+    emit( code, SeqInitOp );
+    emit( code, seq->len );
+    adjustDepth( code, 1 - seq->len );
+    break;
+  }
+
+  case LenKind:
+    compileExpr( code, ( (SimpleExpr *) expr )->expr1 );
+    emit( code, LenOp );
+    break;
+
+  case CallKind: {
+    CallExpr *call = (CallExpr *) expr;
+    for ( int i = 0; i < call->len; i++ )
+      compileExpr( code, call->expList[ i ] );
+    emit( code, CallOp );
+    emit( code, call->fn );
+    adjustDepth( code, 1 - call->len );
+    break;
+  }
+
+  case AndKind:
+  case OrKind: {
+    // Short-circuit around the right-hand operand.
+    SimpleExpr *simple = (SimpleExpr *) expr;
+    compileExpr( code, simple->expr1 );
+    emit( code, expr->kind == AndKind ? AndOp : OrOp );
+    int target = emit( code, 0 );
+    adjustDepth( code, -1 );
+    compileExpr( code, simple->expr2 );
+    emit( code, RequireIntOp );
+    patchJump( code, target );
+    break;
+  }
+
+  default: {
+    // Everything else is a binary operator.
+    SimpleExpr *simple = (SimpleExpr *) expr;
+    compileExpr( code, simple->expr1 );
+    compileExpr( code, simple->expr2 );
+
+    static int const binaryOps[] = {
+      [ AddKind ] = AddOp, [ SubKind ] = SubOp, [ MulKind ] = MulOp,
+      [ DivKind ] = DivOp, [ LessKind ] = LessOp, [ EqualsKind ] = EqualsOp,
+      [ IndexKind ] = IndexOp
+    };
+    emit( code, binaryOps[ expr->kind ] );
+    adjustDepth( code, -1 );
+  }
+  }
+}
+
+/** Emit code to execute the given statement.  The stack is the same
+    depth before and after this code runs.
+    @param code code we're building.
+    @param stmt statement to compile.
+*/
+static void compileBody( Code *code, Stmt *stmt )
+{
+  switch ( stmt->kind ) {
+  case PrintKind:
+    compileExpr( code, ( (SimpleStmt *) stmt )->expr1 );
+    emit( code, PrintOp );
+    adjustDepth( code, -1 );
+    break;
+
+  case PushKind:
+    compileExpr( code, ( (SimpleStmt *) stmt )->expr1 );
+    compileExpr( code, ( (SimpleStmt *) stmt )->expr2 );
+    emit( code, PushOp );
+    adjustDepth( code, -2 );
+    break;
+
+  case CompoundKind: {
+    CompoundStmt *compound = (CompoundStmt *) stmt;
+    for ( int i = 0; i < compound->len; i++ )
+      compileBody( code, compound->stmtList[ i ] );
+    break;
+  }
+
+  case IfKind: {
+    ConditionalStmt *cond = (ConditionalStmt *) stmt;
+    compileExpr( code, cond->cond );
+    emit( code, JumpFalseOp );
+    int target = emit( code, 0 );
+    adjustDepth( code, -1 );
+    compileBody( code, cond->body );
+    patchJump( code, target );
+    break;
+  }
+
+  case WhileKind: {
+    // Check the condition at the top of the loop, and jump back to it
+    // at the bottom.
+    ConditionalStmt *cond = (ConditionalStmt *) stmt;
+    int top = code->len;
+    compileExpr( code, cond->cond );
+    emit( code, JumpFalseOp );
+    int target = emit( code, 0 );
+    adjustDepth( code, -1 );
+    compileBody( code, cond->body );
+    emit( code, JumpOp );
+    emit( code, top );
+    patchJump( code, target );
+    break;
+  }
+
+  case AssignmentKind: {
+    AssignmentStmt *assign = (AssignmentStmt *) stmt;
+    if ( isAddAssignment( assign->slot, assign->iexpr, assign->expr ) ) {
+      // Only the right-hand operand of the addition needs to be
+      // evaluated.
+      compileExpr( code, ( (SimpleExpr *) assign->expr )->expr2 );
+      emit( code, AddStoreOp );
+      adjustDepth( code, -1 );
+    } else if ( assign->iexpr ) {
+      compileExpr( code, assign->expr );
+      compileExpr( code, assign->iexpr );
+      emit( code, StoreIndexOp );
+      adjustDepth( code, -2 );
+    } else {
+      compileExpr( code, assign->expr );
+      emit( code, StoreOp );
+      adjustDepth( code, -1 );
+    }
+    emit( code, assign->slot );
+    break;
+  }
+  }
+}
+
+/** Make an empty block of code, ready to compile into.
+    @return new, dynamically allocated code.
+*/
+static Code *makeCode( void )
+{
+  Code *code = (Code *) malloc( sizeof( Code ) );
+  code->cap = INITIAL_CAPACITY;
+  code->len = 0;
+  code->code = (int *) malloc( code->cap * sizeof( int ) );
+  code->constCap = INITIAL_CAPACITY;
+  code->constCount = 0;
+  code->consts = (Sequence **) malloc( code->constCap * sizeof( Sequence * ) );
+  code->maxStack = 0;
+  depth = 0;
+  return code;
+}
+
+Code *compileStmt( Stmt *stmt )
+{
+  Code *code = makeCode();
+  compileBody( code, stmt );
+  emit( code, HaltOp );
+
+  return code;
+}
+
+Code *compileProgram( int len, Stmt **stmts, char const *error )
+{
+  Code *code = makeCode();
+  for ( int i = 0; i < len; i++ )
+    compileBody( code, stmts[ i ] );
+
+  // The error is reported when execution gets to it, like it would be
+  // if we were parsing one statement at a time.
+  if ( error[ 0 ] != '\0' ) {
+    int vals[ MAX_ERROR_MESSAGE ];
+    int n = 0;
+    for ( ; error[ n ]; n++ )
+      vals[ n ] = (unsigned char) error[ n ];
+    emit( code, ErrorOp );
+    emit( code, addConstant( code, makeConstSequence( n, vals ) ) );
+  }
+  emit( code, HaltOp );
+
+  return code;
+}
+
+/** Report how many operands follow each instruction in the code.
+    @param op instruction to check.
+    @return number of operands, or -1 if op isn't a valid instruction.
+*/
+static int operandCount( int op )
+{
+  switch ( op ) {
+  case IntOp: case ConstOp: case LoadOp: case StoreOp: case AddStoreOp:
+  case StoreIndexOp: case SeqInitOp: case AndOp: case OrOp: case JumpOp:
+  case JumpFalseOp: case ErrorOp: case CallOp:
+    return 1;
+  case AddOp: case SubOp: case MulOp: case DivOp: case LessOp:
+  case EqualsOp: case IndexOp: case LenOp: case RequireIntOp: case PrintOp:
+  case PushOp: case HaltOp:
+    return 0;
+  }
+  return -1;
+}
+
+bool checkCode( Code const *code, int slots )
+{
+  int pos = 0;
+  while ( pos < code->len ) {
+    int op = code->code[ pos++ ];
+    int n = operandCount( op );
+    if ( n < 0 || pos + n > code->len )
+      return false;
+
+    int arg = n > 0 ? code->code[ pos ] : 0;
+    switch ( op ) {
+    case ConstOp: case ErrorOp:
+      if ( arg < 0 || arg >= code->constCount )
+        return false;
+      break;
+    case LoadOp: case StoreOp: case AddStoreOp: case StoreIndexOp:
+      if ( arg < 0 || arg >= slots )
+        return false;
+      break;
+    case AndOp: case OrOp: case JumpOp: case JumpFalseOp:
+      if ( arg < 0 || arg >= code->len )
+        return false;
+      break;
+    case SeqInitOp:
+      if ( arg < 0 || arg > code->maxStack )
+        return false;
+      break;
+    case CallOp:
+      if ( arg < 0 || arg >= BuiltinCount ||
+           builtinArgCount( arg ) > code->maxStack )
+        return false;
+      break;
+    }
+    pos += n;
+  }
+
+  // Running off the end would go past the code array.
+  return code->len > 0 && code->code[ code->len - 1 ] == HaltOp;
+}
+
+void freeCode( Code *code )
+{
+  for ( int i = 0; i < code->constCount; i++ )
+    releaseSequence( code->consts[ i ] );
+  free( code->consts );
+  free( code->code );
+  free( code );
+}
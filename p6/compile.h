@@ -0,0 +1,129 @@
+/**
+  @file compile.h
+  @author Adrian Chan (amchan)
+
+  Compiler from the Stmt/Expr tree to a compact, linear bytecode for a
+  stack-based virtual machine.
+*/
+
+#ifndef _COMPILE_H_
+#define _COMPILE_H_
+
+#include <stdbool.h>
+
+#include "value.h"
+#include "syntax.h"
+#include "lex.h"
+
+/** Instructions for the virtual machine.  Each instruction is one int
+    in the code array, followed by its operands (if any).  Comments
+    show the operands, then the effect on the value stack. */
+typedef enum {
+  /** value: push an int. */
+  IntOp,
+  /** constant index: push a constant sequence. */
+  ConstOp,
+  /** slot: push the value of a variable. */
+  LoadOp,
+  /** slot: pop a value and store it in a variable. */
+  StoreOp,
+  /** slot: pop a value and add it to a variable, appending in place if
+      the variable holds the only reference to its sequence. */
+  AddStoreOp,
+  /** slot: pop an index, then a value, and store the value in
+      that element of the variable's sequence. */
+  StoreIndexOp,
+  /** Pop two operands and push the result of the operator. */
+  AddOp, SubOp, MulOp, DivOp, LessOp, EqualsOp,
+  /** length: pop that many elements and push a new sequence. */
+  SeqInitOp,
+  /** Pop an index and a sequence, push the element. */
+  IndexOp,
+  /** Pop a sequence, push its length. */
+  LenOp,
+  /** built-in function: pop its arguments and push its result. */
+  CallOp,
+  /** target: look at the top value (which must be an int).  If it's
+      false (AndOp) or true (OrOp), leave it and jump to the target.
+      Otherwise, pop it and fall through to the right-hand operand. */
+  AndOp, OrOp,
+  /** Make sure the top value is an int. */
+  RequireIntOp,
+  /** target: jump unconditionally. */
+  JumpOp,
+  /** target: pop a value (which must be an int) and jump if it's
+      false. */
+  JumpFalseOp,
+  /** Pop a value and print it. */
+  PrintOp,
+  /** Pop a value and a sequence, push the value onto the sequence. */
+  PushOp,
+  /** constant index: print the constant's characters as an error
+      message and exit.  This is for errors found while parsing the
+      whole program, so they're reported after the statements before
+      them run. */
+  ErrorOp,
+  /** Stop running. */
+  HaltOp
+} OpCode;
+
+/** A compiled statement, ready for the VM to run. */
+typedef struct {
+  /** Instructions and their operands. */
+  int *code;
+
+  /** Number of ints used in code. */
+  int len;
+
+  /** Capacity of the code array. */
+  int cap;
+
+  /** Constant sequences used by ConstOp.  The code holds a reference
+      to each of these. */
+  Sequence **consts;
+
+  /** Number of constants in the consts list. */
+  int constCount;
+
+  /** Capacity of the consts list. */
+  int constCap;
+
+  /** Largest number of values this code ever needs on the stack. */
+  int maxStack;
+} Code;
+
+/** Compile the given statement into bytecode.  The statement still
+    belongs to the caller.
+    @param stmt statement to compile.
+    @return new, dynamically allocated code for the statement, ending
+    with a HaltOp.
+*/
+Code *compileStmt( Stmt *stmt );
+
+/** Compile a whole program into a single block of bytecode.  The
+    statements still belong to the caller.
+    @param len number of statements in the program.
+    @param stmts list of the program's statements, in order.
+    @param error message for an error that stopped parsing after the
+    last statement, or an empty string if there wasn't one.
+    @return new, dynamically allocated code for the program, ending with
+    a HaltOp.
+*/
+Code *compileProgram( int len, Stmt **stmts, char const *error );
+
+/** Make sure code that came from outside the compiler (like a cache
+    file) can't make the VM read outside its arrays.  This checks the
+    instructions and their operands, not that the stack is used
+    correctly.
+    @param code code to check.
+    @param slots number of variable slots the code can use.
+    @return true if the code looks valid.
+*/
+bool checkCode( Code const *code, int slots );
+
+/** Free all the memory used to store the given code.
+    @param code code to free.
+*/
+void freeCode( Code *code );
+
+#endif
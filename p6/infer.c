@@ -0,0 +1,312 @@
+/**
+  @file infer.c
+  @author Adrian Chan (amchan)
+  Flow-sensitive type inference over the parsed statement tree.
+*/
+
+#include "infer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+/** Set of the types a value might have at some point in the program,
+    with a bit for each ValType. */
+typedef unsigned char TypeSet;
+
+/** A value that's always an int. */
+#define INT_TYPES ( 1 << IntType )
+
+/** A value that's always a sequence. */
+#define SEQ_TYPES ( 1 << SeqType )
+
+/** Representation of the inference state. */
+struct TypeStateStruct {
+  /** Types each variable might have after the statements analyzed so
+      far, indexed by slot. */
+  TypeSet *vars;
+
+  /** Number of slots in vars. */
+  int len;
+
+  /** Number of run-time type checks in the statements analyzed. */
+  int checks;
+
+  /** Number of those checks that were removed. */
+  int removed;
+};
+
+TypeState *makeTypeState()
+{
+  TypeState *state = (TypeState *) malloc( sizeof( TypeState ) );
+
+  // There's always a list, even with no variables, so it can be copied.
+  state->vars = (TypeSet *) malloc( sizeof( TypeSet ) );
+  state->len = 0;
+  state->checks = 0;
+  state->removed = 0;
+  return state;
+}
+
+/** Count a node that checks types at run time.
+    @param state state of the inference.
+    @param removed true if the node's checks were removed.
+*/
+static void countCheck( TypeState *state, bool removed )
+{
+  state->checks++;
+  if ( removed )
+    state->removed++;
+}
+
+/** Return the types the result of an addition might have.
+    @param t1 types of the left operand.
+    @param t2 types of the right operand.
+    @return types of the sum or concatenation.
+*/
+static TypeSet addTypes( TypeSet t1, TypeSet t2 )
+{
+  if ( !t1 || !t2 )
+    return 0;
+
+  // Two ints give an int, and anything with a sequence gives a
+  // sequence.
+  TypeSet result = 0;
+  if ( ( t1 & INT_TYPES ) && ( t2 & INT_TYPES ) )
+    result |= INT_TYPES;
+  if ( ( t1 | t2 ) & SEQ_TYPES )
+    result |= SEQ_TYPES;
+  return result;
+}
+
+/** Return the types the result of a multiplication might have.
+    @param t1 types of the left operand.
+    @param t2 types of the right operand.
+    @return types of the product or repeated sequence.
+*/
+static TypeSet mulTypes( TypeSet t1, TypeSet t2 )
+{
+  // Two ints give an int, and a sequence and an int give a sequence.
+  // Two sequences are an error.
+  TypeSet result = 0;
+  if ( ( t1 & INT_TYPES ) && ( t2 & INT_TYPES ) )
+    result |= INT_TYPES;
+  if ( ( ( t1 & SEQ_TYPES ) && ( t2 & INT_TYPES ) ) ||
+       ( ( t1 & INT_TYPES ) && ( t2 & SEQ_TYPES ) ) )
+    result |= SEQ_TYPES;
+  return result;
+}
+
+/** Infer the types of an expression.  Evaluating an expression can't
+    change any variables, and if it fails with a type error, the program
+    stops, so the operators that require ints always give an int.
+    @param state state of the inference.
+    @param vars types of the variables where the expression is
+    evaluated.
+    @param expr expression to analyze.
+    @param apply true if the types are final, so nodes can be changed to
+    versions without type checks.
+    @return types the expression might evaluate to.
+*/
+static TypeSet exprTypes( TypeState *state, TypeSet const *vars,
+                          Expr *expr, bool apply )
+{
+  switch ( expr->kind ) {
+  case LiteralIntKind:
+    return INT_TYPES;
+
+  case SeqLiteralKind:
+    return SEQ_TYPES;
+
+  case VariableKind:
+    return vars[ ( (VariableExpr *) expr )->slot ];
+
+  case SeqInitKind: {
+    SequenceExpr *seq = (SequenceExpr *) expr;
+    for ( int i = 0; i < seq->len; i++ )
+      exprTypes( state, vars, seq->expList[ i ], apply );
+    return SEQ_TYPES;
+  }
+
+  case CallKind: {
+    CallExpr *call = (CallExpr *) expr;
+    for ( int i = 0; i < call->len; i++ )
+      exprTypes( state, vars, call->expList[ i ], apply );
+    return builtinGivesInt( call->fn ) ? INT_TYPES : SEQ_TYPES;
+  }
+
+  default:
+    break;
+  }
+
+  SimpleExpr *this = (SimpleExpr *) expr;
+  TypeSet t1 = exprTypes( state, vars, this->expr1, apply );
+  TypeSet t2 = this->expr2 ?
+    exprTypes( state, vars, this->expr2, apply ) : 0;
+
+  // Most operators need two ints and give an int.
+  TypeSet result = INT_TYPES;
+  bool known = t1 == INT_TYPES && t2 == INT_TYPES;
+  switch ( expr->kind ) {
+  case AddKind:
+    result = addTypes( t1, t2 );
+    break;
+
+  case MulKind:
+    result = mulTypes( t1, t2 );
+    break;
+
+  case IndexKind:
+    known = t1 == SEQ_TYPES && t2 == INT_TYPES;
+    break;
+
+  case LenKind:
+    known = t1 == SEQ_TYPES;
+    break;
+
+  default:
+    break;
+  }
+
+  if ( apply )
+    countCheck( state, known && uncheckExpr( expr ) );
+  return result;
+}
+
+/** Add the types in one list of variables to another.
+    @param dest types to add to.
+    @param src types to add.
+    @param len number of variables in each list.
+    @return true if any of the types in dest changed.
+*/
+static bool joinTypes( TypeSet *dest, TypeSet const *src, int len )
+{
+  bool changed = false;
+  for ( int i = 0; i < len; i++ ) {
+    changed = changed || ( dest[ i ] | src[ i ] ) != dest[ i ];
+    dest[ i ] |= src[ i ];
+  }
+  return changed;
+}
+
+/** Infer the types in a statement, updating the types of the variables
+    to the ones they might have after it runs.
+    @param state state of the inference.
+    @param vars types of the variables before the statement, updated for
+    after it.
+    @param stmt statement to analyze.
+    @param apply true if the types are final, so nodes can be changed to
+    versions without type checks.
+*/
+static void stmtTypes( TypeState *state, TypeSet *vars, Stmt *stmt,
+                       bool apply )
+{
+  size_t size = state->len * sizeof( TypeSet );
+
+  switch ( stmt->kind ) {
+  case PrintKind:
+    exprTypes( state, vars, ( (SimpleStmt *) stmt )->expr1, apply );
+    break;
+
+  case PushKind: {
+    SimpleStmt *this = (SimpleStmt *) stmt;
+    TypeSet t1 = exprTypes( state, vars, this->expr1, apply );
+    TypeSet t2 = exprTypes( state, vars, this->expr2, apply );
+    if ( apply )
+      countCheck( state, t1 == SEQ_TYPES && t2 == INT_TYPES &&
+                  uncheckStmt( stmt ) );
+    break;
+  }
+
+  case AssignmentKind: {
+    AssignmentStmt *this = (AssignmentStmt *) stmt;
+    if ( this->iexpr ) {
+      // Changing an element leaves the variable a sequence.
+      exprTypes( state, vars, this->expr, apply );
+      exprTypes( state, vars, this->iexpr, apply );
+    } else if ( isAddAssignment( this->slot, this->iexpr, this->expr ) ) {
+      // Only the right-hand operand of the addition is evaluated.
+      Expr *operand = ( (SimpleExpr *) this->expr )->expr2;
+      TypeSet t = exprTypes( state, vars, operand, apply );
+      if ( apply )
+        countCheck( state, vars[ this->slot ] == INT_TYPES &&
+                    t == INT_TYPES && uncheckStmt( stmt ) );
+      vars[ this->slot ] = addTypes( vars[ this->slot ], t );
+    } else {
+      vars[ this->slot ] = exprTypes( state, vars, this->expr, apply );
+    }
+    break;
+  }
+
+  case CompoundKind: {
+    CompoundStmt *this = (CompoundStmt *) stmt;
+    for ( int i = 0; i < this->len; i++ )
+      stmtTypes( state, vars, this->stmtList[ i ], apply );
+    break;
+  }
+
+  case IfKind: {
+    // Afterward, the variables have the types from either running the
+    // body or not.
+    ConditionalStmt *this = (ConditionalStmt *) stmt;
+    TypeSet cond = exprTypes( state, vars, this->cond, apply );
+    if ( apply )
+      countCheck( state, cond == INT_TYPES && uncheckStmt( stmt ) );
+
+    TypeSet *body = (TypeSet *) malloc( size + 1 );
+    memcpy( body, vars, size );
+    stmtTypes( state, body, this->body, apply );
+    joinTypes( vars, body, state->len );
+    free( body );
+    break;
+  }
+
+  case WhileKind: {
+    // Find the types the variables might have each time the condition
+    // is checked, by running through the body until they stop
+    // changing.  A type is never removed, so this finishes quickly.
+    ConditionalStmt *this = (ConditionalStmt *) stmt;
+    TypeSet *body = (TypeSet *) malloc( size + 1 );
+    bool changed = true;
+    while ( changed ) {
+      memcpy( body, vars, size );
+      stmtTypes( state, body, this->body, false );
+      changed = joinTypes( vars, body, state->len );
+    }
+
+    // Now the types are final for the condition and the body.
+    TypeSet cond = exprTypes( state, vars, this->cond, apply );
+    if ( apply ) {
+      countCheck( state, cond == INT_TYPES && uncheckStmt( stmt ) );
+      memcpy( body, vars, size );
+      stmtTypes( state, body, this->body, true );
+    }
+    free( body );
+    break;
+  }
+  }
+}
+
+void inferTypes( TypeState *state, Stmt *stmt )
+{
+  // Variables we haven't seen yet start out as zero.
+  int len = variableCount();
+  if ( len > state->len ) {
+    state->vars = (TypeSet *) realloc( state->vars, len * sizeof( TypeSet ) );
+    memset( state->vars + state->len, INT_TYPES, len - state->len );
+    state->len = len;
+  }
+
+  stmtTypes( state, state->vars, stmt, true );
+}
+
+void reportTypes( FILE *fp, TypeState const *state )
+{
+  fprintf( fp, "types: removed %d of %d run-time type checks\n",
+           state->removed, state->checks );
+}
+
+void freeTypeState( TypeState *state )
+{
+  free( state->vars );
+  free( state );
+}
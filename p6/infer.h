@@ -0,0 +1,51 @@
+/**
+  @file infer.h
+  @author Adrian Chan (amchan)
+
+  Flow-sensitive type inference over the parsed statement tree.  It
+  follows the program from one statement to the next, keeping track of
+  the types each variable might have at each point.  Wherever that
+  proves an expression's or statement's operands will have the types
+  it needs, the node is switched to a version without run-time type
+  checks.  Everywhere else, the checks stay.
+*/
+
+#ifndef _INFER_H_
+#define _INFER_H_
+
+#include <stdio.h>
+
+#include "syntax.h"
+
+/** A short name for the state of the inference. */
+typedef struct TypeStateStruct TypeState;
+
+/** Make the state for inferring the types in a program, from its
+    start, where every variable is an int (zero).
+    @return new, dynamically allocated state.
+*/
+TypeState *makeTypeState();
+
+/** Infer the types in the next top-level statement of the program, and
+    remove the type checks it doesn't need.  Statements must be given in
+    the order they run, after they're optimized.  Each statement is
+    analyzed using the types of the variables after all the statements
+    before it, and then those types are updated for the statement.
+    @param state state of the inference, updated for this statement.
+    @param stmt next statement in the program.
+*/
+void inferTypes( TypeState *state, Stmt *stmt );
+
+/** Print how many of the run-time type checks in the statements
+    analyzed so far were removed.
+    @param fp file to print the report to.
+    @param state state of the inference.
+*/
+void reportTypes( FILE *fp, TypeState const *state );
+
+/** Free the memory used by the inference state.
+    @param state state to free.
+*/
+void freeTypeState( TypeState *state );
+
+#endif
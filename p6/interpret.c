@@ -7,20 +7,314 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdbool.h>
 
 #include "value.h"
 #include "syntax.h"
 #include "parse.h"
+#include "ops.h"
+#include "compile.h"
+#include "optimize.h"
+#include "cache.h"
+#include "profile.h"
+#include "stats.h"
+#include "infer.h"
+#include "jit.h"
+#include "translate.h"
+
+/** True if two values are both ints.  Arithmetic and comparisons on
+    two ints are done right in the VM, and anything else is left to the
+    ops. */
+#define BOTH_INTS( v1, v2 ) ( isInt( v1 ) && isInt( v2 ) )
 
-/** Length of argc with one user input from the command line */
-#define ONE_CMD_INPUT 2
 /** Print a usage message then exit unsuccessfully. */
 void usage()
 {
-  fprintf( stderr, "usage: interpret <program-file>\n" );
+  fprintf( stderr, "usage: interpret [--tree] [--jit] [--emit-c] [-O0|-O1] [--whole] [--cache] [--profile] [--stats] [--verbose] <program-file>\n" );
   exit( EXIT_FAILURE );
 }
 
+/** Run compiled code on the virtual machine.
+    @param code bytecode for the statement to run.
+    @param env current values of all variables.
+*/
+static void runCode( Code const *code, Environment *env )
+{
+  // Stack of values computed by the instructions.
+  Value *stack = (Value *) malloc( ( code->maxStack + 1 ) * sizeof( Value ) );
+  int sp = 0;
+
+  int const *pc = code->code;
+  while ( true ) {
+    switch ( *pc++ ) {
+    case IntOp:
+      stack[ sp++ ] = intValue( *pc++ );
+      break;
+
+    case ConstOp: {
+      Sequence *seq = code->consts[ *pc++ ];
+      grabSequence( seq );
+      stack[ sp++ ] = seqValue( seq );
+      break;
+    }
+
+    case LoadOp: {
+      Value val = lookupVariable( env, *pc++ );
+      if ( isSeq( val ) )
+        grabSequence( valueSeq( val ) );
+      stack[ sp++ ] = val;
+      break;
+    }
+
+    case StoreOp: {
+      Value val = stack[ --sp ];
+      setVariable( env, *pc++, val );
+      if ( isSeq( val ) )
+        releaseSequence( valueSeq( val ) );
+      break;
+    }
+
+    case AddStoreOp:
+      addAssignValue( env, *pc++, stack[ --sp ] );
+      break;
+
+    case StoreIndexOp: {
+      Value idx = stack[ --sp ];
+      Value val = stack[ --sp ];
+      Value seq = lookupVariable( env, *pc++ );
+      storeIndexValue( seq, idx, val );
+      if ( isSeq( val ) )
+        releaseSequence( valueSeq( val ) );
+      break;
+    }
+
+    case AddOp:
+      sp--;
+      if ( BOTH_INTS( stack[ sp - 1 ], stack[ sp ] ) )
+        stack[ sp - 1 ] =
+          intValue( valueInt( stack[ sp - 1 ] ) + valueInt( stack[ sp ] ) );
+      else
+        stack[ sp - 1 ] = addValues( stack[ sp - 1 ], stack[ sp ] );
+      break;
+
+    case SubOp:
+      sp--;
+      if ( BOTH_INTS( stack[ sp - 1 ], stack[ sp ] ) )
+        stack[ sp - 1 ] =
+          intValue( valueInt( stack[ sp - 1 ] ) - valueInt( stack[ sp ] ) );
+      else
+        stack[ sp - 1 ] = subValues( stack[ sp - 1 ], stack[ sp ] );
+      break;
+
+    case MulOp:
+      sp--;
+      if ( BOTH_INTS( stack[ sp - 1 ], stack[ sp ] ) )
+        stack[ sp - 1 ] =
+          intValue( valueInt( stack[ sp - 1 ] ) * valueInt( stack[ sp ] ) );
+      else
+        stack[ sp - 1 ] = mulValues( stack[ sp - 1 ], stack[ sp ] );
+      break;
+
+    case DivOp:
+      sp--;
+      if ( BOTH_INTS( stack[ sp - 1 ], stack[ sp ] ) &&
+           valueInt( stack[ sp ] ) != 0 )
+        stack[ sp - 1 ] =
+          intValue( valueInt( stack[ sp - 1 ] ) / valueInt( stack[ sp ] ) );
+      else
+        stack[ sp - 1 ] = divValues( stack[ sp - 1 ], stack[ sp ] );
+      break;
+
+    case LessOp:
+      sp--;
+      if ( BOTH_INTS( stack[ sp - 1 ], stack[ sp ] ) )
+        stack[ sp - 1 ] =
+          intValue( valueInt( stack[ sp - 1 ] ) < valueInt( stack[ sp ] ) );
+      else
+        stack[ sp - 1 ] = lessValues( stack[ sp - 1 ], stack[ sp ] );
+      break;
+
+    case EqualsOp:
+      sp--;
+      if ( BOTH_INTS( stack[ sp - 1 ], stack[ sp ] ) )
+        stack[ sp - 1 ] =
+          intValue( valueInt( stack[ sp - 1 ] ) == valueInt( stack[ sp ] ) );
+      else
+        stack[ sp - 1 ] = equalsValues( stack[ sp - 1 ], stack[ sp ] );
+      break;
+
+    case IndexOp:
+      sp--;
+      stack[ sp - 1 ] = indexValue( stack[ sp - 1 ], stack[ sp ] );
+      break;
+
+    case SeqInitOp: {
+      int len = *pc++;
+      sp -= len;
+      stack[ sp ] = seqInitValues( len, stack + sp );
+      sp++;
+      break;
+    }
+
+    case LenOp:
+      stack[ sp - 1 ] = lenValue( stack[ sp - 1 ] );
+      break;
+
+    case CallOp: {
+      Builtin fn = *pc++;
+      sp -= builtinArgCount( fn );
+      stack[ sp ] = callBuiltin( fn, stack + sp );
+      sp++;
+      break;
+    }
+
+    case AndOp:
+    case OrOp: {
+      // Short-circuit if the left-hand operand decides the result.
+      bool isAnd = pc[ -1 ] == AndOp;
+      requireIntType( &stack[ sp - 1 ] );
+      if ( ( valueInt( stack[ sp - 1 ] ) != 0 ) != isAnd ) {
+        pc = code->code + *pc;
+      } else {
+        sp--;
+        pc++;
+      }
+      break;
+    }
+
+    case RequireIntOp:
+      requireIntType( &stack[ sp - 1 ] );
+      break;
+
+    case JumpOp:
+      pc = code->code + *pc;
+      break;
+
+    case JumpFalseOp:
+      sp--;
+      requireIntType( &stack[ sp ] );
+      if ( valueInt( stack[ sp ] ) )
+        pc++;
+      else
+        pc = code->code + *pc;
+      break;
+
+    case PrintOp:
+      printValue( stack[ --sp ] );
+      break;
+
+    case PushOp:
+      sp -= 2;
+      pushValue( stack[ sp ], stack[ sp + 1 ] );
+      break;
+
+    case ErrorOp: {
+      // Report an error found while parsing the whole program.
+      Sequence *msg = code->consts[ *pc++ ];
+      for ( int i = 0; i < msg->len; i++ )
+        fputc( sequenceElement( msg, i ), stderr );
+      exit( EXIT_FAILURE );
+    }
+
+    case HaltOp:
+      free( stack );
+      return;
+    }
+  }
+}
+
+/** Parse, optimize and run the whole program at once, instead of one
+    statement at a time.  For the VM, the whole program is compiled into
+    one block of code, which can be saved in a cache file and loaded on
+    later runs.
+    @param filename name of the program's source file.
+    @param src source of the program, not tokenized yet.
+    @param parser parser for the source.
+    @param env current values of all variables.
+    @param treeWalk true to walk the tree rather than using the VM.
+    @param optLevel optimization level.
+    @param cache true to use the cache file.
+    @param profile true to profile the statements, on the tree-walker.
+    @param types state for inferring types, or null to leave the type
+    checks in.
+    @param jit true to compile hot loops to native code, on the
+    tree-walker.
+*/
+static void runProgram( char const *filename, Source *src, Parser *parser,
+                        Environment *env, bool treeWalk, int optLevel,
+                        bool cache, bool profile, TypeState *types,
+                        bool jit )
+{
+  // See if we already compiled this exact source.
+  Code *code = NULL;
+  if ( cache && !treeWalk )
+    code = loadCache( filename, src, optLevel );
+
+  if ( !code ) {
+    // Parse everything up to the first error, if there is one.
+    lexSource( src );
+    char error[ MAX_ERROR_MESSAGE ];
+    int len;
+    Stmt **stmts = parseProgram( parser, &len, error );
+    if ( optLevel > 0 )
+      for ( int i = 0; i < len; i++ )
+        stmts[ i ] = optimizeStmt( stmts[ i ] );
+    if ( types )
+      for ( int i = 0; i < len; i++ )
+        inferTypes( types, stmts[ i ] );
+    if ( jit )
+      for ( int i = 0; i < len; i++ )
+        jitStmt( stmts[ i ] );
+    if ( profile )
+      for ( int i = 0; i < len; i++ )
+        profileStmt( stmts[ i ] );
+
+    if ( treeWalk ) {
+      // Run the statements before the error, then report it.
+      for ( int i = 0; i < len; i++ )
+        stmts[ i ]->execute( stmts[ i ], env );
+      if ( error[ 0 ] != '\0' ) {
+        fputs( error, stderr );
+        exit( EXIT_FAILURE );
+      }
+    } else {
+      // The compiled code reports the error itself, when it gets there.
+      code = compileProgram( len, stmts, error );
+      if ( cache )
+        saveCache( filename, src, optLevel, code );
+    }
+
+    resetParser( parser );
+  }
+
+  if ( code ) {
+    runCode( code, env );
+    freeCode( code );
+  }
+}
+
+/** Parse and optimize the whole program, then write it out as C instead
+    of running it.
+    @param filename name of the program's source file.
+    @param src source of the program, not tokenized yet.
+    @param parser parser for the source.
+    @param optLevel optimization level.
+*/
+static void emitProgram( char const *filename, Source *src, Parser *parser,
+                         int optLevel )
+{
+  lexSource( src );
+  char error[ MAX_ERROR_MESSAGE ];
+  int len;
+  Stmt **stmts = parseProgram( parser, &len, error );
+  if ( optLevel > 0 )
+    for ( int i = 0; i < len; i++ )
+      stmts[ i ] = optimizeStmt( stmts[ i ] );
+
+  translateProgram( stdout, filename, len, stmts, error );
+  resetParser( parser );
+}
+
 /** Program staring point Interprets and executes a given program file.
     @param argc number of command line arguments
     @param argv list of command line arguments
@@ -28,36 +322,136 @@ void usage()
 */
 int main( int argc, char *argv[] )
 {
+  // Use the bytecode VM unless we're asked to walk the tree.
+  bool treeWalk = false;
+
+  // Optimization level, 0 to run the tree just as it was parsed.
+  int optLevel = 1;
+
+  // Report counts of the work done as JSON at the end, if requested.
+  bool stats = false;
+
+  // Parse the whole program before running it, and maybe cache its
+  // compiled code.
+  bool whole = false;
+  bool cache = false;
+
+  // Time each statement, on the tree-walker.
+  bool profile = false;
+
+  // Report what the optimizations did.
+  bool verbose = false;
+
+  // Compile hot loops to native code, on the tree-walker.
+  bool jit = false;
+
+  // Translate the program to C rather than running it.
+  bool emitC = false;
+
+  // Handle options before the program file.
+  int argPos = 1;
+  for ( ; argPos < argc - 1; argPos++ ) {
+    if ( strcmp( argv[ argPos ], "--tree" ) == 0 )
+      treeWalk = true;
+    else if ( strcmp( argv[ argPos ], "--jit" ) == 0 )
+      jit = treeWalk = true;
+    else if ( strcmp( argv[ argPos ], "--emit-c" ) == 0 )
+      emitC = true;
+    else if ( strcmp( argv[ argPos ], "-O0" ) == 0 )
+      optLevel = 0;
+    else if ( strcmp( argv[ argPos ], "-O1" ) == 0 )
+      optLevel = 1;
+    else if ( strcmp( argv[ argPos ], "--whole" ) == 0 )
+      whole = true;
+    else if ( strcmp( argv[ argPos ], "--cache" ) == 0 )
+      whole = cache = true;
+    else if ( strcmp( argv[ argPos ], "--profile" ) == 0 )
+      profile = treeWalk = true;
+    else if ( strcmp( argv[ argPos ], "--stats" ) == 0 )
+      stats = true;
+    else if ( strcmp( argv[ argPos ], "--verbose" ) == 0 )
+      verbose = true;
+    else
+      usage();
+  }
+
   // Open the program's source.
-  if ( argc != ONE_CMD_INPUT )
+  if ( argPos != argc - 1 )
     usage();
   
-  FILE *fp = fopen( argv[ 1 ], "r" );
-  if ( !fp ) {
-    perror( argv[ 1 ] );
+  Source *src = readSource( argv[ argPos ] );
+  if ( !src ) {
+    perror( argv[ argPos ] );
     exit( EXIT_FAILURE );
   }
+  Parser *parser = makeParser( src );
 
   // Environment, for storing variable values.
   Environment *env = makeEnvironment();
+
+  // Types are inferred to remove the tree-walker's type checks.  The VM
+  // already handles ints inline, without calling a checked op.
+  TypeState *types = NULL;
+  if ( treeWalk && optLevel > 0 )
+    types = makeTypeState();
   
-  // Parse one statement at a time, then run each statement
-  // using the same Environment.
-  char tok[ MAX_TOKEN + 1 ];
-  while ( parseToken( tok, fp ) ) {
-    // Parse the next input statement.
-    Stmt *stmt = parseStmt( tok, fp );
+  // The profile's folded stacks go next to the program.
+  if ( profile ) {
+    char folded[ strlen( argv[ argPos ] ) + sizeof( FOLDED_SUFFIX ) ];
+    strcpy( folded, argv[ argPos ] );
+    strcat( folded, FOLDED_SUFFIX );
+    startProfile( folded );
+  }
+
+  if ( emitC ) {
+    emitProgram( argv[ argPos ], src, parser, optLevel );
+  } else if ( whole ) {
+    runProgram( argv[ argPos ], src, parser, env, treeWalk, optLevel, cache,
+                profile, types, jit );
+  } else {
+    // Parse one statement at a time, then run each statement
+    // using the same Environment.
+    lexSource( src );
+    while ( hasStatement( parser ) ) {
+      // Parse the next input statement.
+      Stmt *stmt = parseStmt( parser );
+      if ( optLevel > 0 )
+        stmt = optimizeStmt( stmt );
+      if ( types )
+        inferTypes( types, stmt );
+      if ( jit )
+        jitStmt( stmt );
+      if ( profile )
+        profileStmt( stmt );
 
-    // Run the statement.
-    stmt->execute( stmt, env );
+      // Run the statement, either directly on the tree or by compiling it.
+      if ( treeWalk ) {
+        stmt->execute( stmt, env );
+      } else {
+        Code *code = compileStmt( stmt );
+        runCode( code, env );
+        freeCode( code );
+      }
 
-    // Delete the statement.
-    stmt->destroy( stmt );
+      // Free the statement's syntax tree, all at once.
+      resetParser( parser );
+    }
   }
-  
-  // We're done, close the input file and free the environment.
-  fclose( fp );
+
+  // We're done, free the environment, the parser and the source.  The
+  // stats come after the environment, so every sequence made should
+  // have been freed.
   freeEnvironment( env );
+  if ( types ) {
+    if ( verbose )
+      reportTypes( stderr, types );
+    freeTypeState( types );
+  }
+  if ( stats )
+    printStats( stderr, src->count, parserArena( parser ) );
+  freeParser( parser );
+  freeSource( src );
+  freeSequencePools();
 
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,628 @@
+/**
+  @file jit.c
+  @author Adrian Chan (amchan)
+  Just-in-time compiler from hot while loops to native x86-64 code.
+*/
+
+// Needed for MAP_ANONYMOUS.
+#define _DEFAULT_SOURCE
+
+#include "jit.h"
+
+#if defined( __x86_64__ ) && defined( __linux__ )
+
+#include "ops.h"
+#include "output.h"
+#include <stdlib.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/** Number of times a loop body runs in the interpreter before the loop
+    is compiled.  Compiling is cheap, so loops don't have to be very hot
+    to be worth it. */
+#define JIT_THRESHOLD 10
+
+/** Initial capacity for the resizable arrays */
+#define INITIAL_CAPACITY 64
+
+/** Double the capacity of an array */
+#define DOUBLE_CAPACITY 2
+
+/** Multiplier for hashing statement addresses (Fibonacci hashing). */
+#define HASH_MULTIPLIER 11400714819323198485ULL
+
+/** Status compiled code returns when the loop finishes. */
+#define JIT_DONE 0
+
+/** Status compiled code returns when it's about to divide by zero. */
+#define JIT_DIVIDE_BY_ZERO 1
+
+/** Offset of a variable's int value in the array of values.  The int
+    is the high half of the value's word, and x86-64 is little-endian. */
+#define VALUE_OFFSET( slot ) \
+  ( (int) ( ( slot ) * sizeof( Value ) + VALUE_INT_SHIFT / CHAR_BIT ) )
+
+/** Compiled code for a loop.  It takes the array of variable values
+    and returns a status. */
+typedef int (*NativeLoop)( Value *vals );
+
+/** Everything we know about one while loop. */
+typedef struct {
+  /** Loop this is for, or null if this entry is empty. */
+  Stmt *stmt;
+
+  /** Number of times the body has run in the interpreter. */
+  long count;
+
+  /** Compiled code, or null if it hasn't been compiled. */
+  NativeLoop code;
+
+  /** Size of the memory mapped for the code. */
+  size_t size;
+
+  /** Slots of all the variables the loop uses. */
+  int *slots;
+
+  /** Number of slots in the list. */
+  int slotCount;
+} Loop;
+
+/** Native code as it's being generated. */
+typedef struct {
+  /** Bytes of code generated so far. */
+  unsigned char *data;
+
+  /** Number of bytes used in data. */
+  int len;
+
+  /** Capacity of data. */
+  int cap;
+
+  /** Offsets of the jumps to the code that reports division by zero,
+      to fill in once we know where that is. */
+  int *bails;
+
+  /** Number of jumps in bails. */
+  int bailCount;
+
+  /** Capacity of bails. */
+  int bailCap;
+
+  /** Slots of the variables used so far. */
+  int *slots;
+
+  /** Number of slots in the list. */
+  int slotCount;
+
+  /** Capacity of the slots list. */
+  int slotCap;
+} Emitter;
+
+/** Hash table from while statements to what we know about them.  Nodes
+    are reused when the syntax arena is reset, so a loop installed at
+    the same address as an old one just replaces its entry. */
+static Loop *table;
+
+/** Number of entries used in the table. */
+static int tableCount;
+
+/** Capacity of the table, a power of two. */
+static int tableCap;
+
+/** Find the table entry for a loop.
+    @param stmt loop to look for.
+    @return the loop's entry, or the empty entry where it belongs.
+*/
+static Loop *findLoop( Stmt *stmt )
+{
+  uint64_t hash = (uint64_t) (uintptr_t) stmt * HASH_MULTIPLIER;
+  int i = hash >> 32 & ( tableCap - 1 );
+  while ( table[ i ].stmt != NULL && table[ i ].stmt != stmt )
+    i = ( i + 1 ) & ( tableCap - 1 );
+  return &table[ i ];
+}
+
+//////////////////////////////////////////////////////////////////////
+// Generating code
+
+/** Add some bytes of code.
+    @param e emitter to add to.
+    @param count number of bytes.
+    @param ... the bytes, as ints.
+*/
+static void emit( Emitter *e, int count, ... )
+{
+  if ( e->len + count > e->cap ) {
+    e->cap = e->cap * DOUBLE_CAPACITY + count;
+    e->data = (unsigned char *) realloc( e->data, e->cap );
+  }
+
+  va_list args;
+  va_start( args, count );
+  for ( int i = 0; i < count; i++ )
+    e->data[ e->len++ ] = va_arg( args, int );
+  va_end( args );
+}
+
+/** Add a 32-bit value to the code.
+    @param e emitter to add to.
+    @param val value to add.
+*/
+static void emitInt( Emitter *e, int32_t val )
+{
+  uint32_t bits = val;
+  emit( e, 4, bits & 0xFF, bits >> 8 & 0xFF, bits >> 16 & 0xFF,
+        bits >> 24 & 0xFF );
+}
+
+/** Add a 64-bit value to the code.
+    @param e emitter to add to.
+    @param val value to add.
+*/
+static void emitLong( Emitter *e, uint64_t val )
+{
+  emitInt( e, val & 0xFFFFFFFF );
+  emitInt( e, val >> 32 );
+}
+
+/** Add the offset of a variable's value to the code, as the
+    displacement from rbx, which holds the array of values.
+    @param e emitter to add to.
+    @param slot slot for the variable.
+*/
+static void emitVariable( Emitter *e, int slot )
+{
+  bool found = false;
+  for ( int i = 0; i < e->slotCount; i++ )
+    found = found || e->slots[ i ] == slot;
+  if ( !found ) {
+    if ( e->slotCount >= e->slotCap ) {
+      e->slotCap = e->slotCap ? e->slotCap * DOUBLE_CAPACITY :
+        INITIAL_CAPACITY;
+      e->slots = (int *) realloc( e->slots, e->slotCap * sizeof( int ) );
+    }
+    e->slots[ e->slotCount++ ] = slot;
+  }
+
+  emitInt( e, VALUE_OFFSET( slot ) );
+}
+
+/** Add a 32-bit relative jump target, to be filled in later.
+    @param e emitter to add to.
+    @return offset of the target, for patchJump().
+*/
+static int emitTarget( Emitter *e )
+{
+  emitInt( e, 0 );
+  return e->len - 4;
+}
+
+/** Fill in the target of a jump.
+    @param e emitter with the jump in it.
+    @param pos offset of the jump's target, from emitTarget().
+    @param dest offset of the code to jump to.
+*/
+static void patchJump( Emitter *e, int pos, int dest )
+{
+  uint32_t rel = dest - ( pos + 4 );
+  for ( int i = 0; i < 4; i++ )
+    e->data[ pos + i ] = rel >> ( 8 * i ) & 0xFF;
+}
+
+/** Add a call to a C function, at a point where the stack is aligned.
+    @param e emitter to add to.
+    @param fn address of the function.
+*/
+static void emitCall( Emitter *e, void *fn )
+{
+  // mov rax, fn; call rax
+  emit( e, 2, 0x48, 0xB8 );
+  emitLong( e, (uint64_t) (uintptr_t) fn );
+  emit( e, 2, 0xFF, 0xD0 );
+}
+
+/** Print a sequence literal, for compiled code.  The elements are
+    looked up each time, in case the sequence has moved them.
+    @param seq literal's sequence.
+*/
+static void printLiteral( Sequence *seq )
+{
+  grabSequence( seq );
+  printValue( seqValue( seq ) );
+}
+
+/** Return true if the JIT can compile an expression.
+    @param expr expression to check.
+    @return true if expr only works with ints.
+*/
+static bool canCompileExpr( Expr *expr )
+{
+  switch ( expr->kind ) {
+  case LiteralIntKind:
+  case VariableKind:
+    return true;
+
+  case AddKind:
+  case SubKind:
+  case MulKind:
+  case DivKind:
+  case LessKind:
+  case EqualsKind:
+  case AndKind:
+  case OrKind:
+    return canCompileExpr( ( (SimpleExpr *) expr )->expr1 ) &&
+      canCompileExpr( ( (SimpleExpr *) expr )->expr2 );
+
+  default:
+    return false;
+  }
+}
+
+/** Return true if the JIT can compile a statement.
+    @param stmt statement to check.
+    @return true if stmt only works with ints, or prints a string.
+*/
+static bool canCompileStmt( Stmt *stmt )
+{
+  switch ( stmt->kind ) {
+  case PrintKind: {
+    Expr *arg = ( (SimpleStmt *) stmt )->expr1;
+    return arg->kind == SeqLiteralKind || canCompileExpr( arg );
+  }
+
+  case AssignmentKind: {
+    AssignmentStmt *this = (AssignmentStmt *) stmt;
+    return !this->iexpr && canCompileExpr( this->expr );
+  }
+
+  case CompoundKind: {
+    CompoundStmt *this = (CompoundStmt *) stmt;
+    for ( int i = 0; i < this->len; i++ )
+      if ( !canCompileStmt( this->stmtList[ i ] ) )
+        return false;
+    return true;
+  }
+
+  case IfKind:
+  case WhileKind: {
+    ConditionalStmt *this = (ConditionalStmt *) stmt;
+    return canCompileExpr( this->cond ) && canCompileStmt( this->body );
+  }
+
+  default:
+    return false;
+  }
+}
+
+/** Generate code to evaluate an expression, leaving the result in eax.
+    Values in the middle of being computed are saved on the stack.
+    @param e emitter to add to.
+    @param expr expression to compile.
+*/
+static void compileExpr( Emitter *e, Expr *expr )
+{
+  if ( expr->kind == LiteralIntKind ) {
+    // mov eax, val
+    emit( e, 1, 0xB8 );
+    emitInt( e, ( (LiteralInt *) expr )->val );
+    return;
+  }
+
+  if ( expr->kind == VariableKind ) {
+    // mov eax, [rbx + offset]
+    emit( e, 2, 0x8B, 0x83 );
+    emitVariable( e, ( (VariableExpr *) expr )->slot );
+    return;
+  }
+
+  SimpleExpr *this = (SimpleExpr *) expr;
+  compileExpr( e, this->expr1 );
+
+  // The right operand of and or or is only evaluated if the left one
+  // doesn't decide the result.
+  if ( expr->kind == AndKind || expr->kind == OrKind ) {
+    // test eax, eax; jz/jnz end
+    emit( e, 4, 0x85, 0xC0, 0x0F, expr->kind == AndKind ? 0x84 : 0x85 );
+    int end = emitTarget( e );
+    compileExpr( e, this->expr2 );
+    patchJump( e, end, e->len );
+    return;
+  }
+
+  // Get the right operand in ecx, keeping the left one in eax.
+  if ( this->expr2->kind == LiteralIntKind ) {
+    // mov ecx, val
+    emit( e, 1, 0xB9 );
+    emitInt( e, ( (LiteralInt *) this->expr2 )->val );
+  } else if ( this->expr2->kind == VariableKind ) {
+    // mov ecx, [rbx + offset]
+    emit( e, 2, 0x8B, 0x8B );
+    emitVariable( e, ( (VariableExpr *) this->expr2 )->slot );
+  } else {
+    // push rax; (right operand); mov ecx, eax; pop rax
+    emit( e, 1, 0x50 );
+    compileExpr( e, this->expr2 );
+    emit( e, 3, 0x89, 0xC1, 0x58 );
+  }
+
+  switch ( expr->kind ) {
+  case AddKind:
+    // add eax, ecx
+    emit( e, 2, 0x01, 0xC8 );
+    break;
+
+  case SubKind:
+    // sub eax, ecx
+    emit( e, 2, 0x29, 0xC8 );
+    break;
+
+  case MulKind:
+    // imul eax, ecx
+    emit( e, 3, 0x0F, 0xAF, 0xC1 );
+    break;
+
+  case DivKind: {
+    // test ecx, ecx; jz bail; cdq; idiv ecx
+    emit( e, 4, 0x85, 0xC9, 0x0F, 0x84 );
+    if ( e->bailCount >= e->bailCap ) {
+      e->bailCap = e->bailCap ? e->bailCap * DOUBLE_CAPACITY :
+        INITIAL_CAPACITY;
+      e->bails = (int *) realloc( e->bails, e->bailCap * sizeof( int ) );
+    }
+    e->bails[ e->bailCount++ ] = emitTarget( e );
+    emit( e, 3, 0x99, 0xF7, 0xF9 );
+    break;
+  }
+
+  case LessKind:
+    // cmp eax, ecx; setl al; movzx eax, al
+    emit( e, 8, 0x39, 0xC8, 0x0F, 0x9C, 0xC0, 0x0F, 0xB6, 0xC0 );
+    break;
+
+  case EqualsKind:
+    // cmp eax, ecx; sete al; movzx eax, al
+    emit( e, 8, 0x39, 0xC8, 0x0F, 0x94, 0xC0, 0x0F, 0xB6, 0xC0 );
+    break;
+
+  default:
+    break;
+  }
+}
+
+/** Generate code to execute a statement.  Nothing is left on the stack
+    between statements, so it's aligned for calls.
+    @param e emitter to add to.
+    @param stmt statement to compile.
+*/
+static void compileStmt( Emitter *e, Stmt *stmt )
+{
+  switch ( stmt->kind ) {
+  case PrintKind: {
+    Expr *arg = ( (SimpleStmt *) stmt )->expr1;
+    if ( arg->kind == SeqLiteralKind ) {
+      // mov rdi, seq
+      emit( e, 2, 0x48, 0xBF );
+      emitLong( e, (uint64_t) (uintptr_t) ( (SeqLiteral *) arg )->seq );
+      emitCall( e, (void *) printLiteral );
+    } else {
+      // mov edi, eax
+      compileExpr( e, arg );
+      emit( e, 2, 0x89, 0xC7 );
+      emitCall( e, (void *) outputInt );
+    }
+    break;
+  }
+
+  case AssignmentKind: {
+    // mov [rbx + offset], eax
+    AssignmentStmt *this = (AssignmentStmt *) stmt;
+    compileExpr( e, this->expr );
+    emit( e, 2, 0x89, 0x83 );
+    emitVariable( e, this->slot );
+    break;
+  }
+
+  case CompoundKind: {
+    CompoundStmt *this = (CompoundStmt *) stmt;
+    for ( int i = 0; i < this->len; i++ )
+      compileStmt( e, this->stmtList[ i ] );
+    break;
+  }
+
+  case IfKind: {
+    // (condition); test eax, eax; jz end; (body)
+    ConditionalStmt *this = (ConditionalStmt *) stmt;
+    compileExpr( e, this->cond );
+    emit( e, 4, 0x85, 0xC0, 0x0F, 0x84 );
+    int end = emitTarget( e );
+    compileStmt( e, this->body );
+    patchJump( e, end, e->len );
+    break;
+  }
+
+  case WhileKind: {
+    // top: (condition); test eax, eax; jz end; (body); jmp top
+    ConditionalStmt *this = (ConditionalStmt *) stmt;
+    int top = e->len;
+    compileExpr( e, this->cond );
+    emit( e, 4, 0x85, 0xC0, 0x0F, 0x84 );
+    int end = emitTarget( e );
+    compileStmt( e, this->body );
+    emit( e, 1, 0xE9 );
+    patchJump( e, emitTarget( e ), top );
+    patchJump( e, end, e->len );
+    break;
+  }
+
+  default:
+    break;
+  }
+}
+
+/** Compile a loop to native code.
+    @param loop loop to compile.
+*/
+static void compileLoop( Loop *loop )
+{
+  Emitter e = { NULL, 0, 0, NULL, 0, 0, NULL, 0, 0 };
+
+  // push rbp; mov rbp, rsp; push rbx; sub rsp, 8; mov rbx, rdi
+  emit( &e, 12, 0x55, 0x48, 0x89, 0xE5, 0x53, 0x48, 0x83, 0xEC, 0x08,
+        0x48, 0x89, 0xFB );
+  compileStmt( &e, loop->stmt );
+
+  // xor eax, eax
+  // exit: lea rsp, [rbp - 8]; pop rbx; pop rbp; ret
+  emit( &e, 2, 0x31, 0xC0 );
+  int exit = e.len;
+  emit( &e, 7, 0x48, 0x8D, 0x65, 0xF8, 0x5B, 0x5D, 0xC3 );
+
+  // bail: mov eax, JIT_DIVIDE_BY_ZERO; jmp exit
+  int bail = e.len;
+  emit( &e, 1, 0xB8 );
+  emitInt( &e, JIT_DIVIDE_BY_ZERO );
+  emit( &e, 1, 0xE9 );
+  patchJump( &e, emitTarget( &e ), exit );
+  for ( int i = 0; i < e.bailCount; i++ )
+    patchJump( &e, e.bails[ i ], bail );
+
+  // Copy the code to memory that can be executed, then make it
+  // read-only.
+  void *mem = mmap( NULL, e.len, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+  if ( mem != MAP_FAILED ) {
+    memcpy( mem, e.data, e.len );
+    if ( mprotect( mem, e.len, PROT_READ | PROT_EXEC ) == 0 ) {
+      loop->code = (NativeLoop) mem;
+      loop->size = e.len;
+      loop->slots = e.slots;
+      loop->slotCount = e.slotCount;
+      e.slots = NULL;
+    } else {
+      munmap( mem, e.len );
+    }
+  }
+
+  free( e.data );
+  free( e.bails );
+  free( e.slots );
+}
+
+//////////////////////////////////////////////////////////////////////
+// Running loops
+
+/** Run a loop's compiled code, if all the variables it uses hold ints.
+    @param loop loop to run.
+    @param env current values of all variables.
+    @return true if the compiled code ran the loop.
+*/
+static bool runNative( Loop *loop, Environment *env )
+{
+  Value *vals = variableValues( env );
+  for ( int i = 0; i < loop->slotCount; i++ )
+    if ( !isInt( vals[ loop->slots[ i ] ] ) )
+      return false;
+
+  // The code stops when it would divide by zero, with everything
+  // before that done, so the ops can report it.
+  if ( loop->code( vals ) == JIT_DIVIDE_BY_ZERO ) {
+    Value zero = intValue( 0 );
+    divValues( zero, zero );
+  }
+  return true;
+}
+
+/** Execute function installed on loops the JIT can compile.  It works
+    like the interpreter's while loop, counting how many times the body
+    runs, and switches to native code at the start of an iteration once
+    there is some.
+    @param stmt while loop to execute.
+    @param env current values of all variables.
+*/
+static void executeJitWhile( Stmt *stmt, Environment *env )
+{
+  ConditionalStmt *this = (ConditionalStmt *) stmt;
+  Loop *loop = findLoop( stmt );
+
+  while ( true ) {
+    if ( loop->code && runNative( loop, env ) )
+      return;
+
+    Value result = this->cond->eval( this->cond, env );
+    requireIntType( &result );
+    if ( !valueInt( result ) )
+      return;
+
+    this->body->execute( this->body, env );
+    if ( !loop->code && ++loop->count >= JIT_THRESHOLD )
+      compileLoop( loop );
+  }
+}
+
+/** Add a loop to the table, replacing any old entry for the same
+    address.
+    @param stmt loop being installed.
+*/
+static void addLoop( Stmt *stmt )
+{
+  // Keep the table at most half full.
+  if ( ( tableCount + 1 ) * 2 > tableCap ) {
+    Loop *old = table;
+    int oldCap = tableCap;
+    tableCap = tableCap ? tableCap * DOUBLE_CAPACITY : INITIAL_CAPACITY;
+    table = (Loop *) calloc( tableCap, sizeof( Loop ) );
+    for ( int i = 0; i < oldCap; i++ )
+      if ( old[ i ].stmt )
+        *findLoop( old[ i ].stmt ) = old[ i ];
+    free( old );
+  }
+
+  Loop *entry = findLoop( stmt );
+  if ( entry->stmt == NULL )
+    tableCount++;
+  else if ( entry->code ) {
+    munmap( (void *) entry->code, entry->size );
+    free( entry->slots );
+  }
+  *entry = (Loop){ stmt, 0, NULL, 0, NULL, 0 };
+}
+
+void jitStmt( Stmt *stmt )
+{
+  switch ( stmt->kind ) {
+  case CompoundKind: {
+    CompoundStmt *this = (CompoundStmt *) stmt;
+    for ( int i = 0; i < this->len; i++ )
+      jitStmt( this->stmtList[ i ] );
+    break;
+  }
+
+  case WhileKind:
+    if ( canCompileStmt( stmt ) ) {
+      addLoop( stmt );
+      stmt->execute = executeJitWhile;
+    }
+    jitStmt( ( (ConditionalStmt *) stmt )->body );
+    break;
+
+  case IfKind:
+    jitStmt( ( (ConditionalStmt *) stmt )->body );
+    break;
+
+  default:
+    break;
+  }
+}
+
+#else
+
+void jitStmt( Stmt *stmt )
+{
+  // There's no code generator for this machine, so loops always run in
+  // the interpreter.
+}
+
+#endif
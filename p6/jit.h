@@ -0,0 +1,27 @@
+/**
+  @file jit.h
+  @author Adrian Chan (amchan)
+
+  Just-in-time compiler from hot while loops to native x86-64 code, for
+  the tree-walking interpreter on Linux.  A loop can be compiled if it
+  only works with ints: arithmetic, comparisons, and, or, assignments
+  to variables, if and while statements and printing.  It's counted as
+  it runs, and once it's hot, its condition and body are compiled
+  together into native code.  Each time the loop starts after that, if
+  every variable it uses holds an int, the native code runs the whole
+  loop; otherwise, the interpreter does.
+*/
+
+#ifndef _JIT_H_
+#define _JIT_H_
+
+#include "syntax.h"
+
+/** Install the JIT on the while loops in the given statement that it
+    can compile.  This must be done after the statement is optimized
+    and before it runs.  On other machines, this does nothing.
+    @param stmt top-level statement to install the JIT on.
+*/
+void jitStmt( Stmt *stmt );
+
+#endif
@@ -0,0 +1,658 @@
+/**
+  @file kernel.c
+  @author Adrian Chan (amchan)
+  Bulk kernels for arrays of sequence elements, with SSE2 and AVX2
+  versions for x86-64 picked at run time.
+*/
+
+#include "kernel.h"
+#include <stdbool.h>
+#include <string.h>
+
+#if defined( __x86_64__ ) && defined( __GNUC__ )
+#define X86_KERNELS
+#include <immintrin.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////
+// Portable kernels, for any machine and for the leftover elements at
+// the end of an array.
+
+/** Find the first place two int arrays differ, one element at a time.
+    @param a first array.
+    @param b second array.
+    @param len number of elements in each array.
+    @return index of the first difference, or len.
+*/
+static int mismatchPortable( int const *a, int const *b, int len )
+{
+  int i = 0;
+  while ( i < len && a[ i ] == b[ i ] )
+    i++;
+  return i;
+}
+
+/** Find a value in an int array, one element at a time.
+    @param a array to search.
+    @param len number of elements in a.
+    @param val value to look for.
+    @return index of the first match, or -1.
+*/
+static int findPortable( int const *a, int len, int val )
+{
+  for ( int i = 0; i < len; i++ )
+    if ( a[ i ] == val )
+      return i;
+  return -1;
+}
+
+/** Count a value in an int array, one element at a time.
+    @param a array to search.
+    @param len number of elements in a.
+    @param val value to count.
+    @return number of matches.
+*/
+static int countPortable( int const *a, int len, int val )
+{
+  int count = 0;
+  for ( int i = 0; i < len; i++ )
+    count += a[ i ] == val;
+  return count;
+}
+
+/** Count a value in a byte array, one element at a time.
+    @param a array to search.
+    @param len number of elements in a.
+    @param val value to count.
+    @return number of matches.
+*/
+static int countBytesPortable( unsigned char const *a, int len, int val )
+{
+  int count = 0;
+  for ( int i = 0; i < len; i++ )
+    count += a[ i ] == val;
+  return count;
+}
+
+/** Add up an int array, one element at a time.  The sum is unsigned,
+    so it wraps around instead of overflowing.
+    @param a array to add up.
+    @param len number of elements in a.
+    @return sum of the elements.
+*/
+static unsigned int sumPortable( int const *a, int len )
+{
+  unsigned int sum = 0;
+  for ( int i = 0; i < len; i++ )
+    sum += a[ i ];
+  return sum;
+}
+
+/** Add up a byte array, one element at a time.
+    @param a array to add up.
+    @param len number of elements in a.
+    @return sum of the elements.
+*/
+static unsigned int sumBytesPortable( unsigned char const *a, int len )
+{
+  unsigned int sum = 0;
+  for ( int i = 0; i < len; i++ )
+    sum += a[ i ];
+  return sum;
+}
+
+/** Widen the range in min and max to cover the elements of an int
+    array, one element at a time.
+    @param a array to look through.
+    @param len number of elements in a.
+    @param min smallest value so far, updated.
+    @param max largest value so far, updated.
+*/
+static void rangePortable( int const *a, int len, int *min, int *max )
+{
+  for ( int i = 0; i < len; i++ ) {
+    if ( a[ i ] < *min )
+      *min = a[ i ];
+    if ( a[ i ] > *max )
+      *max = a[ i ];
+  }
+}
+
+/** Widen the range in min and max to cover the elements of a byte
+    array, one element at a time.
+    @param a array to look through.
+    @param len number of elements in a.
+    @param min smallest value so far, updated.
+    @param max largest value so far, updated.
+*/
+static void rangeBytesPortable( unsigned char const *a, int len, int *min,
+                                int *max )
+{
+  for ( int i = 0; i < len; i++ ) {
+    if ( a[ i ] < *min )
+      *min = a[ i ];
+    if ( a[ i ] > *max )
+      *max = a[ i ];
+  }
+}
+
+/** Widen bytes to ints, one element at a time.
+    @param dest array to copy to.
+    @param src bytes to copy.
+    @param len number of elements.
+*/
+static void widenPortable( int *dest, unsigned char const *src, int len )
+{
+  for ( int i = 0; i < len; i++ )
+    dest[ i ] = src[ i ];
+}
+
+#ifdef X86_KERNELS
+//////////////////////////////////////////////////////////////////////
+// SSE2 kernels.  Every x86-64 machine has SSE2, so these need no check.
+
+/** Find the first place two int arrays differ, four elements at a time.
+    @param a first array.
+    @param b second array.
+    @param len number of elements in each array.
+    @return index of the first difference, or len.
+*/
+static int mismatchSSE2( int const *a, int const *b, int len )
+{
+  int i = 0;
+  for ( ; i + 4 <= len; i += 4 ) {
+    __m128i x = _mm_loadu_si128( (__m128i const *) ( a + i ) );
+    __m128i y = _mm_loadu_si128( (__m128i const *) ( b + i ) );
+    if ( _mm_movemask_epi8( _mm_cmpeq_epi32( x, y ) ) != 0xFFFF )
+      break;
+  }
+  return i + mismatchPortable( a + i, b + i, len - i );
+}
+
+/** Find a value in an int array, four elements at a time.
+    @param a array to search.
+    @param len number of elements in a.
+    @param val value to look for.
+    @return index of the first match, or -1.
+*/
+static int findSSE2( int const *a, int len, int val )
+{
+  __m128i key = _mm_set1_epi32( val );
+  int i = 0;
+  for ( ; i + 4 <= len; i += 4 ) {
+    __m128i x = _mm_loadu_si128( (__m128i const *) ( a + i ) );
+    int mask = _mm_movemask_epi8( _mm_cmpeq_epi32( x, key ) );
+    if ( mask )
+      return i + __builtin_ctz( mask ) / (int) sizeof( int );
+  }
+  int rest = findPortable( a + i, len - i, val );
+  return rest < 0 ? -1 : i + rest;
+}
+
+/** Count a value in an int array, four elements at a time.
+    @param a array to search.
+    @param len number of elements in a.
+    @param val value to count.
+    @return number of matches.
+*/
+static int countSSE2( int const *a, int len, int val )
+{
+  // Each match is all ones, minus one, so subtracting it counts it.
+  __m128i key = _mm_set1_epi32( val );
+  __m128i counts = _mm_setzero_si128();
+  int i = 0;
+  for ( ; i + 4 <= len; i += 4 ) {
+    __m128i x = _mm_loadu_si128( (__m128i const *) ( a + i ) );
+    counts = _mm_sub_epi32( counts, _mm_cmpeq_epi32( x, key ) );
+  }
+
+  int lanes[ 4 ];
+  _mm_storeu_si128( (__m128i *) lanes, counts );
+  return lanes[ 0 ] + lanes[ 1 ] + lanes[ 2 ] + lanes[ 3 ] +
+    countPortable( a + i, len - i, val );
+}
+
+/** Count a value in a byte array, sixteen elements at a time.
+    @param a array to search.
+    @param len number of elements in a.
+    @param val value to count.
+    @return number of matches.
+*/
+static int countBytesSSE2( unsigned char const *a, int len, int val )
+{
+  __m128i key = _mm_set1_epi8( (char) val );
+  int count = 0;
+  int i = 0;
+  for ( ; i + 16 <= len; i += 16 ) {
+    __m128i x = _mm_loadu_si128( (__m128i const *) ( a + i ) );
+    int mask = _mm_movemask_epi8( _mm_cmpeq_epi8( x, key ) );
+    count += __builtin_popcount( mask );
+  }
+  return count + countBytesPortable( a + i, len - i, val );
+}
+
+/** Add up an int array, four elements at a time.
+    @param a array to add up.
+    @param len number of elements in a.
+    @return sum of the elements.
+*/
+static unsigned int sumSSE2( int const *a, int len )
+{
+  __m128i sums = _mm_setzero_si128();
+  int i = 0;
+  for ( ; i + 4 <= len; i += 4 ) {
+    __m128i x = _mm_loadu_si128( (__m128i const *) ( a + i ) );
+    sums = _mm_add_epi32( sums, x );
+  }
+
+  unsigned int lanes[ 4 ];
+  _mm_storeu_si128( (__m128i *) lanes, sums );
+  return lanes[ 0 ] + lanes[ 1 ] + lanes[ 2 ] + lanes[ 3 ] +
+    sumPortable( a + i, len - i );
+}
+
+/** Add up a byte array, sixteen elements at a time.
+    @param a array to add up.
+    @param len number of elements in a.
+    @return sum of the elements.
+*/
+static unsigned int sumBytesSSE2( unsigned char const *a, int len )
+{
+  // The sum of absolute differences from zero adds up each half.
+  __m128i zero = _mm_setzero_si128();
+  __m128i sums = zero;
+  int i = 0;
+  for ( ; i + 16 <= len; i += 16 ) {
+    __m128i x = _mm_loadu_si128( (__m128i const *) ( a + i ) );
+    sums = _mm_add_epi64( sums, _mm_sad_epu8( x, zero ) );
+  }
+
+  unsigned long long halves[ 2 ];
+  _mm_storeu_si128( (__m128i *) halves, sums );
+  return (unsigned int) ( halves[ 0 ] + halves[ 1 ] ) +
+    sumBytesPortable( a + i, len - i );
+}
+
+/** Widen the range in min and max to cover an int array, four elements
+    at a time.  SSE2 has no min or max for ints, so it's done with a
+    comparison and a mask.
+    @param a array to look through.
+    @param len number of elements in a.
+    @param min smallest value so far, updated.
+    @param max largest value so far, updated.
+*/
+static void rangeSSE2( int const *a, int len, int *min, int *max )
+{
+  __m128i lo = _mm_set1_epi32( *min );
+  __m128i hi = _mm_set1_epi32( *max );
+  int i = 0;
+  for ( ; i + 4 <= len; i += 4 ) {
+    __m128i x = _mm_loadu_si128( (__m128i const *) ( a + i ) );
+    __m128i less = _mm_cmplt_epi32( x, lo );
+    lo = _mm_or_si128( _mm_and_si128( less, x ), _mm_andnot_si128( less, lo ) );
+    __m128i more = _mm_cmpgt_epi32( x, hi );
+    hi = _mm_or_si128( _mm_and_si128( more, x ), _mm_andnot_si128( more, hi ) );
+  }
+
+  int los[ 4 ], his[ 4 ];
+  _mm_storeu_si128( (__m128i *) los, lo );
+  _mm_storeu_si128( (__m128i *) his, hi );
+  rangePortable( los, 4, min, max );
+  rangePortable( his, 4, min, max );
+  rangePortable( a + i, len - i, min, max );
+}
+
+/** Widen the range in min and max to cover a byte array, sixteen
+    elements at a time.
+    @param a array to look through.
+    @param len number of elements in a.
+    @param min smallest value so far, updated.
+    @param max largest value so far, updated.
+*/
+static void rangeBytesSSE2( unsigned char const *a, int len, int *min,
+                            int *max )
+{
+  __m128i lo = _mm_set1_epi8( (char) *min );
+  __m128i hi = _mm_set1_epi8( (char) *max );
+  int i = 0;
+  for ( ; i + 16 <= len; i += 16 ) {
+    __m128i x = _mm_loadu_si128( (__m128i const *) ( a + i ) );
+    lo = _mm_min_epu8( lo, x );
+    hi = _mm_max_epu8( hi, x );
+  }
+
+  unsigned char los[ 16 ], his[ 16 ];
+  _mm_storeu_si128( (__m128i *) los, lo );
+  _mm_storeu_si128( (__m128i *) his, hi );
+  rangeBytesPortable( los, 16, min, max );
+  rangeBytesPortable( his, 16, min, max );
+  rangeBytesPortable( a + i, len - i, min, max );
+}
+
+/** Widen bytes to ints, sixteen elements at a time.
+    @param dest array to copy to.
+    @param src bytes to copy.
+    @param len number of elements.
+*/
+static void widenSSE2( int *dest, unsigned char const *src, int len )
+{
+  __m128i zero = _mm_setzero_si128();
+  int i = 0;
+  for ( ; i + 16 <= len; i += 16 ) {
+    // Interleave with zeros twice, bytes to shorts to ints.
+    __m128i bytes = _mm_loadu_si128( (__m128i const *) ( src + i ) );
+    __m128i lo = _mm_unpacklo_epi8( bytes, zero );
+    __m128i hi = _mm_unpackhi_epi8( bytes, zero );
+    __m128i *out = (__m128i *) ( dest + i );
+    _mm_storeu_si128( out, _mm_unpacklo_epi16( lo, zero ) );
+    _mm_storeu_si128( out + 1, _mm_unpackhi_epi16( lo, zero ) );
+    _mm_storeu_si128( out + 2, _mm_unpacklo_epi16( hi, zero ) );
+    _mm_storeu_si128( out + 3, _mm_unpackhi_epi16( hi, zero ) );
+  }
+  widenPortable( dest + i, src + i, len - i );
+}
+
+//////////////////////////////////////////////////////////////////////
+// AVX2 kernels, only used if the machine turns out to have AVX2.
+
+/** Find the first place two int arrays differ, eight elements at a
+    time.
+    @param a first array.
+    @param b second array.
+    @param len number of elements in each array.
+    @return index of the first difference, or len.
+*/
+__attribute__(( target( "avx2" ) ))
+static int mismatchAVX2( int const *a, int const *b, int len )
+{
+  int i = 0;
+  for ( ; i + 8 <= len; i += 8 ) {
+    __m256i x = _mm256_loadu_si256( (__m256i const *) ( a + i ) );
+    __m256i y = _mm256_loadu_si256( (__m256i const *) ( b + i ) );
+    if ( _mm256_movemask_epi8( _mm256_cmpeq_epi32( x, y ) ) != -1 )
+      break;
+  }
+  return i + mismatchPortable( a + i, b + i, len - i );
+}
+
+/** Find a value in an int array, eight elements at a time.
+    @param a array to search.
+    @param len number of elements in a.
+    @param val value to look for.
+    @return index of the first match, or -1.
+*/
+__attribute__(( target( "avx2" ) ))
+static int findAVX2( int const *a, int len, int val )
+{
+  __m256i key = _mm256_set1_epi32( val );
+  int i = 0;
+  for ( ; i + 8 <= len; i += 8 ) {
+    __m256i x = _mm256_loadu_si256( (__m256i const *) ( a + i ) );
+    int mask = _mm256_movemask_epi8( _mm256_cmpeq_epi32( x, key ) );
+    if ( mask )
+      return i + __builtin_ctz( mask ) / (int) sizeof( int );
+  }
+  int rest = findPortable( a + i, len - i, val );
+  return rest < 0 ? -1 : i + rest;
+}
+
+/** Count a value in an int array, eight elements at a time.
+    @param a array to search.
+    @param len number of elements in a.
+    @param val value to count.
+    @return number of matches.
+*/
+__attribute__(( target( "avx2" ) ))
+static int countAVX2( int const *a, int len, int val )
+{
+  __m256i key = _mm256_set1_epi32( val );
+  __m256i counts = _mm256_setzero_si256();
+  int i = 0;
+  for ( ; i + 8 <= len; i += 8 ) {
+    __m256i x = _mm256_loadu_si256( (__m256i const *) ( a + i ) );
+    counts = _mm256_sub_epi32( counts, _mm256_cmpeq_epi32( x, key ) );
+  }
+
+  int lanes[ 8 ];
+  _mm256_storeu_si256( (__m256i *) lanes, counts );
+  int count = countPortable( a + i, len - i, val );
+  for ( int j = 0; j < 8; j++ )
+    count += lanes[ j ];
+  return count;
+}
+
+/** Add up an int array, eight elements at a time.
+    @param a array to add up.
+    @param len number of elements in a.
+    @return sum of the elements.
+*/
+__attribute__(( target( "avx2" ) ))
+static unsigned int sumAVX2( int const *a, int len )
+{
+  __m256i sums = _mm256_setzero_si256();
+  int i = 0;
+  for ( ; i + 8 <= len; i += 8 ) {
+    __m256i x = _mm256_loadu_si256( (__m256i const *) ( a + i ) );
+    sums = _mm256_add_epi32( sums, x );
+  }
+
+  unsigned int lanes[ 8 ];
+  _mm256_storeu_si256( (__m256i *) lanes, sums );
+  unsigned int sum = sumPortable( a + i, len - i );
+  for ( int j = 0; j < 8; j++ )
+    sum += lanes[ j ];
+  return sum;
+}
+
+/** Widen the range in min and max to cover an int array, eight
+    elements at a time.
+    @param a array to look through.
+    @param len number of elements in a.
+    @param min smallest value so far, updated.
+    @param max largest value so far, updated.
+*/
+__attribute__(( target( "avx2" ) ))
+static void rangeAVX2( int const *a, int len, int *min, int *max )
+{
+  __m256i lo = _mm256_set1_epi32( *min );
+  __m256i hi = _mm256_set1_epi32( *max );
+  int i = 0;
+  for ( ; i + 8 <= len; i += 8 ) {
+    __m256i x = _mm256_loadu_si256( (__m256i const *) ( a + i ) );
+    lo = _mm256_min_epi32( lo, x );
+    hi = _mm256_max_epi32( hi, x );
+  }
+
+  int los[ 8 ], his[ 8 ];
+  _mm256_storeu_si256( (__m256i *) los, lo );
+  _mm256_storeu_si256( (__m256i *) his, hi );
+  rangePortable( los, 8, min, max );
+  rangePortable( his, 8, min, max );
+  rangePortable( a + i, len - i, min, max );
+}
+
+/** Widen bytes to ints, eight elements at a time.
+    @param dest array to copy to.
+    @param src bytes to copy.
+    @param len number of elements.
+*/
+__attribute__(( target( "avx2" ) ))
+static void widenAVX2( int *dest, unsigned char const *src, int len )
+{
+  int i = 0;
+  for ( ; i + 8 <= len; i += 8 ) {
+    __m128i bytes = _mm_loadl_epi64( (__m128i const *) ( src + i ) );
+    _mm256_storeu_si256( (__m256i *) ( dest + i ),
+                         _mm256_cvtepu8_epi32( bytes ) );
+  }
+  widenPortable( dest + i, src + i, len - i );
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////
+// Dispatch.
+
+/** The kernels picked for this machine. */
+static struct {
+  /** True once the kernels have been picked. */
+  bool ready;
+
+  /** Name of the instruction set they use. */
+  char const *name;
+
+  /** Kernel for mismatchInts(). */
+  int (*mismatch)( int const *a, int const *b, int len );
+
+  /** Kernel for findInts(). */
+  int (*find)( int const *a, int len, int val );
+
+  /** Kernel for countInts(). */
+  int (*count)( int const *a, int len, int val );
+
+  /** Kernel for countBytes(). */
+  int (*countBytes)( unsigned char const *a, int len, int val );
+
+  /** Kernel for sumInts(). */
+  unsigned int (*sum)( int const *a, int len );
+
+  /** Kernel for sumBytes(). */
+  unsigned int (*sumBytes)( unsigned char const *a, int len );
+
+  /** Kernel for rangeInts(). */
+  void (*range)( int const *a, int len, int *min, int *max );
+
+  /** Kernel for rangeBytes(). */
+  void (*rangeBytes)( unsigned char const *a, int len, int *min, int *max );
+
+  /** Kernel for widenBytes(). */
+  void (*widen)( int *dest, unsigned char const *src, int len );
+} kernels;
+
+/** Pick the best kernels this machine can run. */
+static void chooseKernels()
+{
+  kernels.name = "portable";
+  kernels.mismatch = mismatchPortable;
+  kernels.find = findPortable;
+  kernels.count = countPortable;
+  kernels.countBytes = countBytesPortable;
+  kernels.sum = sumPortable;
+  kernels.sumBytes = sumBytesPortable;
+  kernels.range = rangePortable;
+  kernels.rangeBytes = rangeBytesPortable;
+  kernels.widen = widenPortable;
+
+#ifdef X86_KERNELS
+  kernels.name = "sse2";
+  kernels.mismatch = mismatchSSE2;
+  kernels.find = findSSE2;
+  kernels.count = countSSE2;
+  kernels.countBytes = countBytesSSE2;
+  kernels.sum = sumSSE2;
+  kernels.sumBytes = sumBytesSSE2;
+  kernels.range = rangeSSE2;
+  kernels.rangeBytes = rangeBytesSSE2;
+  kernels.widen = widenSSE2;
+
+  // The byte kernels stay on SSE2; sixteen bytes at a time is already
+  // faster than memory can feed them.
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports( "avx2" ) ) {
+    kernels.name = "avx2";
+    kernels.mismatch = mismatchAVX2;
+    kernels.find = findAVX2;
+    kernels.count = countAVX2;
+    kernels.sum = sumAVX2;
+    kernels.range = rangeAVX2;
+    kernels.widen = widenAVX2;
+  }
+#endif
+
+  kernels.ready = true;
+}
+
+int mismatchInts( int const *a, int const *b, int len )
+{
+  if ( !kernels.ready )
+    chooseKernels();
+  return kernels.mismatch( a, b, len );
+}
+
+int findInts( int const *a, int len, int val )
+{
+  if ( !kernels.ready )
+    chooseKernels();
+  return kernels.find( a, len, val );
+}
+
+int countInts( int const *a, int len, int val )
+{
+  if ( !kernels.ready )
+    chooseKernels();
+  return kernels.count( a, len, val );
+}
+
+int countBytes( unsigned char const *a, int len, int val )
+{
+  if ( !kernels.ready )
+    chooseKernels();
+  return kernels.countBytes( a, len, val );
+}
+
+int sumInts( int const *a, int len )
+{
+  if ( !kernels.ready )
+    chooseKernels();
+  return (int) kernels.sum( a, len );
+}
+
+int sumBytes( unsigned char const *a, int len )
+{
+  if ( !kernels.ready )
+    chooseKernels();
+  return (int) kernels.sumBytes( a, len );
+}
+
+void rangeInts( int const *a, int len, int *min, int *max )
+{
+  if ( !kernels.ready )
+    chooseKernels();
+  *min = *max = a[ 0 ];
+  kernels.range( a, len, min, max );
+}
+
+void rangeBytes( unsigned char const *a, int len, int *min, int *max )
+{
+  if ( !kernels.ready )
+    chooseKernels();
+  *min = *max = a[ 0 ];
+  kernels.rangeBytes( a, len, min, max );
+}
+
+void widenBytes( int *dest, unsigned char const *src, int len )
+{
+  if ( !kernels.ready )
+    chooseKernels();
+  kernels.widen( dest, src, len );
+}
+
+void repeatBytes( void *arr, size_t size, int count )
+{
+  // memcpy already picks the fastest way to copy for this machine, so
+  // the most we can do is give it big blocks.
+  char *start = (char *) arr;
+  size_t filled = size;
+  size_t total = size * count;
+  while ( filled < total ) {
+    size_t chunk = filled < total - filled ? filled : total - filled;
+    memcpy( start + filled, start, chunk );
+    filled += chunk;
+  }
+}
+
+char const *kernelName()
+{
+  if ( !kernels.ready )
+    chooseKernels();
+  return kernels.name;
+}
@@ -0,0 +1,103 @@
+/**
+  @file kernel.h
+  @author Adrian Chan (amchan)
+
+  Bulk kernels for working on whole arrays of sequence elements at
+  once: comparing, searching, adding up, widening and repeating them.
+  On x86-64, the kernels use SSE2, or AVX2 if the machine has it,
+  chosen the first time one is called.  Everywhere else, they're plain
+  loops.
+*/
+
+#ifndef _KERNEL_H_
+#define _KERNEL_H_
+
+#include <stddef.h>
+
+/** Find the first place two arrays of ints differ.
+    @param a first array.
+    @param b second array.
+    @param len number of elements in each array.
+    @return index of the first element that's different in a and b, or
+    len if they're the same.
+*/
+int mismatchInts( int const *a, int const *b, int len );
+
+/** Find the first element of an int array that's equal to a value.
+    @param a array to search.
+    @param len number of elements in a.
+    @param val value to look for.
+    @return index of the first element equal to val, or -1 if none is.
+*/
+int findInts( int const *a, int len, int val );
+
+/** Count the elements of an int array that are equal to a value.
+    @param a array to search.
+    @param len number of elements in a.
+    @param val value to count.
+    @return number of elements equal to val.
+*/
+int countInts( int const *a, int len, int val );
+
+/** Count the elements of a byte array that are equal to a value.
+    @param a array to search.
+    @param len number of elements in a.
+    @param val value to count, from 0 to 255.
+    @return number of elements equal to val.
+*/
+int countBytes( unsigned char const *a, int len, int val );
+
+/** Add up an array of ints.  The sum wraps around like int addition
+    in the language.
+    @param a array to add up.
+    @param len number of elements in a.
+    @return sum of the elements.
+*/
+int sumInts( int const *a, int len );
+
+/** Add up an array of bytes, wrapping around like sumInts().
+    @param a array to add up.
+    @param len number of elements in a.
+    @return sum of the elements.
+*/
+int sumBytes( unsigned char const *a, int len );
+
+/** Find the smallest and largest elements of an int array.
+    @param a array to look through, with at least one element.
+    @param len number of elements in a.
+    @param min gets the smallest element.
+    @param max gets the largest element.
+*/
+void rangeInts( int const *a, int len, int *min, int *max );
+
+/** Find the smallest and largest elements of a byte array.
+    @param a array to look through, with at least one element.
+    @param len number of elements in a.
+    @param min gets the smallest element.
+    @param max gets the largest element.
+*/
+void rangeBytes( unsigned char const *a, int len, int *min, int *max );
+
+/** Copy an array of bytes to an array of ints, widening each one.
+    @param dest array with room for len ints.
+    @param src bytes to copy.
+    @param len number of elements to copy.
+*/
+void widenBytes( int *dest, unsigned char const *src, int len );
+
+/** Fill an array with copies of its first few bytes, doubling the part
+    that's filled each time so it takes a few big copies.
+    @param arr array with the bytes to repeat at the start, and room for
+    count copies of them.
+    @param size number of bytes to repeat.
+    @param count number of copies the array should hold, including the
+    one already at the start.
+*/
+void repeatBytes( void *arr, size_t size, int count );
+
+/** Return the name of the instruction set the kernels are using.
+    @return "avx2", "sse2" or "portable".
+*/
+char const *kernelName();
+
+#endif
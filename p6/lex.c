@@ -0,0 +1,275 @@
+/**
+  @file lex.c
+  @author Adrian Chan (amchan)
+  Tokenizer for the program source.
+*/
+
+// Needed for open(), fstat() and mmap().
+#define _POSIX_C_SOURCE 200809L
+
+#include "lex.h"
+#include "symbol.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/** Initial capacity for resizable arrays */
+#define INITIAL_CAPACITY 64
+
+/** Double the capacity of an array */
+#define DOUBLE_CAPACITY 2
+
+/** Number of characters inside a single-quoted string. */
+#define SINGLE_QUOTE_LENGTH 1
+
+/** Read a whole file that can't be mapped, like a pipe.
+    @param fd file descriptor to read from.
+    @param size pointer to the number of characters read.
+    @return new, dynamically allocated buffer with the file's contents.
+*/
+static char *readAll( int fd, int *size )
+{
+  int cap = INITIAL_CAPACITY;
+  char *buf = (char *) malloc( cap );
+  *size = 0;
+
+  ssize_t n;
+  while ( ( n = read( fd, buf + *size, cap - *size ) ) > 0 ) {
+    *size += n;
+    if ( *size == cap ) {
+      cap *= DOUBLE_CAPACITY;
+      buf = (char *) realloc( buf, cap );
+    }
+  }
+  return buf;
+}
+
+/** Add a token to the end of the source's token list.
+    @param src source to add to.
+    @param cap pointer to the capacity of the token list.
+    @param sym symbol for the token.
+    @param line line the token is on.
+    @param start offset of the token's text.
+    @param len length of the token's text.
+*/
+static void addToken( Source *src, int *cap, int sym, int line,
+                      int start, int len )
+{
+  if ( src->count >= *cap ) {
+    *cap *= DOUBLE_CAPACITY;
+    src->tokens = (Token *) realloc( src->tokens, *cap * sizeof( Token ) );
+  }
+  src->tokens[ src->count++ ] = (Token){ sym, line, start, len };
+}
+
+void lexSource( Source *src )
+{
+  unsigned char const *text = (unsigned char const *) src->text;
+  int size = src->size;
+
+  // Guess about how many tokens there will be.
+  int cap = size / 4 + INITIAL_CAPACITY;
+  src->tokens = (Token *) malloc( cap * sizeof( Token ) );
+  src->count = 0;
+
+  int pos = 0;
+  int line = 1;
+  while ( true ) {
+    // Skip whitespace and comments.
+    while ( pos < size && ( isspace( text[ pos ] ) || text[ pos ] == '#' ) ) {
+      // If we hit the comment characer, skip the whole line.
+      if ( text[ pos ] == '#' )
+        while ( pos < size && text[ pos ] != '\n' )
+          pos++;
+
+      if ( pos < size ) {
+        if ( text[ pos ] == '\n' )
+          line++;
+        pos++;
+      }
+    }
+
+    if ( pos >= size ) {
+      addToken( src, &cap, EndSym, line, pos, 0 );
+      return;
+    }
+
+    int start = pos;
+    int ch = text[ pos++ ];
+    if ( isalpha( ch ) || ch == '_' ) {
+      // Identifiers and reserved words are completely described by
+      // their symbol.
+      while ( pos < size && ( isalnum( text[ pos ] ) || text[ pos ] == '_' ) )
+        pos++;
+      if ( pos - start > MAX_TOKEN ) {
+        addToken( src, &cap, ErrorSym, line, start, LengthError );
+        return;
+      }
+      addToken( src, &cap, internSymbol( src->text + start, pos - start ),
+                line, start, pos - start );
+    } else if ( ch == '-' || isdigit( ch ) ) {
+      // It's a sequence of digits after the initial sign or digit.
+      while ( pos < size && isdigit( text[ pos ] ) )
+        pos++;
+      if ( pos - start > MAX_TOKEN ) {
+        addToken( src, &cap, ErrorSym, line, start, LengthError );
+        return;
+      }
+
+      // A minus sign on its own is the subtraction operator.
+      addToken( src, &cap, pos - start == 1 && ch == '-' ? MinusSym :
+                NumberSym, line, start, pos - start );
+    } else if ( ch == '"' || ch == '\'' ) {
+      // Keep reading until we hit the matching close quote, counting
+      // the characters the token would have, including the quotes.
+      int quote = ch;
+      bool escape = false;
+      int len = 1;
+      while ( ( ch = pos < size ? text[ pos++ ] : EOF ) != quote || escape ) {
+        if ( ch == EOF || ch == '\n' ) {
+          addToken( src, &cap, ErrorSym, line, start, StringError );
+          return;
+        }
+
+        // On a backslash, we just enable escape mode.
+        if ( !escape && ch == '\\' ) {
+          escape = true;
+        } else {
+          if ( escape && ch != 'n' && ch != 't' && ch != '"' && ch != '\\' ) {
+            addToken( src, &cap, ErrorSym, line, pos - 1, EscapeError );
+            return;
+          }
+          escape = false;
+
+          if ( len >= MAX_TOKEN ) {
+            addToken( src, &cap, ErrorSym, line, start, LengthError );
+            return;
+          }
+          len++;
+        }
+      }
+
+      // Make sure there would have been room for the closing quote.
+      if ( len >= MAX_TOKEN ) {
+        addToken( src, &cap, ErrorSym, line, start, LengthError );
+        return;
+      }
+      len++;
+
+      // Single-quoted strings must be exactly one character long.
+      if ( quote == '\'' && len != SINGLE_QUOTE_LENGTH + 1 + 1 ) {
+        addToken( src, &cap, ErrorSym, line, start, CharError );
+        return;
+      }
+
+      // Just keep the characters between the quotes.
+      addToken( src, &cap, quote == '"' ? StringSym : CharSym, line,
+                start + 1, pos - start - 2 );
+    } else {
+      // Is this a multi-character token?
+      if ( pos < size &&
+           ( ( ch == '=' && text[ pos ] == '=' ) ||
+             ( ch == '&' && text[ pos ] == '&' ) ||
+             ( ch == '|' && text[ pos ] == '|' ) ) )
+        pos++;
+
+      // Operators and punctuation are completely described by their
+      // symbol.
+      addToken( src, &cap, internSymbol( src->text + start, pos - start ),
+                line, start, pos - start );
+    }
+  }
+}
+
+Source *readSource( char const *filename )
+{
+  int fd = open( filename, O_RDONLY );
+  if ( fd < 0 )
+    return NULL;
+
+  Source *src = (Source *) malloc( sizeof( Source ) );
+  src->mapped = false;
+
+  // Map regular files, so we don't have to copy them.
+  struct stat st;
+  if ( fstat( fd, &st ) == 0 && S_ISREG( st.st_mode ) && st.st_size > 0 ) {
+    void *text = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    if ( text != MAP_FAILED ) {
+      src->text = (char const *) text;
+      src->size = st.st_size;
+      src->mapped = true;
+    }
+  }
+
+  if ( !src->mapped ) {
+    int size;
+    src->text = readAll( fd, &size );
+    src->size = size;
+  }
+  close( fd );
+
+  src->tokens = NULL;
+  src->count = 0;
+  return src;
+}
+
+void lexErrorMessage( Source const *src, Token const *tok, char *msg )
+{
+  switch ( tok->len ) {
+  case StringError:
+    sprintf( msg, "line %d: invalid string literal.\n", tok->line );
+    break;
+  case EscapeError:
+    sprintf( msg, "line %d: Invalid escape sequence \"\\%c\"\n",
+             tok->line, src->text[ tok->start ] );
+    break;
+  case CharError:
+    sprintf( msg, "line %d: Invalid single-quoted string\n", tok->line );
+    break;
+  case LengthError:
+    sprintf( msg, "line %d: token too long\n", tok->line );
+    break;
+  }
+}
+
+void reportLexError( Source const *src, Token const *tok )
+{
+  char msg[ MAX_ERROR_MESSAGE ];
+  lexErrorMessage( src, tok, msg );
+  fputs( msg, stderr );
+  exit( EXIT_FAILURE );
+}
+
+int literalValues( Source const *src, Token const *tok, int *vals )
+{
+  // The lexer already checked the escape sequences, so we just have
+  // to interpret them.
+  char const *text = src->text + tok->start;
+  int len = 0;
+  for ( int i = 0; i < tok->len; i++ ) {
+    char ch = text[ i ];
+    if ( ch == '\\' ) {
+      ch = text[ ++i ];
+      if ( ch == 'n' )
+        ch = '\n';
+      else if ( ch == 't' )
+        ch = '\t';
+    }
+    vals[ len++ ] = ch;
+  }
+  return len;
+}
+
+void freeSource( Source *src )
+{
+  if ( src->mapped )
+    munmap( (void *) src->text, src->size );
+  else
+    free( (void *) src->text );
+  free( src->tokens );
+  free( src );
+}
@@ -0,0 +1,114 @@
+/**
+  @file lex.h
+  @author Adrian Chan (amchan)
+
+  Tokenizer for the program source.  The whole source file is mapped
+  into memory and turned into an array of tokens up front, so the
+  parser can look ahead by index instead of reading characters one at
+  a time.
+*/
+
+#ifndef _LEX_H_
+#define _LEX_H_
+
+#include <stdbool.h>
+
+/** Maximum length of a token in the source file. */
+#define MAX_TOKEN 1023
+
+/** Kinds of errors the lexer can find.  These aren't reported until
+    the parser gets to the token, so any statements before it still
+    run first. */
+typedef enum { StringError, EscapeError, CharError, LengthError } LexError;
+
+/** Representation for a token read from the input.  Keywords, operators
+    and identifiers are interned, so they're completely described by
+    their symbol.  Literals refer back to their text in the source. */
+typedef struct {
+  /** Interned symbol for the token, NumberSym, StringSym or CharSym if
+      it's a literal, EndSym at the end of the input or ErrorSym if it
+      couldn't be read. */
+  int sym;
+
+  /** Line the token is on, starting from 1 like most editors. */
+  int line;
+
+  /** Offset of the token's text in the source.  For quoted literals,
+      this is the first character inside the quotes.  For ErrorSym,
+      it's the character that caused the error. */
+  int start;
+
+  /** Number of characters of text, not counting quotes.  For ErrorSym,
+      this is the kind of LexError. */
+  int len;
+} Token;
+
+/** A program's source text and the tokens in it. */
+typedef struct {
+  /** Text of the whole source file. */
+  char const *text;
+
+  /** Number of characters in text. */
+  int size;
+
+  /** List of tokens, ending with an EndSym or ErrorSym token, or null
+      if the source hasn't been tokenized yet. */
+  Token *tokens;
+
+  /** Number of tokens in the list. */
+  int count;
+
+  /** True if text is mapped from the file rather than copied into
+      memory we allocated. */
+  bool mapped;
+} Source;
+
+/** Read the given program file.  Files are memory-mapped if possible,
+    or read into memory if not (for pipes).  The text isn't broken into
+    tokens until lexSource() is called.
+    @param filename name of the file to read.
+    @return new, dynamically allocated source, or null if the file
+    can't be read (with errno set).
+*/
+Source *readSource( char const *filename );
+
+/** Break the source text into tokens.  This stops at the end of the
+    input or at the first token that can't be read, since the parser
+    can't get past an error anyway.
+    @param src source to tokenize.
+*/
+void lexSource( Source *src );
+
+/** Longest error message the lexer or parser can report, with room for
+    the null terminator. */
+#define MAX_ERROR_MESSAGE 100
+
+/** Build the error message for an ErrorSym token.
+    @param src source the token came from.
+    @param tok token that couldn't be read.
+    @param msg buffer with room for MAX_ERROR_MESSAGE characters, to
+    fill in with the message, ending in a newline.
+*/
+void lexErrorMessage( Source const *src, Token const *tok, char *msg );
+
+/** Print the error message for an ErrorSym token, then exit.
+    @param src source the token came from.
+    @param tok token that couldn't be read.
+*/
+void reportLexError( Source const *src, Token const *tok );
+
+/** Get the values of the characters in a string or character literal,
+    with escape sequences interpreted.
+    @param src source the token came from.
+    @param tok StringSym or CharSym token.
+    @param vals array to fill in, with room for at least tok->len values.
+    @return number of values stored in vals.
+*/
+int literalValues( Source const *src, Token const *tok, int *vals );
+
+/** Free all the memory used for the given source and its tokens.
+    @param src source to free.
+*/
+void freeSource( Source *src );
+
+#endif
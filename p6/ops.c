@@ -0,0 +1,418 @@
+/**
+  @file ops.c
+  @author Adrian Chan (amchan)
+  Operations on values in the programming language.
+*/
+
+#include "ops.h"
+#include "output.h"
+#include "stats.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+//////////////////////////////////////////////////////////////////////
+// Error-reporting functions
+
+void reportTypeMismatch()
+{
+  fprintf( stderr, "Type mismatch\n" );
+  exit( EXIT_FAILURE );
+}
+
+void reportOutOfBounds()
+{
+  fprintf( stderr, "Index out of bounds\n" );
+  exit( EXIT_FAILURE );
+}
+
+void requireIntType( Value const *v )
+{
+  if ( !isInt( *v ) )
+    reportTypeMismatch();
+}
+
+//////////////////////////////////////////////////////////////////////
+// Arithmetic
+
+/** Return the number of elements an operand adds to a concatenation.
+    @param v int or sequence operand.
+    @return number of elements in v.
+*/
+static int operandLength( Value v )
+{
+  return isInt(v) ? 1 : valueSeq(v)->len;
+}
+
+/** Add an int or the elements of a sequence to the end of the given
+    sequence, releasing the operand if it's a sequence.
+    @param s sequence to add to.
+    @param v int or sequence to add.
+*/
+static void appendOperand( Sequence *s, Value v )
+{
+  runtimeStats.addBytes += operandLength(v) * sizeof(int);
+  if (isInt(v)) {
+    pushSequence(s, valueInt(v));
+  } else {
+    extendSequence(s, valueSeq(v));
+    releaseSequence(valueSeq(v));
+  }
+}
+
+/** Return an operand of a concatenation as a sequence.
+    @param v int or sequence operand.
+    @return v if it's a sequence, or a new one-element sequence if
+    it's an int.
+*/
+static Sequence *operandSequence( Value v )
+{
+  if (isSeq(v))
+    return valueSeq(v);
+
+  Sequence *s = makeSequenceCap(1);
+  pushSequence(s, valueInt(v));
+  return s;
+}
+
+Value addValues( Value v1, Value v2 )
+{
+  if (isInt(v1) && isInt(v2)) {
+    // Return the sum of the two expression values.
+    return intValue( valueInt( v1 ) + valueInt( v2 ) );
+  }
+  
+  long long len = (long long) operandLength(v1) + operandLength(v2);
+  if (len < ROPE_MIN_LENGTH) {
+    // Size the result exactly once, then copy each operand in bulk.
+    Sequence *s = makeSequenceCap(len);
+    appendOperand(s, v1);
+    appendOperand(s, v2);
+    return seqValue(s);
+  }
+
+  // Longer results share the operands' elements in a rope.
+  Sequence *s1 = operandSequence(v1);
+  Sequence *s2 = operandSequence(v2);
+  Sequence *s = concatSequences(s1, s2);
+  releaseSequence(s1);
+  releaseSequence(s2);
+  return seqValue(s);
+}
+
+void addAssignValue( Environment *env, int slot, Value v )
+{
+  addAssignTo(&variableValues(env)[slot], v);
+}
+
+void addAssignTo( Value *var, Value v )
+{
+  Value cur = *var;
+
+  // If the variable holds the only reference to its sequence, no one
+  // else can see it change, so we can just append to it.
+  if (isSeq(cur) && valueSeq(cur)->ref == 1) {
+    appendOperand(valueSeq(cur), v);
+    return;
+  }
+
+  // Otherwise, build a new value like a normal assignment.
+  if (isSeq(cur))
+    grabSequence(valueSeq(cur));
+  Value result = addValues(cur, v);
+  storeValue(var, result);
+  if (isSeq(result))
+    releaseSequence(valueSeq(result));
+}
+
+Value subValues( Value v1, Value v2 )
+{
+  // Make sure the operands are both integers.
+  requireIntType( &v1 );
+  requireIntType( &v2 );
+
+  // Return the difference of the two expression values.
+  return intValue( valueInt( v1 ) - valueInt( v2 ) );
+}
+
+Value mulValues( Value v1, Value v2 )
+{
+  if (isInt(v1) && isInt(v2)) {
+    // Return the product of the two expression.
+    return intValue( valueInt( v1 ) * valueInt( v2 ) );
+  }
+  
+  if (isSeq(v1) && isSeq(v2))
+    reportTypeMismatch();
+  
+  Value intVal = isInt(v1) ? v1 : v2;
+  Value seqVal = isInt(v1) ? v2 : v1;
+  
+  int count = valueInt(intVal) < 0 ? 0 : valueInt(intVal);
+  Sequence *s = repeatSequence(valueSeq(seqVal), count);
+  
+  releaseSequence(valueSeq(seqVal));
+  return seqValue(s);
+}
+
+Value divValues( Value v1, Value v2 )
+{
+  // Make sure the operands are both integers.
+  requireIntType( &v1 );
+  requireIntType( &v2 );
+
+  // Catch it if we try to divide by zero.
+  if ( valueInt( v2 ) == 0 ) {
+    fprintf( stderr, "Divide by zero\n" );
+    exit( EXIT_FAILURE );
+  }
+
+  // Return the quotient of the two expression.
+  return intValue( valueInt( v1 ) / valueInt( v2 ) );
+}
+
+//////////////////////////////////////////////////////////////////////
+// Comparison
+
+Value lessValues( Value v1, Value v2 )
+{
+  // Make sure the operands are both the same type.
+  if ( valueType( v1 ) != valueType( v2 ) )
+    reportTypeMismatch();
+
+  if ( isInt( v1 ) ) {
+    // Is v1 less than v2
+    return intValue( valueInt( v1 ) < valueInt( v2 ) ? true : false );
+  }
+
+  // Compare sequences element by element, then by length.
+  bool result = compareSequences(valueSeq(v1), valueSeq(v2)) < 0;
+
+  releaseSequence(valueSeq(v1));
+  releaseSequence(valueSeq(v2));
+  return intValue( result );
+}
+
+Value equalsValues( Value v1, Value v2 )
+{
+  if ( isInt( v1 ) && isInt( v2 ) )
+    return intValue( ( valueInt( v1 ) == valueInt( v2 ) ) );
+
+  // A sequence can also be compared to an int, but they should
+  // never be considered equal.
+  if (isInt(v1)) {
+    releaseSequence(valueSeq(v2));
+    return intValue(false);
+  } else if (isInt(v2)) {
+    releaseSequence(valueSeq(v1));
+    return intValue(false);
+  }
+  
+  bool result = valueSeq(v1)->len == valueSeq(v2)->len;
+  if (result && valueSeq(v1) != valueSeq(v2))
+    result = compareSequences(valueSeq(v1), valueSeq(v2)) == 0;
+  
+  releaseSequence(valueSeq(v1));
+  releaseSequence(valueSeq(v2));
+  return intValue(result);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Sequences
+
+Value seqInitValues( int len, Value const *vals )
+{
+  Sequence *s = makeSequenceCap(len);
+  runtimeStats.seqInitBytes += len * sizeof(int);
+  for (int i = 0; i < len; i++)
+    pushSequence(s, valueInt(vals[i]));
+  
+  return seqValue(s);
+}
+
+Value indexValue( Value seq, Value idx )
+{
+  if (!isSeq(seq) || !isInt(idx))
+    reportTypeMismatch();
+
+  Sequence *s = valueSeq(seq);
+  int id = valueInt(idx);
+  if (id < 0 || id >= s->len)
+    reportOutOfBounds();
+  
+  int val = sequenceElement(s, id);
+  releaseSequence(s);
+  return intValue(val);
+}
+
+Value lenValue( Value seq )
+{
+  if (!isSeq(seq))
+    reportTypeMismatch();
+
+  int len = valueSeq(seq)->len;
+  releaseSequence(valueSeq(seq));
+  return intValue(len);
+}
+
+void printValue( Value v )
+{
+  // Print the value appropriately, based on its type.
+  if ( isInt( v ) ) {
+    outputInt( valueInt( v ) );
+  } else {
+    // Print a sequence as a string of ASCII character codes.  Byte
+    // sequences are already stored that way.
+    Sequence *s = valueSeq(v);
+    if (s->width == BYTE_WIDTH)
+      outputBytes(sequenceBytes(s), s->len);
+    else
+      outputChars(sequenceElements(s), s->len);
+        
+    releaseSequence(valueSeq(v));
+  }
+}
+
+void pushValue( Value seq, Value v )
+{
+  if (!isSeq(seq) || !isInt(v))
+    reportTypeMismatch();
+
+  // Pushing onto a literal changes a copy of it, not the constant
+  // shared by every evaluation.
+  Sequence *s = valueSeq(seq);
+  if (s->constant) {
+    s = shareSequence(valueSeq(seq));
+    releaseSequence(valueSeq(seq));
+  }
+
+  pushSequence(s, valueInt(v));
+  releaseSequence(s);
+}
+
+void storeIndexValue( Value seq, Value idx, Value v )
+{
+  if (!isSeq(seq) || !isInt(idx) || !isInt(v))
+    reportTypeMismatch();
+
+  if (valueInt(idx) < 0 || valueInt(idx) >= valueSeq(seq)->len)
+    reportOutOfBounds();
+
+  storeSequence(valueSeq(seq), valueInt(idx), valueInt(v));
+}
+
+//////////////////////////////////////////////////////////////////////
+// Built-in functions
+
+/** Description of a built-in function. */
+typedef struct {
+  /** Name it's called by. */
+  char const *name;
+
+  /** Number of arguments it takes. */
+  int args;
+
+  /** True if it gives an int, false if it gives a sequence. */
+  bool givesInt;
+} BuiltinInfo;
+
+/** Descriptions of the built-in functions, indexed by Builtin. */
+static BuiltinInfo const builtins[ BuiltinCount ] = {
+  [ SliceBuiltin ] = { "slice", 3, false },
+  [ SumBuiltin ] = { "sum", 1, true },
+  [ MinBuiltin ] = { "min", 1, true },
+  [ MaxBuiltin ] = { "max", 1, true },
+  [ FindBuiltin ] = { "find", 2, true },
+  [ CountBuiltin ] = { "count", 2, true },
+  [ SortBuiltin ] = { "sort", 1, false },
+  [ ReverseBuiltin ] = { "reverse", 1, false },
+  [ FillBuiltin ] = { "fill", 2, false }
+};
+
+int findBuiltin( char const *name )
+{
+  for ( int fn = 0; fn < BuiltinCount; fn++ )
+    if ( strcmp( builtins[ fn ].name, name ) == 0 )
+      return fn;
+  return -1;
+}
+
+char const *builtinName( Builtin fn )
+{
+  return builtins[ fn ].name;
+}
+
+int builtinArgCount( Builtin fn )
+{
+  return builtins[ fn ].args;
+}
+
+bool builtinGivesInt( Builtin fn )
+{
+  return builtins[ fn ].givesInt;
+}
+
+Value callBuiltin( Builtin fn, Value const *args )
+{
+  // Every function but fill takes a sequence, then ints.
+  for ( int i = 0; i < builtins[ fn ].args; i++ ) {
+    bool wantSeq = i == 0 && fn != FillBuiltin;
+    if ( isSeq( args[ i ] ) != wantSeq )
+      reportTypeMismatch();
+  }
+
+  if ( fn == FillBuiltin ) {
+    // Like repetition, a negative count gives an empty sequence.
+    int len = valueInt( args[ 0 ] ) < 0 ? 0 : valueInt( args[ 0 ] );
+    return seqValue( fillSequence( len, valueInt( args[ 1 ] ) ) );
+  }
+
+  Sequence *s = valueSeq( args[ 0 ] );
+  Value result = intValue( 0 );
+  switch ( fn ) {
+  case SliceBuiltin: {
+    int lo = valueInt( args[ 1 ] );
+    int hi = valueInt( args[ 2 ] );
+    if ( lo < 0 || hi < lo || hi > s->len )
+      reportOutOfBounds();
+    result = seqValue( sliceSequence( s, lo, hi ) );
+    break;
+  }
+
+  case SumBuiltin:
+    result = intValue( sumSequence( s ) );
+    break;
+
+  case MinBuiltin:
+  case MaxBuiltin: {
+    if ( s->len == 0 )
+      reportOutOfBounds();
+    int min, max;
+    sequenceRange( s, &min, &max );
+    result = intValue( fn == MinBuiltin ? min : max );
+    break;
+  }
+
+  case FindBuiltin:
+    result = intValue( findInSequence( s, valueInt( args[ 1 ] ) ) );
+    break;
+
+  case CountBuiltin:
+    result = intValue( countInSequence( s, valueInt( args[ 1 ] ) ) );
+    break;
+
+  case SortBuiltin:
+    result = seqValue( sortSequence( s ) );
+    break;
+
+  case ReverseBuiltin:
+    result = seqValue( reverseSequence( s ) );
+    break;
+
+  default:
+    break;
+  }
+
+  releaseSequence( s );
+  return result;
+}
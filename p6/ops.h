@@ -0,0 +1,197 @@
+/**
+  @file ops.h
+  @author Adrian Chan (amchan)
+
+  Operations on values in our language.  Both the tree-walking
+  evaluator in syntax.c and the bytecode VM use these, so the two
+  always agree on what an operator does.
+*/
+
+#ifndef _OPS_H_
+#define _OPS_H_
+
+#include "value.h"
+
+/** Report an error for a program with bad types, then exit. */
+void reportTypeMismatch();
+
+/** Report an error for an index outside a sequence, then exit. */
+void reportOutOfBounds();
+
+/** Require a given value to be an IntType value.  Exit with an error
+    message if not.
+    @param v value to check, passed by address.
+ */
+void requireIntType( Value const *v );
+
+/** Each of the following operations takes ownership of any sequence
+    references held by its operands, releasing them before it returns.
+    The result holds its own reference if it's a sequence. */
+
+/** Add two ints, or concatenate two sequences (or a sequence and an
+    int).
+    @param v1 left-hand operand.
+    @param v2 right-hand operand.
+    @return sum or concatenation of the two operands.
+*/
+Value addValues( Value v1, Value v2 );
+
+/** Perform the assignment var = var + v.  If the variable holds the
+    only reference to a sequence, v is appended to it in place, so
+    building a sequence with repeated concatenation takes amortized
+    linear time.
+    @param env environment containing the variable.
+    @param slot slot for the variable.
+    @param v right-hand operand of the addition.
+*/
+void addAssignValue( Environment *env, int slot, Value v );
+
+/** Perform the assignment var = var + v on a variable kept outside any
+    environment, appending in place like addAssignValue().
+    @param var variable to add to.
+    @param v right-hand operand of the addition.
+*/
+void addAssignTo( Value *var, Value v );
+
+/** Subtract one int from another.
+    @param v1 left-hand operand.
+    @param v2 right-hand operand.
+    @return difference of the two operands.
+*/
+Value subValues( Value v1, Value v2 );
+
+/** Multiply two ints, or repeat a sequence the given number of times.
+    @param v1 left-hand operand.
+    @param v2 right-hand operand.
+    @return product of the two operands, or the repeated sequence.
+*/
+Value mulValues( Value v1, Value v2 );
+
+/** Divide one int by another, exiting on division by zero.
+    @param v1 left-hand operand.
+    @param v2 right-hand operand.
+    @return quotient of the two operands.
+*/
+Value divValues( Value v1, Value v2 );
+
+/** Compare two ints, or two sequences lexicographically.
+    @param v1 left-hand operand.
+    @param v2 right-hand operand.
+    @return true if v1 is less than v2.
+*/
+Value lessValues( Value v1, Value v2 );
+
+/** Compare two values for equality.  A sequence is never equal to an
+    int.
+    @param v1 left-hand operand.
+    @param v2 right-hand operand.
+    @return true if the two values are equal.
+*/
+Value equalsValues( Value v1, Value v2 );
+
+/** Build a new sequence from a list of element values.
+    @param len number of elements.
+    @param vals values of the elements, in order.
+    @return the new sequence.
+*/
+Value seqInitValues( int len, Value const *vals );
+
+/** Get one element of a sequence, exiting if the index is out of bounds.
+    @param seq sequence to index.
+    @param idx index of the element we want.
+    @return the requested element.
+*/
+Value indexValue( Value seq, Value idx );
+
+/** Get the length of a sequence.
+    @param seq sequence to measure.
+    @return length of the sequence.
+*/
+Value lenValue( Value seq );
+
+/** Print a value, as a decimal int or as a string of character codes.
+    @param v value to print.
+*/
+void printValue( Value v );
+
+/** Add an int to the end of a sequence.
+    @param seq sequence to push onto.
+    @param v value to push.
+*/
+void pushValue( Value seq, Value v );
+
+/** Change one element of a sequence, exiting if the index is out of
+    bounds or the new value isn't an int.  Unlike the others, this
+    doesn't take ownership of its operands.
+    @param seq sequence containing the element.
+    @param idx index of the element to change.
+    @param v new value for the element.
+*/
+void storeIndexValue( Value seq, Value idx, Value v );
+
+//////////////////////////////////////////////////////////////////////
+// Built-in functions
+
+/** Built-in functions, called like sum( a ).  Each one works on a
+    whole sequence in one loop in C.  Their names aren't reserved, so
+    they can still be used as variables. */
+typedef enum {
+  /** slice( s, lo, hi ): a new sequence with the elements of s from
+      index lo up to, but not including, index hi. */
+  SliceBuiltin,
+  /** sum( s ): the sum of the elements of s. */
+  SumBuiltin,
+  /** min( s ), max( s ): the smallest or largest element of s, which
+      can't be empty. */
+  MinBuiltin, MaxBuiltin,
+  /** find( s, v ): the index of the first element of s equal to v, or
+      -1 if there isn't one. */
+  FindBuiltin,
+  /** count( s, v ): the number of elements of s equal to v. */
+  CountBuiltin,
+  /** sort( s ), reverse( s ): a new sequence with the elements of s in
+      increasing or in reverse order. */
+  SortBuiltin, ReverseBuiltin,
+  /** fill( n, v ): a new sequence of n copies of v. */
+  FillBuiltin,
+  /** Number of built-in functions. */
+  BuiltinCount
+} Builtin;
+
+/** Most arguments any built-in function takes. */
+#define MAX_BUILTIN_ARGS 3
+
+/** Look up a built-in function by name.
+    @param name name to look up.
+    @return the function, or -1 if there isn't one with that name.
+*/
+int findBuiltin( char const *name );
+
+/** Return the name of a built-in function.
+    @param fn built-in function.
+    @return its name.
+*/
+char const *builtinName( Builtin fn );
+
+/** Return the number of arguments a built-in function takes.
+    @param fn built-in function.
+    @return number of arguments, at most MAX_BUILTIN_ARGS.
+*/
+int builtinArgCount( Builtin fn );
+
+/** Return true if a built-in function gives an int, rather than a
+    sequence.
+    @param fn built-in function.
+    @return true if it always gives an int (or exits with an error).
+*/
+bool builtinGivesInt( Builtin fn );
+
+/** Call a built-in function.  Like the operations, this takes ownership
+    of the sequence references held by its arguments.
+    @param fn function to call.
+    @param args values of its arguments, builtinArgCount( fn ) of them.
+    @return result of the function.
+*/
+Value callBuiltin( Builtin fn, Value const *args );
+
+#endif
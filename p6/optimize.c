@@ -0,0 +1,750 @@
+/**
+  @file optimize.c
+  @author Adrian Chan (amchan)
+  Optimization pass over the parsed statement tree.
+*/
+
+#include "optimize.h"
+#include "ops.h"
+#include "symbol.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+/** Initial capacity for the resizable array of statements in a
+    flattened compound. */
+#define INITIAL_CAPACITY 5
+
+/** Double the capacity of an array */
+#define DOUBLE_CAPACITY 2
+
+/** Number of while loops the statement being optimized is nested in.
+    Values hoisted out of a loop's condition are kept in variables named
+    for the depth, so nested loops don't share them. */
+static int loopDepth;
+
+/** What the body of a loop might change, for finding the parts of its
+    condition that come out the same every time. */
+typedef struct {
+  /** For each variable slot, true if the body might assign to it. */
+  bool *assigned;
+
+  /** True if the body might push onto a sequence.  Sequences can be
+      shared, so a push through any variable might change the length of
+      any of them. */
+  bool pushes;
+
+  /** True if the body might change an element of a sequence. */
+  bool stores;
+} Effects;
+
+/** State for hoisting values out of a loop condition. */
+typedef struct {
+  /** What the loop body might change. */
+  Effects effects;
+
+  /** Assignments that compute the hoisted values, to run before the
+      loop. */
+  Stmt **assignments;
+
+  /** Number of hoisted values. */
+  int len;
+
+  /** Capacity of the assignments list. */
+  int cap;
+
+  /** True once the condition has evaluated something that could fail
+      before the expression being looked at.  Hoisting anything after
+      that could report a different error. */
+  bool mayFail;
+} Hoist;
+
+/** Return true if the given expression is a literal int.
+    @param expr expression to check.
+    @param val if non-null, this gets the literal's value.
+    @return true if expr is a LiteralInt.
+*/
+static bool isLiteral( Expr *expr, int *val )
+{
+  if ( expr->kind != LiteralIntKind )
+    return false;
+  if ( val )
+    *val = ( (LiteralInt *) expr )->val;
+  return true;
+}
+
+/** Return true if the given expression always evaluates to an int (or
+    exits with an error).
+    @param expr expression to check.
+    @return true if expr is sure to be an int.
+*/
+static bool isIntExpr( Expr *expr )
+{
+  switch ( expr->kind ) {
+  case LiteralIntKind:
+  case SubKind:
+  case DivKind:
+  case AndKind:
+  case OrKind:
+  case LessKind:
+  case EqualsKind:
+  case IndexKind:
+  case LenKind:
+    return true;
+
+  case AddKind:
+  case MulKind:
+    // These give an int if both operands are ints.
+    return isIntExpr( ( (SimpleExpr *) expr )->expr1 ) &&
+      isIntExpr( ( (SimpleExpr *) expr )->expr2 );
+
+  case CallKind:
+    return builtinGivesInt( ( (CallExpr *) expr )->fn );
+
+  default:
+    return false;
+  }
+}
+
+/** Return true if evaluating the given expression can't fail, so it's
+    safe to skip evaluating it.
+    @param expr expression to check.
+    @return true if expr can be evaluated without an error.
+*/
+static bool cannotFail( Expr *expr )
+{
+  SimpleExpr *simple = (SimpleExpr *) expr;
+  switch ( expr->kind ) {
+  case LiteralIntKind:
+  case SeqLiteralKind:
+  case VariableKind:
+    return true;
+
+  case AddKind:
+  case EqualsKind:
+    // These work for any types.
+    return cannotFail( simple->expr1 ) && cannotFail( simple->expr2 );
+
+  case SubKind:
+  case MulKind:
+  case LessKind:
+    // These are fine as long as both operands are ints.
+    return cannotFail( simple->expr1 ) && cannotFail( simple->expr2 ) &&
+      isIntExpr( simple->expr1 ) && isIntExpr( simple->expr2 );
+
+  default:
+    return false;
+  }
+}
+
+/** Optimize the given expression.
+    @param expr expression to optimize.
+    @return optimized expression, which may be a new node or a part of
+    expr.
+*/
+static Expr *optimizeExpr( Expr *expr )
+{
+  // Optimize the children first.
+  if ( expr->kind == SeqInitKind ) {
+    SequenceExpr *seq = (SequenceExpr *) expr;
+    bool literal = true;
+    for ( int i = 0; i < seq->len; i++ ) {
+      seq->expList[ i ] = optimizeExpr( seq->expList[ i ] );
+      literal = literal && isLiteral( seq->expList[ i ], NULL );
+    }
+
+    // A list of literal ints can be a constant, like a string literal.
+    if ( literal ) {
+      setSyntaxLine( expr->line );
+      int vals[ seq->len + 1 ];
+      for ( int i = 0; i < seq->len; i++ )
+        isLiteral( seq->expList[ i ], &vals[ i ] );
+      return makeSeqLiteral( seq->len, vals );
+    }
+    return expr;
+  }
+
+  // Calls aren't folded, since they work on sequences.
+  if ( expr->kind == CallKind ) {
+    CallExpr *call = (CallExpr *) expr;
+    for ( int i = 0; i < call->len; i++ )
+      call->expList[ i ] = optimizeExpr( call->expList[ i ] );
+    return expr;
+  }
+
+  if ( expr->kind == LiteralIntKind || expr->kind == SeqLiteralKind ||
+       expr->kind == VariableKind )
+    return expr;
+
+  SimpleExpr *this = (SimpleExpr *) expr;
+  this->expr1 = optimizeExpr( this->expr1 );
+  if ( this->expr2 )
+    this->expr2 = optimizeExpr( this->expr2 );
+
+  // Any new node we make replaces this one, so it's on the same line.
+  setSyntaxLine( expr->line );
+
+  int a, b;
+  bool leftLit = isLiteral( this->expr1, &a );
+  bool rightLit = this->expr2 && isLiteral( this->expr2, &b );
+
+  // The length of a sequence literal is known.
+  if ( expr->kind == LenKind && this->expr1->kind == SeqLiteralKind )
+    return makeLiteralInt( ( (SeqLiteral *) this->expr1 )->seq->len );
+
+  // So is the length of a sequence built from a list, as long as
+  // making the sequence can't fail.
+  if ( expr->kind == LenKind && this->expr1->kind == SeqInitKind ) {
+    int len = ( (SequenceExpr *) this->expr1 )->len;
+    bool ok = true;
+    for ( int i = 0; i < len; i++ )
+      ok = ok && cannotFail( ( (SequenceExpr *) this->expr1 )->expList[ i ] );
+    if ( ok )
+      return makeLiteralInt( len );
+  }
+
+  // Fold operators on two literals, using the same operations the
+  // interpreter would use at run time.
+  if ( leftLit && rightLit ) {
+    Value v1 = intValue( a );
+    Value v2 = intValue( b );
+    switch ( expr->kind ) {
+    case AddKind:
+      return makeLiteralInt( valueInt( addValues( v1, v2 ) ) );
+    case SubKind:
+      return makeLiteralInt( valueInt( subValues( v1, v2 ) ) );
+    case MulKind:
+      return makeLiteralInt( valueInt( mulValues( v1, v2 ) ) );
+    case DivKind:
+      // Leave division by zero for the interpreter to report.
+      if ( b != 0 )
+        return makeLiteralInt( valueInt( divValues( v1, v2 ) ) );
+      break;
+    case LessKind:
+      return makeLiteralInt( valueInt( lessValues( v1, v2 ) ) );
+    case EqualsKind:
+      return makeLiteralInt( valueInt( equalsValues( v1, v2 ) ) );
+    default:
+      break;
+    }
+  }
+
+  switch ( expr->kind ) {
+  case AndKind:
+  case OrKind:
+    // A literal on the left decides whether the right is evaluated.
+    if ( leftLit ) {
+      bool shortCircuit = expr->kind == AndKind ? a == 0 : a != 0;
+      if ( shortCircuit )
+        return makeLiteralInt( a );
+      if ( rightLit )
+        return makeLiteralInt( b );
+    }
+    break;
+
+  case AddKind:
+    // x + 0 and 0 + x are just x, if x is an int.
+    if ( rightLit && b == 0 && isIntExpr( this->expr1 ) )
+      return this->expr1;
+    if ( leftLit && a == 0 && isIntExpr( this->expr2 ) )
+      return this->expr2;
+    break;
+
+  case SubKind:
+  case DivKind:
+    // x - 0 and x / 1 are just x, if x is an int.
+    if ( rightLit && b == ( expr->kind == SubKind ? 0 : 1 ) &&
+         isIntExpr( this->expr1 ) )
+      return this->expr1;
+    break;
+
+  case MulKind:
+    // x * 1 and 1 * x are just x, if x is an int.
+    if ( rightLit && b == 1 && isIntExpr( this->expr1 ) )
+      return this->expr1;
+    if ( leftLit && a == 1 && isIntExpr( this->expr2 ) )
+      return this->expr2;
+
+    // x * 0 and 0 * x are zero, if x is an int we don't have to evaluate.
+    if ( ( rightLit && b == 0 && isIntExpr( this->expr1 ) &&
+           cannotFail( this->expr1 ) ) ||
+         ( leftLit && a == 0 && isIntExpr( this->expr2 ) &&
+           cannotFail( this->expr2 ) ) )
+      return makeLiteralInt( 0 );
+    break;
+
+  default:
+    break;
+  }
+
+  return expr;
+}
+
+/** Record what a statement in a loop body might change.
+    @param stmt statement to look at.
+    @param effects effects to add to.
+*/
+static void findEffects( Stmt *stmt, Effects *effects )
+{
+  switch ( stmt->kind ) {
+  case PushKind:
+    effects->pushes = true;
+    break;
+
+  case AssignmentKind: {
+    AssignmentStmt *this = (AssignmentStmt *) stmt;
+    if ( this->iexpr )
+      effects->stores = true;
+    else
+      effects->assigned[ this->slot ] = true;
+    break;
+  }
+
+  case CompoundKind: {
+    CompoundStmt *this = (CompoundStmt *) stmt;
+    for ( int i = 0; i < this->len; i++ )
+      findEffects( this->stmtList[ i ], effects );
+    break;
+  }
+
+  case IfKind:
+  case WhileKind:
+    findEffects( ( (ConditionalStmt *) stmt )->body, effects );
+    break;
+
+  default:
+    break;
+  }
+}
+
+/** Return true if the given expression gives the same value every time
+    it's evaluated in a loop.
+    @param expr expression to check.
+    @param effects what the loop body might change.
+    @return true if nothing in the loop can change expr's value.
+*/
+static bool isInvariant( Expr *expr, Effects const *effects )
+{
+  switch ( expr->kind ) {
+  case LiteralIntKind:
+  case SeqLiteralKind:
+    return true;
+
+  case VariableKind:
+    return !effects->assigned[ ( (VariableExpr *) expr )->slot ];
+
+  case CallKind:
+    // Calls look at every element of their sequence.
+    if ( effects->pushes || effects->stores )
+      return false;
+    // Fall through to check the arguments.
+
+  case SeqInitKind: {
+    SequenceExpr *seq = (SequenceExpr *) expr;
+    for ( int i = 0; i < seq->len; i++ )
+      if ( !isInvariant( seq->expList[ i ], effects ) )
+        return false;
+    return true;
+  }
+
+  case LenKind:
+    if ( effects->pushes )
+      return false;
+    break;
+
+  case IndexKind:
+    if ( effects->pushes || effects->stores )
+      return false;
+    break;
+
+  default:
+    break;
+  }
+
+  SimpleExpr *this = (SimpleExpr *) expr;
+  return isInvariant( this->expr1, effects ) &&
+    ( !this->expr2 || isInvariant( this->expr2, effects ) );
+}
+
+/** Replace the parts of a loop condition that come out the same every
+    time with variables computed before the loop.  Only ints are hoisted,
+    and only if they're evaluated every time the condition is, so
+    computing them early can't do anything the loop wouldn't.
+    @param expr part of the condition to look at.
+    @param conditional true if expr might not be evaluated, because it's
+    on the right of an and or an or.
+    @param hoist state for the values hoisted so far.
+    @return expr, or a variable that holds its value.
+*/
+static Expr *hoistExpr( Expr *expr, bool conditional, Hoist *hoist )
+{
+  if ( expr->kind == LiteralIntKind || expr->kind == SeqLiteralKind ||
+       expr->kind == VariableKind )
+    return expr;
+
+  if ( !conditional && !hoist->mayFail && isIntExpr( expr ) &&
+       isInvariant( expr, &hoist->effects ) ) {
+    // Name the variable so it can't be a user's variable.
+    char name[ MAX_VAR_NAME + 1 ];
+    snprintf( name, sizeof( name ), "$%d.%d", loopDepth, hoist->len );
+    int slot = variableSlot( internSymbol( name, strlen( name ) ) );
+
+    // Leave room at the end of the list for the loop itself.
+    if ( hoist->len + 1 >= hoist->cap ) {
+      hoist->cap = hoist->cap ? hoist->cap * DOUBLE_CAPACITY :
+        INITIAL_CAPACITY;
+      hoist->assignments = (Stmt **)
+        realloc( hoist->assignments, hoist->cap * sizeof( Stmt * ) );
+    }
+    setSyntaxLine( expr->line );
+    hoist->assignments[ hoist->len++ ] = makeAssignment( slot, NULL, expr );
+    return makeVariable( slot );
+  }
+
+  if ( expr->kind == SeqInitKind || expr->kind == CallKind ) {
+    SequenceExpr *seq = (SequenceExpr *) expr;
+    for ( int i = 0; i < seq->len; i++ )
+      seq->expList[ i ] = hoistExpr( seq->expList[ i ], conditional, hoist );
+  } else {
+    SimpleExpr *this = (SimpleExpr *) expr;
+    this->expr1 = hoistExpr( this->expr1, conditional, hoist );
+    if ( this->expr2 )
+      this->expr2 = hoistExpr( this->expr2, conditional ||
+                               expr->kind == AndKind || expr->kind == OrKind,
+                               hoist );
+  }
+
+  if ( !cannotFail( expr ) )
+    hoist->mayFail = true;
+  return expr;
+}
+
+/** Hoist the parts of a while loop's condition that come out the same
+    every time out of the loop, like len a in i < len a, so they're
+    only computed once.
+    @param this while loop, already optimized.
+    @return the loop, or a compound that computes the hoisted values and
+    then runs the loop.
+*/
+static Stmt *hoistInvariants( ConditionalStmt *this )
+{
+  Hoist hoist = { { (bool *) calloc( variableCount() + 1, sizeof( bool ) ),
+                    false, false }, NULL, 0, 0, false };
+  findEffects( this->body, &hoist.effects );
+  this->cond = hoistExpr( this->cond, false, &hoist );
+  free( hoist.effects.assigned );
+
+  Stmt *result = (Stmt *) this;
+  if ( hoist.len > 0 ) {
+    hoist.assignments[ hoist.len ] = result;
+    setSyntaxLine( this->line );
+    result = makeCompound( hoist.len + 1, hoist.assignments );
+  }
+  free( hoist.assignments );
+  return result;
+}
+
+/** Return true if a statement has the form i = i + 1.
+    @param stmt statement to check.
+    @param slot slot for i.
+    @return true if stmt adds one to the variable.
+*/
+static bool isIncrement( Stmt *stmt, int slot )
+{
+  if ( stmt->kind != AssignmentKind )
+    return false;
+  AssignmentStmt *this = (AssignmentStmt *) stmt;
+  int val;
+  return this->slot == slot &&
+    isAddAssignment( this->slot, this->iexpr, this->expr ) &&
+    isLiteral( ( (SimpleExpr *) this->expr )->expr2, &val ) && val == 1;
+}
+
+/** Return true if a statement might assign to a variable.
+    @param stmt statement to check.
+    @param slot slot for the variable.
+    @return true if stmt or anything in it assigns to the variable.
+*/
+static bool assignsVariable( Stmt *stmt, int slot )
+{
+  Effects effects = { (bool *) calloc( variableCount() + 1, sizeof( bool ) ),
+                      false, false };
+  findEffects( stmt, &effects );
+  bool assigned = effects.assigned[ slot ];
+  free( effects.assigned );
+  return assigned;
+}
+
+/** Return true if i only changes in a loop body by i = i + 1, and never
+    in a loop nested in the body.  Then, it can only go up by a few
+    each time through the body, so it can't overflow.
+    @param stmt statement in the body to check.
+    @param slot slot for i.
+    @param nested true if stmt is inside a nested loop.
+    @return true if the only assignments to i are increments.
+*/
+static bool onlyIncrements( Stmt *stmt, int slot, bool nested )
+{
+  switch ( stmt->kind ) {
+  case AssignmentKind:
+    return ( (AssignmentStmt *) stmt )->slot != slot ||
+      ( !nested && isIncrement( stmt, slot ) );
+
+  case CompoundKind: {
+    CompoundStmt *this = (CompoundStmt *) stmt;
+    for ( int i = 0; i < this->len; i++ )
+      if ( !onlyIncrements( this->stmtList[ i ], slot, nested ) )
+        return false;
+    return true;
+  }
+
+  case IfKind:
+  case WhileKind:
+    return onlyIncrements( ( (ConditionalStmt *) stmt )->body, slot,
+                           nested || stmt->kind == WhileKind );
+
+  default:
+    return true;
+  }
+}
+
+/** Skip the checks on a[ i ] anywhere in an expression.
+    @param expr expression that's only evaluated while i is still less
+    than the length of a.
+    @param i slot for the index variable.
+    @param a slot for the sequence variable.
+    @return number of index expressions changed.
+*/
+static int skipExprChecks( Expr *expr, int i, int a )
+{
+  if ( expr->kind == LiteralIntKind || expr->kind == SeqLiteralKind ||
+       expr->kind == VariableKind )
+    return 0;
+
+  int count = 0;
+  if ( expr->kind == SeqInitKind || expr->kind == CallKind ) {
+    SequenceExpr *seq = (SequenceExpr *) expr;
+    for ( int j = 0; j < seq->len; j++ )
+      count += skipExprChecks( seq->expList[ j ], i, a );
+    return count;
+  }
+
+  SimpleExpr *this = (SimpleExpr *) expr;
+  if ( expr->kind == IndexKind && this->expr1->kind == VariableKind &&
+       this->expr2->kind == VariableKind &&
+       ( (VariableExpr *) this->expr1 )->slot == a &&
+       ( (VariableExpr *) this->expr2 )->slot == i )
+    return skipIndexChecks( expr );
+
+  count += skipExprChecks( this->expr1, i, a );
+  if ( this->expr2 )
+    count += skipExprChecks( this->expr2, i, a );
+  return count;
+}
+
+/** Skip the checks on a[ i ] in the part of a loop body that runs
+    before i changes.
+    @param stmt statement in the loop body.
+    @param i slot for the index variable.
+    @param a slot for the sequence variable.
+    @param unchanged true if i can't have changed since the condition
+    was checked, before stmt starts.
+    @param count gets the number of index expressions changed added to
+    it.
+    @return true if i still can't have changed after stmt.
+*/
+static bool skipStmtChecks( Stmt *stmt, int i, int a, bool unchanged,
+                            int *count )
+{
+  switch ( stmt->kind ) {
+  case PrintKind:
+  case PushKind: {
+    SimpleStmt *this = (SimpleStmt *) stmt;
+    if ( unchanged ) {
+      *count += skipExprChecks( this->expr1, i, a );
+      if ( this->expr2 )
+        *count += skipExprChecks( this->expr2, i, a );
+    }
+    return unchanged;
+  }
+
+  case AssignmentKind: {
+    // The right-hand side is evaluated before the assignment.
+    AssignmentStmt *this = (AssignmentStmt *) stmt;
+    if ( unchanged ) {
+      *count += skipExprChecks( this->expr, i, a );
+      if ( this->iexpr )
+        *count += skipExprChecks( this->iexpr, i, a );
+    }
+    return unchanged && ( this->iexpr || this->slot != i );
+  }
+
+  case CompoundKind: {
+    CompoundStmt *this = (CompoundStmt *) stmt;
+    for ( int j = 0; j < this->len; j++ )
+      unchanged = skipStmtChecks( this->stmtList[ j ], i, a, unchanged,
+                                  count );
+    return unchanged;
+  }
+
+  case IfKind:
+  case WhileKind: {
+    // A loop that changes i might change it before its condition is
+    // checked again.
+    ConditionalStmt *this = (ConditionalStmt *) stmt;
+    bool changes = assignsVariable( stmt, i );
+    if ( stmt->kind == WhileKind && changes )
+      unchanged = false;
+    if ( unchanged )
+      *count += skipExprChecks( this->cond, i, a );
+    skipStmtChecks( this->body, i, a, unchanged, count );
+    return unchanged && !changes;
+  }
+  }
+
+  return unchanged;
+}
+
+/** Remove the bounds checks from a[ i ] in a loop of the form
+    while ( i < len a ), where the body doesn't assign to a and only
+    ever adds one to i.  Since sequences never get shorter, i is less
+    than the length of a until it's changed in each pass through the
+    body.  The loop is guarded so the checks come back if i starts out
+    negative.
+    @param this while loop, already optimized.
+*/
+static void eliminateBoundsChecks( ConditionalStmt *this )
+{
+  SimpleExpr *cond = (SimpleExpr *) this->cond;
+  if ( this->cond->kind != LessKind || cond->expr1->kind != VariableKind ||
+       cond->expr2->kind != LenKind )
+    return;
+
+  Expr *seq = ( (SimpleExpr *) cond->expr2 )->expr1;
+  if ( seq->kind != VariableKind )
+    return;
+
+  int i = ( (VariableExpr *) cond->expr1 )->slot;
+  int a = ( (VariableExpr *) seq )->slot;
+  if ( i == a || assignsVariable( this->body, a ) ||
+       !onlyIncrements( this->body, i, false ) )
+    return;
+
+  int count = 0;
+  skipStmtChecks( this->body, i, a, true, &count );
+  if ( count > 0 )
+    guardLoop( (Stmt *) this );
+}
+
+/** Return true if the given statement is a compound with nothing in it.
+    @param stmt statement to check.
+    @return true if stmt is an empty compound.
+*/
+static bool isEmpty( Stmt *stmt )
+{
+  return stmt->kind == CompoundKind && ( (CompoundStmt *) stmt )->len == 0;
+}
+
+/** Optimize a compound statement, flattening any compounds nested
+    inside it and dropping empty statements.
+    @param this compound to optimize.
+    @return optimized statement.
+*/
+static Stmt *optimizeCompound( CompoundStmt *this )
+{
+  int len = 0;
+  int cap = INITIAL_CAPACITY;
+  Stmt **stmtList = (Stmt **) malloc( cap * sizeof( Stmt * ) );
+
+  for ( int i = 0; i < this->len; i++ ) {
+    Stmt *stmt = optimizeStmt( this->stmtList[ i ] );
+
+    // Children of a nested compound move up to this one.  Children of
+    // our children are already flat.
+    CompoundStmt *inner = (CompoundStmt *) stmt;
+    int count = stmt->kind == CompoundKind ? inner->len : 1;
+    Stmt **list = stmt->kind == CompoundKind ? inner->stmtList : &stmt;
+
+    for ( int j = 0; j < count; j++ ) {
+      if ( len >= cap ) {
+        cap *= DOUBLE_CAPACITY;
+        stmtList = (Stmt **) realloc( stmtList, cap * sizeof( Stmt * ) );
+      }
+      stmtList[ len++ ] = list[ j ];
+    }
+  }
+
+  // A compound with just one statement in it isn't needed.  Otherwise,
+  // make a new compound with the flat list of statements.
+  setSyntaxLine( this->line );
+  Stmt *result = len == 1 ? stmtList[ 0 ] : makeCompound( len, stmtList );
+  free( stmtList );
+  return result;
+}
+
+Stmt *optimizeStmt( Stmt *stmt )
+{
+  switch ( stmt->kind ) {
+  case PrintKind:
+  case PushKind: {
+    SimpleStmt *this = (SimpleStmt *) stmt;
+    this->expr1 = optimizeExpr( this->expr1 );
+    if ( this->expr2 )
+      this->expr2 = optimizeExpr( this->expr2 );
+    return stmt;
+  }
+
+  case AssignmentKind: {
+    AssignmentStmt *this = (AssignmentStmt *) stmt;
+    Expr *expr = optimizeExpr( this->expr );
+    Expr *iexpr = this->iexpr ? optimizeExpr( this->iexpr ) : NULL;
+
+    // Build a new assignment, so it's implemented the right way for
+    // the optimized expression.
+    setSyntaxLine( stmt->line );
+    return makeAssignment( this->slot, iexpr, expr );
+  }
+
+  case CompoundKind:
+    return optimizeCompound( (CompoundStmt *) stmt );
+
+  case IfKind:
+  case WhileKind: {
+    ConditionalStmt *this = (ConditionalStmt *) stmt;
+    this->cond = optimizeExpr( this->cond );
+    if ( stmt->kind == WhileKind )
+      loopDepth++;
+    this->body = optimizeStmt( this->body );
+    if ( stmt->kind == WhileKind )
+      loopDepth--;
+    setSyntaxLine( stmt->line );
+
+    int val;
+    if ( isLiteral( this->cond, &val ) ) {
+      if ( val == 0 ) {
+        // The body never runs.
+        return makeCompound( 0, NULL );
+      }
+
+      // An if with a true condition is just its body.
+      if ( stmt->kind == IfKind )
+        return this->body;
+    }
+
+    // An if with nothing in its body only needs its condition checked,
+    // and only if checking it could fail.
+    if ( stmt->kind == IfKind && isEmpty( this->body ) &&
+         isIntExpr( this->cond ) && cannotFail( this->cond ) )
+      return makeCompound( 0, NULL );
+
+    if ( stmt->kind == WhileKind ) {
+      eliminateBoundsChecks( this );
+      return hoistInvariants( this );
+    }
+    return stmt;
+  }
+  }
+
+  return stmt;
+}
@@ -0,0 +1,26 @@
+/**
+  @file optimize.h
+  @author Adrian Chan (amchan)
+
+  Optimization pass over the parsed statement tree.
+*/
+
+#ifndef _OPTIMIZE_H_
+#define _OPTIMIZE_H_
+
+#include "syntax.h"
+
+/** Optimize the given statement.  This folds constant subexpressions,
+    simplifies arithmetic identities when the result can't change,
+    removes if statements (and while loops) with constant conditions,
+    hoists ints that can't change out of while loop conditions and
+    flattens nested compound statements.  New nodes come from the
+    syntax arena, and parts of the tree that are no longer needed are
+    just dropped; they go away when the arena is reset.
+    @param stmt statement to optimize.
+    @return optimized statement, which may or may not be the same object
+    as stmt.
+*/
+Stmt *optimizeStmt( Stmt *stmt );
+
+#endif
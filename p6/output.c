@@ -0,0 +1,121 @@
+/**
+  @file output.c
+  @author Adrian Chan (amchan)
+  Buffered output for the print statement.
+*/
+
+// Needed for isatty() and fileno().
+#define _POSIX_C_SOURCE 200809L
+
+#include "output.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+/** Size of the output buffer, in bytes. */
+#define BUFFER_SIZE 65536
+
+/** Most characters it takes to write an int in decimal, with a sign. */
+#define MAX_INT_CHARS 11
+
+/** Output waiting to be written. */
+static char buffer[ BUFFER_SIZE ];
+
+/** Number of bytes in buffer. */
+static int used;
+
+/** True once we've set up the flush policy. */
+static bool ready;
+
+/** True if we should flush at the end of every line, because stdout
+    is a terminal someone is watching. */
+static bool lineBuffered;
+
+void flushOutput()
+{
+  if ( used > 0 ) {
+    fwrite( buffer, 1, used, stdout );
+    used = 0;
+  }
+  fflush( stdout );
+}
+
+/** Set up the flush policy the first time anything is written. */
+static void startOutput()
+{
+  // Error messages exit() without coming back to us, so make sure
+  // whatever was printed before them still gets written.
+  atexit( flushOutput );
+  lineBuffered = isatty( fileno( stdout ) );
+  ready = true;
+}
+
+void outputInt( int val )
+{
+  if ( !ready )
+    startOutput();
+  if ( used + MAX_INT_CHARS > BUFFER_SIZE )
+    flushOutput();
+
+  // Build the digits backward, using an unsigned magnitude so the
+  // most negative int works too.
+  char digits[ MAX_INT_CHARS ];
+  int n = 0;
+  unsigned int mag = val < 0 ? -(unsigned int) val : (unsigned int) val;
+  do {
+    digits[ n++ ] = '0' + mag % 10;
+    mag /= 10;
+  } while ( mag );
+  if ( val < 0 )
+    digits[ n++ ] = '-';
+
+  while ( n > 0 )
+    buffer[ used++ ] = digits[ --n ];
+}
+
+void outputChars( int const *vals, int len )
+{
+  if ( !ready )
+    startOutput();
+
+  bool newline = false;
+  while ( len > 0 ) {
+    if ( used == BUFFER_SIZE )
+      flushOutput();
+
+    // Copy as much as fits in the buffer.
+    int count = BUFFER_SIZE - used < len ? BUFFER_SIZE - used : len;
+    for ( int i = 0; i < count; i++ ) {
+      buffer[ used + i ] = (char) vals[ i ];
+      newline = newline || vals[ i ] == '\n';
+    }
+    used += count;
+    vals += count;
+    len -= count;
+  }
+
+  if ( lineBuffered && newline )
+    flushOutput();
+}
+
+void outputBytes( unsigned char const *bytes, int len )
+{
+  if ( !ready )
+    startOutput();
+
+  if ( used + len > BUFFER_SIZE )
+    flushOutput();
+
+  // Anything too big for the buffer goes out in one write of its own.
+  if ( len > BUFFER_SIZE )
+    fwrite( bytes, 1, len, stdout );
+  else {
+    memcpy( buffer + used, bytes, len );
+    used += len;
+  }
+
+  if ( lineBuffered && memchr( bytes, '\n', len ) )
+    flushOutput();
+}
@@ -0,0 +1,36 @@
+/**
+  @file output.h
+  @author Adrian Chan (amchan)
+
+  Buffered output for the print statement.  Output collects in one big
+  buffer and goes to stdout a block at a time, instead of making a libc
+  call for every int and character printed.
+*/
+
+#ifndef _OUTPUT_H_
+#define _OUTPUT_H_
+
+/** Write an int to the output, in decimal.
+    @param val value to write.
+*/
+void outputInt( int val );
+
+/** Write a list of character codes to the output, one byte each.
+    @param vals character codes to write.
+    @param len number of codes in vals.
+*/
+void outputChars( int const *vals, int len );
+
+/** Write a list of bytes to the output, as is.
+    @param bytes bytes to write.
+    @param len number of bytes.
+*/
+void outputBytes( unsigned char const *bytes, int len );
+
+/** Send everything in the output buffer to stdout.  This happens
+    automatically when the buffer fills up and when the program exits.
+    If stdout is a terminal, it also happens at the end of every line.
+*/
+void flushOutput();
+
+#endif
@@ -1,20 +1,15 @@
 /**
   @file parse.c
   @author Adrian Chan (amchan)
-  Parser and tokenizer functions.
+  Parser, turning tokens into syntax trees.
 */
 
 #include "parse.h"
 #include <stdlib.h>
+#include <setjmp.h>
 #include <string.h>
 #include <ctype.h>
 
-// Prototype so we can use this function before defining it.
-static Expr *parseExpr( char *tok, FILE *fp );
-
-// Number of characters inside a single-quoted string.
-#define SINGLE_QUOTE_LENGTH 1
-
 // Initial capacity for the resizable array used to store
 // statements in a compound statement.
 #define INITIAL_CAPACITY 5
@@ -22,316 +17,261 @@ static Expr *parseExpr( char *tok, FILE *fp );
 /** Double the capacity of an array */
 #define DOUBLE_CAPACITY 2
 
-//////////////////////////////////////////////////////////////////////
-// Input tokenization
+// Hidden implementation of the parser.
+struct ParserStruct {
+  /** Source we're parsing, with its list of tokens. */
+  Source *src;
 
-// Current line we're parsing, starting from 1 like most editors.
-static int lineCount = 1;
+  /** Index of the next token to read. */
+  int next;
 
-/** Print a syntax error message, with a line number and exit. */
-static void syntaxError()
-{
-  fprintf( stderr, "line %d: syntax error\n", lineCount );
-  exit( EXIT_FAILURE );
-}
+  /** Most recently read token. */
+  Token const *tok;
 
-/** Helper function for parseToken.  It checks for overflow and stores
-    the given character in the next element of token.
-    @param ch The character to add. 
-    @param token The token we're building.
-    @param len Next position in token, passed by address. */
-static void addToToken( char ch, char *token, int *len )
-{
-  // Complain if the token is too long.
-  if ( *len >= MAX_TOKEN ) {
-    fprintf( stderr, "line %d: token too long\n", lineCount );
-    exit( EXIT_FAILURE );
-  }
+  /** Arena the syntax trees for statements are allocated from. */
+  Arena *arena;
 
-  // Add the given character.
-  token[ *len ] = ch;
-  *len += 1;
-}
+  /** True if errors should jump back to parseProgram() rather than
+      exiting. */
+  bool recovering;
 
-/** Documented in the header. */
-bool parseToken( char *token, FILE *fp )
-{
-  int ch;
+  /** Where to jump back to on an error, while recovering. */
+  jmp_buf recover;
 
-  // Skip whitespace and comments.
-  while ( isspace( ch = fgetc( fp ) ) || ch == '#' ) {
-    // If we hit the comment characer, skip the whole line.
-    if ( ch == '#' )
-      while ( ( ch = fgetc( fp ) ) != EOF && ch != '\n' )
-        ;
+  /** Buffer for the message describing an error, while recovering. */
+  char *error;
+};
 
-    if ( ch == '\n' )
-      lineCount++;
-  }
-    
-  if ( ch == EOF )
-    return false;
+// Prototype so we can use this function before defining it.
+static Expr *parseExpr( Parser *p );
 
-  // Record the character we've read and keep up with the token length.
-  int len = 0;
-  token[ len++ ] = ch;
-  
-  if ( isalpha( ch ) || ch == '_' ) {
-    // Try to parse the token as an identifier.
-    while ( isalnum( ( ch = fgetc( fp ) ) ) || ch == '_' )
-      addToToken( ch, token, &len );
-
-    // We had to read one character too far to find the end of the token.
-    // put the extra character back.
-    if ( ch != EOF )
-      ungetc( ch, fp );
-  } else if ( ch == '-' || isdigit( ch ) ) {
-    // Try to parse the token as an integer value, it's a sequence of digits
-    // after the initial sign or digit.
-    while ( isdigit( ( ch = fgetc( fp ) ) ) )
-      addToToken( ch, token, &len );
-    
-    // We had to read one character too far to find the end.
-    // Put the extra character back.
-    if ( ch != EOF )
-      ungetc( ch, fp );
-  } else if ( ch == '"' || ch == '\'' ) {
-    // Look for the same quote to end the string later.
-    char quote = ch;
-    
-    // Try to parse the token as a single- or dobule-quoted string.
-    // Is the next character escaped.
-    bool escape = false;
-
-    // Keep reading until we hit the matching close quote.
-    while ( ( ch = fgetc( fp ) ) != quote || escape ) {
-      // Error conditions
-      if ( ch == EOF || ch == '\n' ) {
-        fprintf( stderr, "line %d: invalid string literal.\n", lineCount );
-        exit( EXIT_FAILURE );
-      }
-      
-      // On a backslash, we just enable escape mode.
-      if ( !escape && ch == '\\' ) {
-        escape = true;
-      } else {
-        // Interpret escape sequences if we're in escape mode.
-        if ( escape ) {
-          switch ( ch ) {
-          case 'n':
-            ch = '\n';
-            break;
-          case 't':
-            ch = '\t';
-            break;
-          case '"':
-            ch = '"';
-            break;
-          case '\\':
-            ch = '\\';
-            break;
-          default:
-            fprintf( stderr, "line %d: Invalid escape sequence \"\\%c\"\n",
-                     lineCount, ch );
-            exit( EXIT_FAILURE );
-          }
-          escape = false;
-        }
-
-        addToToken( ch, token, &len );
-      }
-    }    
-    // Store the closing quote.
-    addToToken( quote, token, &len );
-
-    // Single-quoted strings must be exactly one character long.
-    if ( quote == '\'' && len != SINGLE_QUOTE_LENGTH  + 1 + 1 ) {
-      fprintf( stderr, "line %d: Invalid single-quoted string\n", lineCount );
-      exit( EXIT_FAILURE );
-    }
-  }  else {
-    // Is this a multi-character token?
-    int ch2 = fgetc( fp );
-    if ( ( ch == '=' && ch2 == '=' ) ||
-         ( ch == '&' && ch2 == '&' ) ||
-         ( ch == '|' && ch2 == '|' ) ) {
-      token[ len++ ] = ch2;
-    } else {
-      // Put back the second token and just take a one-character token.
-      if ( ch2 != EOF )
-        ungetc( ch2, fp );
-    }
+/** Print a syntax error message, with the line number of the last token
+    we read, and exit.  If we're parsing a whole program, just save the
+    message and jump back to parseProgram().
+    @param p parser that found the error.
+*/
+static void syntaxError( Parser *p )
+{
+  if ( p->recovering ) {
+    sprintf( p->error, "line %d: syntax error\n", p->tok->line );
+    longjmp( p->recover, 1 );
   }
-    
-  token[ len++ ] = '\0';
-  return token;
+
+  fprintf( stderr, "line %d: syntax error\n", p->tok->line );
+  exit( EXIT_FAILURE );
+}
+
+/** Make room for another element at the end of a list that's being
+    built in the parser's arena.  Lists are only needed until the node
+    using them is made, so the old copy is just left for the next reset.
+    This way, nothing leaks if an error jumps out of the middle of the
+    list.
+    @param p parser whose arena the list is in.
+    @param list list to grow.
+    @param len number of elements in the list.
+    @param cap pointer to the capacity of the list, updated if it grows.
+    @return the list, moved if it needed more room.
+*/
+static void **growList( Parser *p, void **list, int len, int *cap )
+{
+  if ( list != NULL && len < *cap )
+    return list;
+
+  if ( list != NULL )
+    *cap *= DOUBLE_CAPACITY;
+  void **bigger = (void **) arenaAlloc( p->arena, *cap * sizeof( void * ) );
+  if ( len > 0 )
+    memcpy( bigger, list, len * sizeof( void * ) );
+  return bigger;
 }
 
 /** Called when we expect another token on the input.  This function
-    parses the token and exits with an error if there isn't one.
-    @param storage for the next token, with capacity for at least
-    MAX_TOKEN characters.  This buffer will be modified by the parse
-    function as it reads additional tokens.
-    @param fp file tokens should be read from.
-    @return a copy of the pointer to the tok buffer, so this function
-    can be used as a parameter to other parsing calls.
+    reads the next token and exits with an error if there isn't one.
+    @param p parser to read from.
+    @return the token that was read, so this function can be used as a
+    parameter to other parsing calls.
 */
-static char *expectToken( char *tok, FILE *fp )
+static Token const *expectToken( Parser *p )
 {
-  if ( !parseToken( tok, fp ) )
-    syntaxError();
-  return tok;
+  p->tok = &p->src->tokens[ p->next ];
+  if ( p->tok->sym == ErrorSym ) {
+    if ( p->recovering ) {
+      lexErrorMessage( p->src, p->tok, p->error );
+      longjmp( p->recover, 1 );
+    }
+    reportLexError( p->src, p->tok );
+  }
+  if ( p->tok->sym == EndSym )
+    syntaxError( p );
+
+  // New nodes are on the line of the last token read for them.
+  setSyntaxLine( p->tok->line );
+
+  p->next++;
+  return p->tok;
 }
 
-/** Called when the next token, must be a particular value,
+/** Called when the next token, must be a particular symbol,
     target.  Prints an error message and exits if it's not.
-    @param target string that the next token should match.
-    @param fp file tokens should be read from.
+    @param p parser to read from.
+    @param target symbol that the next token should match.
 */
-static void requireToken( char const *target, FILE *fp )
+static void requireToken( Parser *p, int target )
 {
-  char tok[ MAX_TOKEN + 1 ];
-  if ( strcmp( expectToken( tok, fp ), target ) != 0 )
-    syntaxError();
+  if ( expectToken( p )->sym != target )
+    syntaxError( p );
 }
 
-/** Return true if the given string is a legal identifier name.
+/** Return true if the given token is a legal identifier name.
     @param tok token parsed from the input.
     @return true if the given token is a legal identifier name.
 */
-static bool isIdentifier( char const *tok )
+static bool isIdentifier( Token const *tok )
 {
-  // Make sure the first character is legal.
-  if ( !isalpha( tok[ 0 ] ) && tok[ 0 ] != '_' )
+  // Reserved words and operators all have symbols before FirstUserSym.
+  if ( tok->sym < FirstUserSym )
     return false;
 
-  // Then, check the rest.
-  for ( int i = 1; tok[ i ]; i++ )
-    if ( !isalnum( tok[ i ] ) && tok[ i ] != '_' )
-      return false;
-
-  // Make sure it's not too long
-  if ( strlen( tok ) > MAX_VAR_NAME )
+  // Make sure the first character is legal.  If it is, the lexer made
+  // sure the rest are.
+  char const *name = symbolName( tok->sym );
+  if ( !isalpha( name[ 0 ] ) && name[ 0 ] != '_' )
     return false;
 
-  // And, make sure it doesn't match a reserved word.
-  if ( strcmp( tok, "if" ) == 0 ||
-       strcmp( tok, "while" ) == 0 ||
-       strcmp( tok, "print" ) == 0 ||
-       strcmp( tok, "push" ) == 0 ||
-       strcmp( tok, "len" ) == 0 )
+  // Make sure it's not too long
+  if ( symbolLength( tok->sym ) > MAX_VAR_NAME )
     return false;
 
   return true;
 }
 
-/** Return true if the given string is an operator that can come between
+/** Return true if the given symbol is an operator that can come between
     two operands (e.g., typical infix operator or '[')
-    @param tok token parsed from the input.
-    @return true if the given token matches one of the infix operator.
+    @param sym symbol for a token parsed from the input.
+    @return true if the given symbol is one of the infix operators.
 */
-static bool isInfixOperator( char const *tok )
+static bool isInfixOperator( int sym )
 {
-  return strcmp( tok, "+" ) == 0 ||
-    strcmp( tok, "-" ) == 0 ||
-    strcmp( tok, "*" ) == 0 ||
-    strcmp( tok, "/" ) == 0 ||
-    strcmp( tok, "<" ) == 0 ||
-    strcmp( tok, "==" ) == 0 ||
-    strcmp( tok, "&&" ) == 0 ||
-    strcmp( tok, "||" ) == 0 ||
-    strcmp( tok, "[" ) == 0;
+  return ( sym >= PlusSym && sym <= OrSym ) || sym == LeftBracketSym;
 }
 
 
 /** Helper function to parse comma expressions recursively
-    @param tok token parsed from input
-    @param fp file tokens should be read from
+    @param p parser, with the next token of the list already read.
     @param elist array to add expressions to
     @param len length of elist
     @param cap capacity of the elist
     @return the elist array filed with expressions
 */
-static Expr **commaHelper(char *tok, FILE *fp, Expr **elist, int *len, int cap) 
+static Expr **commaHelper(Parser *p, Expr **elist, int *len, int cap) 
 {
-  if (strcmp(tok, "]") == 0) {
+  if (p->tok->sym == RightBracketSym) {
     return elist;
   }
   
-  if (*len == cap) {
-    cap *= DOUBLE_CAPACITY;
-    elist = realloc(elist, cap * sizeof(Expr *));
-  }
-  if (strcmp(tok, ",") == 0) {
-    return commaHelper(expectToken(tok, fp), fp, elist, len, cap);
+  elist = (Expr **) growList( p, (void **) elist, *len, &cap );
+  if (p->tok->sym == CommaSym) {
+    expectToken(p);
+    return commaHelper(p, elist, len, cap);
   }
   
-  elist[*len] = parseExpr(tok, fp);
+  elist[*len] = parseExpr(p);
   *len += 1;
-  return commaHelper(expectToken(tok, fp), fp, elist, len, cap);
+  expectToken(p);
+  return commaHelper(p, elist, len, cap);
   
 }
+/** Parse the parenthesized arguments of a call to a built-in function.
+    @param p parser, with the function's name already read.
+    @param fn function being called.
+    @return the call expression constructed from the input.
+*/
+static Expr *parseCall( Parser *p, Builtin fn )
+{
+  Expr *args[ MAX_BUILTIN_ARGS ];
+  int len = builtinArgCount( fn );
+
+  requireToken( p, LeftParenSym );
+  for ( int i = 0; i < len; i++ ) {
+    if ( i > 0 )
+      requireToken( p, CommaSym );
+    expectToken( p );
+    args[ i ] = parseExpr( p );
+  }
+  requireToken( p, RightParenSym );
+
+  return makeCall( fn, len, args );
+}
+
 /** Parse a building block for a larger expression, either a literal, a
-    variable, or an expression inside parentheses.
-    @param tok next token from the input.
-    @param fp file subsequent tokens are being read from.
+    variable, a call to a built-in function, or an expression inside
+    parentheses.
+    @param p parser, with the first token of the term already read.
     @return the expression object constructed from the input.
 */
-static Expr *parseTerm( char tok[ MAX_TOKEN + 1 ], FILE *fp )
+static Expr *parseTerm( Parser *p )
 {
-  if ( strcmp( tok, "(" ) == 0 ) {
-    Expr *expr = parseExpr( expectToken( tok, fp ), fp );
-    requireToken( ")", fp );
+  Token const *tok = p->tok;
+  switch ( tok->sym ) {
+  case LeftParenSym: {
+    expectToken( p );
+    Expr *expr = parseExpr( p );
+    requireToken( p, RightParenSym );
     return expr;
   }
   
-  if (tok[0] == '"') {
-    int cap = INITIAL_CAPACITY;
-    Expr **elist = malloc(cap * sizeof(Expr *));
-    int len = 0;
-    
-    while (tok[len + 1] != '"') {
-      if (len == cap) {
-        cap *= DOUBLE_CAPACITY;
-        elist = realloc(elist, cap * sizeof(Expr *));
-      }
-      elist[len] = makeLiteralInt(tok[len + 1]);
-      len++;
-    }
-    
-    return makeSeqInit(len, elist);
-    
+  case StringSym: {
+    // Build the string's characters once, as a constant sequence.
+    int vals[ MAX_TOKEN + 1 ];
+    int len = literalValues( p->src, tok, vals );
+    return makeSeqLiteral( len, vals );
   }
   
-  if (strcmp(tok, "[") == 0) {
+  case LeftBracketSym: {
     int cap = INITIAL_CAPACITY;
     int len = 0;
-    Expr **elist = malloc(cap * sizeof(Expr *));
+    Expr **elist = (Expr **) growList( p, NULL, len, &cap );
     
-    elist = commaHelper(expectToken(tok, fp), fp, elist, &len, cap);
-    //ungetc(tok[0], fp);
-    //requireToken("]", fp);
+    expectToken(p);
+    elist = commaHelper(p, elist, &len, cap);
     return makeSeqInit(len, elist);
   }
   
-  if (strcmp(tok, "len") == 0) {
-    return makeLen(parseExpr(expectToken(tok, fp), fp));
-  }
+  case LenSym:
+    expectToken(p);
+    return makeLen(parseExpr(p));
+
+  case NumberSym: {
+    // It's an int value, parse it and returna LiteraInt object.  The
+    // text isn't null terminated in the source, so copy it out first.
+    char text[ MAX_TOKEN + 1 ];
+    memcpy( text, p->src->text + tok->start, tok->len );
+    text[ tok->len ] = '\0';
 
-  if ( tok[ 0 ] == '-' || isdigit( tok[ 0 ] ) ) {
-    // It's an int value, parse it and returna LiteraInt object.
     int val, n;
-    if ( sscanf( tok, "%d%n", &val, &n ) != 1 ||
-         n != strlen( tok ) )
-      syntaxError();
+    if ( sscanf( text, "%d%n", &val, &n ) != 1 || n != tok->len )
+      syntaxError( p );
     return makeLiteralInt( val );
-  } else if ( tok[ 0 ] == '\'' ) {
+  }
+
+  case CharSym: {
     // A literal (single-quoted) character is just another int.
-    return makeLiteralInt( tok[ 1 ] );
-  } else if ( isIdentifier( tok ) ) {
-    return makeVariable( tok );
-  } else
-    syntaxError();
+    int val;
+    literalValues( p->src, tok, &val );
+    return makeLiteralInt( val );
+  }
+  }
+
+  if ( isIdentifier( tok ) ) {
+    // A built-in function's name is only a call if it's followed by a
+    // parenthesis, so the names can still be used for variables.
+    int fn = findBuiltin( symbolName( tok->sym ) );
+    if ( fn >= 0 && p->src->tokens[ p->next ].sym == LeftParenSym )
+      return parseCall( p, fn );
+    return makeVariable( variableSlot( tok->sym ) );
+  }
+
+  syntaxError( p );
 
   // Not reached.
   return NULL;
@@ -339,139 +279,238 @@ static Expr *parseTerm( char tok[ MAX_TOKEN + 1 ], FILE *fp )
 
 /** Parse with one token worth of look-ahead, return the Expr
     object representing the next legal expression from the input.
-    @param tok next token from the input, already read before
-    calling this function.
-    @param fp file subsequent tokens are being read from.
+    @param p parser, with the first token of the expression already
+    read.
     @return the Expr object constructed from the input.
 */
-static Expr *parseExpr( char *tok, FILE *fp )
+static Expr *parseExpr( Parser *p )
 {
   // Parse the expression, or just the left-hand operatnd of a longer
   // expression.
   
-  Expr *left = parseTerm( tok, fp );
+  Expr *left = parseTerm( p );
   
   // See if there's another oprator after this one.
-  char op[ MAX_TOKEN + 1 ];
-  while ( isInfixOperator( expectToken( op, fp ) ) ) {
+  int op;
+  while ( isInfixOperator( op = expectToken( p )->sym ) ) {
     // Parse the right-hand operand.
-    Expr *right = parseTerm( expectToken( tok, fp ), fp );
+    expectToken( p );
+    Expr *right = parseTerm( p );
 
     // Create the right type of expression, based on what binary
     // operator it is.
-    if ( strcmp( op, "+" ) == 0 ) {
+    switch ( op ) {
+    case PlusSym:
       left = makeAdd( left, right );
-    } else if ( strcmp( op, "-" ) == 0 ) {
+      break;
+    case MinusSym:
       left = makeSub( left, right );
-    } else if ( strcmp( op, "*" ) == 0 ) {
+      break;
+    case TimesSym:
       left = makeMul( left, right );
-    } else if ( strcmp( op, "/" ) == 0 ) {
+      break;
+    case DivideSym:
       left = makeDiv( left, right );
-    } else if ( strcmp( op, "&&" ) == 0 ) {
+      break;
+    case AndSym:
       left = makeAnd( left, right );
-    } else if ( strcmp( op, "||" ) == 0 ) {
+      break;
+    case OrSym:
       left = makeOr( left, right );
-    } else if ( strcmp( op, "<" ) == 0 ) {
+      break;
+    case LessSym:
       left = makeLess( left, right );
-    } else if ( strcmp( op, "==" ) == 0 ) {
+      break;
+    case EqualsSym:
       left = makeEquals( left, right );
-    } else if (strcmp(op, "[") == 0) {
-      left = makeSequenceIndex(left, right);
-      requireToken("]", fp);
+      break;
+    case LeftBracketSym:
+      left = makeSequenceIndex( left, right );
+      requireToken( p, RightBracketSym );
+      break;
     }
   }
 
   // To end an expression, the next token must be ;, ), ] or a comma.
-  if ( strcmp( op, ";" ) != 0 && strcmp( op, ")" ) != 0 &&
-       strcmp( op, "]" ) != 0 && strcmp( op, "," ) != 0 )
-    syntaxError();
+  if ( op != SemicolonSym && op != RightParenSym &&
+       op != RightBracketSym && op != CommaSym )
+    syntaxError( p );
 
-  // Code that called us is going to expect to see this token.
-  ungetc( op[ 0 ], fp );
+  // Code that called us is going to expect to see this token, so
+  // back up to read it again.
+  p->next--;
   return left;
 }
 
-Stmt *parseStmt( char *tok, FILE *fp )
+Parser *makeParser( Source *src )
 {
-  // Handle compound statements
-  if ( strcmp( tok, "{" ) == 0 ) {
+  Parser *p = (Parser *) malloc( sizeof( Parser ) );
+  p->src = src;
+  p->next = 0;
+  p->tok = NULL;
+  p->arena = makeArena();
+  p->recovering = false;
+  p->error = NULL;
+  return p;
+}
+
+bool hasStatement( Parser *p )
+{
+  // Running out of input is fine here, between statements.
+  if ( p->src->tokens[ p->next ].sym == EndSym )
+    return false;
+
+  expectToken( p );
+  return true;
+}
+
+/** Parse a statement, for parseStmt().
+    @param p parser to read from, with the first token of the statement
+    already read.
+    @return the Stmt object constructed from the input.
+*/
+static Stmt *parseStatement( Parser *p )
+{
+  Token const *tok = p->tok;
+  switch ( tok->sym ) {
+  case LeftBraceSym: {
+    // Handle compound statements
     int len = 0;
     int cap = INITIAL_CAPACITY;
-    Stmt **stmtList = (Stmt **) malloc( cap * sizeof( Stmt * ) );
+    Stmt **stmtList = NULL;
 
     // Keep parsing statements until we hit the closing curly bracket.
-    while ( strcmp( expectToken( tok, fp ), "}" ) != 0 ) {
-      if ( len >= cap ) {
-        cap *= DOUBLE_CAPACITY;
-        stmtList = (Stmt **) realloc( stmtList, cap * sizeof( Stmt * ) );
-      }
-      stmtList[ len++ ] = parseStmt( tok, fp );
+    while ( expectToken( p )->sym != RightBraceSym ) {
+      stmtList = (Stmt **) growList( p, (void **) stmtList, len, &cap );
+      stmtList[ len++ ] = parseStmt( p );
     }
 
     return makeCompound( len, stmtList );
   }
 
-  // Handle a print statement.
-  if ( strcmp( tok, "print" ) == 0 ) {
+  case PrintSym: {
     // Parse the one argument to print, and create a print expression.
-    Expr *arg = parseExpr( expectToken( tok, fp ), fp );
-    requireToken( ";", fp );
+    expectToken( p );
+    Expr *arg = parseExpr( p );
+    requireToken( p, SemicolonSym );
     return makePrint( arg );
   }
 
-  // Handle an if statement.
-  if ( strcmp( tok, "if" ) == 0 ) {
-    requireToken( "(", fp );
-    Expr *cond = parseExpr( expectToken( tok, fp ), fp );
-    requireToken( ")", fp );
-    Stmt *body = parseStmt( expectToken( tok, fp ), fp );
+  case IfSym: {
+    // Handle an if statement.
+    requireToken( p, LeftParenSym );
+    expectToken( p );
+    Expr *cond = parseExpr( p );
+    requireToken( p, RightParenSym );
+    expectToken( p );
+    Stmt *body = parseStmt( p );
     return makeIf( cond, body );
   }
 
-  // Handle a while statement..
-  if ( strcmp( tok, "while" ) == 0 ) {
-    requireToken( "(", fp );
-    Expr *cond = parseExpr( expectToken( tok, fp ), fp );
-    requireToken( ")", fp );
-    Stmt *body = parseStmt( expectToken( tok, fp ), fp );
+  case WhileSym: {
+    // Handle a while statement..
+    requireToken( p, LeftParenSym );
+    expectToken( p );
+    Expr *cond = parseExpr( p );
+    requireToken( p, RightParenSym );
+    expectToken( p );
+    Stmt *body = parseStmt( p );
     return makeWhile( cond, body );
   }
   
-  if (strcmp(tok, "push") == 0) {
-    Expr *seq = parseExpr(expectToken(tok, fp), fp);
-    requireToken(",", fp);
-    Expr *v = parseExpr(expectToken(tok, fp), fp);
-    requireToken(";", fp);
+  case PushSym: {
+    expectToken(p);
+    Expr *seq = parseExpr(p);
+    requireToken(p, CommaSym);
+    expectToken(p);
+    Expr *v = parseExpr(p);
+    requireToken(p, SemicolonSym);
     return makePush(seq, v);
   }
+  }
 
   // Handle an assignment statement.
   if ( isIdentifier( tok ) ) {
-    // This must be an assignment.  Copy the variable name then parse
-    // the expression being assigned to it.
-    char vname[ MAX_VAR_NAME + 1 ];
-    strcpy( vname, tok );
+    // This must be an assignment.  Resolve the variable's slot then
+    // parse the expression being assigned to it.
+    int slot = variableSlot( tok->sym );
     
-    expectToken( tok, fp );
-    if ( strcmp( tok, "=" ) == 0 ) {
+    tok = expectToken( p );
+    if ( tok->sym == AssignSym ) {
       // It's a plain-old assignment. 
-      Expr *expr = parseExpr( expectToken( tok, fp ), fp );
-      requireToken( ";", fp );
+      expectToken( p );
+      Expr *expr = parseExpr( p );
+      requireToken( p, SemicolonSym );
       // Make the assignment statement.
-      return makeAssignment( vname, NULL, expr );
-    } else if (strcmp(tok, "[") == 0) {
-      Expr *iexpr = parseExpr(expectToken(tok, fp), fp);
-      requireToken("]", fp);
-      requireToken("=", fp);
-      Expr *expr = parseExpr(expectToken(tok, fp), fp);
-      requireToken( ";", fp );
-      return makeAssignment(vname, iexpr, expr);
+      return makeAssignment( slot, NULL, expr );
+    } else if (tok->sym == LeftBracketSym) {
+      expectToken(p);
+      Expr *iexpr = parseExpr(p);
+      requireToken(p, RightBracketSym);
+      requireToken(p, AssignSym);
+      expectToken(p);
+      Expr *expr = parseExpr(p);
+      requireToken( p, SemicolonSym );
+      return makeAssignment(slot, iexpr, expr);
     }
   }
 
   // Otherwise, it's a syntax error.
-  syntaxError();
+  syntaxError( p );
 
   // Never reached.
   return NULL;
 }
+
+Stmt **parseProgram( Parser *p, int *len, char *error )
+{
+  // These are changed after setjmp(), so they have to be volatile to
+  // still be good if we jump back.
+  Stmt ** volatile list = NULL;
+  volatile int count = 0;
+  int cap = INITIAL_CAPACITY;
+
+  error[ 0 ] = '\0';
+  p->error = error;
+  p->recovering = true;
+  if ( setjmp( p->recover ) == 0 ) {
+    while ( hasStatement( p ) ) {
+      list = (Stmt **) growList( p, (void **) list, count, &cap );
+      list[ count ] = parseStmt( p );
+      count++;
+    }
+  }
+  p->recovering = false;
+
+  *len = count;
+  return list;
+}
+
+Stmt *parseStmt( Parser *p )
+{
+  // New nodes come from our arena.
+  setSyntaxArena( p->arena );
+
+  // Statements are made after all their parts, so they'd get the line
+  // of their last token.  Report the line they start on instead.
+  int line = p->tok->line;
+  Stmt *stmt = parseStatement( p );
+  stmt->line = line;
+  return stmt;
+}
+
+void resetParser( Parser *p )
+{
+  resetArena( p->arena );
+}
+
+void freeParser( Parser *p )
+{
+  freeArena( p->arena );
+  free( p );
+}
+
+Arena const *parserArena( Parser const *p )
+{
+  return p->arena;
+}
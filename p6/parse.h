@@ -2,7 +2,7 @@
   @file parse.h
   @author Adrian Chan (amchan)
 
-  Parser and tokenizer functions.
+  Parser, turning tokens into syntax trees.
 */
 
 #ifndef _PARSE_H_
@@ -13,28 +13,66 @@
 
 #include "value.h"
 #include "syntax.h"
+#include "symbol.h"
+#include "lex.h"
 
-//////////////////////////////////////////////////////////////////////
-// Input totkenization
+/** A short name to use for the Parser type.  Its definition is an
+    implementation detail, not visible to client code. */
+typedef struct ParserStruct Parser;
 
-/** Maximum length of a token in the source file. */
-#define MAX_TOKEN 1023
+/** Make a parser for the tokens of the given source.
+    @param src source to parse, already broken into tokens by
+    lexSource().  The caller still owns it and must keep it until the
+    parser is freed.
+    @return new, dynamically allocated parser.
+*/
+Parser *makeParser( Source *src );
 
-/** Read the next token from the given file, skipping whitespace or comments.
-    @param tok storage for the token, with room for a string of up to
-     MAX_TOKEN characters.
-    @param fp file to read tokens from.
-    @return true if the token is successfully read.
+/** Read the first token of the next statement, if there is one.
+    @param parser parser to read from.
+    @return true if there's another statement to parse.
 */
-bool parseToken( char token[], FILE *fp );
+bool hasStatement( Parser *parser );
 
 /** Parse with one token worth of look-ahead, return the Stmt
     object representing the next legal statement from the input.
-    @param tok next token from the input, already read before
-    calling this function.
-    @param fp file subsequent tokens are being read from.
+    @param parser parser to read from, with the first token of the
+    statement already read by hasStatement().
     @return the Stmt object constructed from the input.
 */
-Stmt *parseStmt( char *tok, FILE *fp );
+Stmt *parseStmt( Parser *parser );
+
+/** Parse all the remaining statements in the input at once.  If there's
+    an error, this stops and returns the statements before it, along
+    with the message that would have been printed for the error, so the
+    caller can run those statements first.
+    @param parser parser to read from.
+    @param len pointer to the number of statements returned.
+    @param error buffer with room for MAX_ERROR_MESSAGE characters, set
+    to the error message or to an empty string if there wasn't one.
+    @return list of the statements, allocated in the parser's arena along
+    with their syntax trees.
+*/
+Stmt **parseProgram( Parser *parser, int *len, char *error );
+
+/** Free the syntax trees for all the statements parsed so far, all at
+    once.  Their nodes are allocated from an arena owned by the parser,
+    so they don't need to be freed one at a time.
+    @param parser parser that built the statements.
+*/
+void resetParser( Parser *parser );
+
+/** Free all the memory used by the parser, including the syntax trees
+    it built.
+    @param parser parser to free.
+*/
+void freeParser( Parser *parser );
+
+/** Return the arena the parser allocates syntax trees from, so its
+    usage can be reported.
+    @param parser parser to report on.
+    @return the parser's arena.
+*/
+Arena const *parserArena( Parser const *parser );
 
 #endif
@@ -0,0 +1,362 @@
+/**
+  @file profile.c
+  @author Adrian Chan (amchan)
+  Statement profiler for the tree-walking interpreter.
+*/
+
+// Needed for clock_gettime().
+#define _POSIX_C_SOURCE 200809L
+
+#include "profile.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+/** Initial capacity for the resizable arrays */
+#define INITIAL_CAPACITY 64
+
+/** Double the capacity of an array */
+#define DOUBLE_CAPACITY 2
+
+/** Nanoseconds in a second. */
+#define NSEC_PER_SEC 1000000000LL
+
+/** Nanoseconds in a millisecond, for the report. */
+#define NSEC_PER_MSEC 1e6
+
+/** Number of statements to list in the report.  The folded stacks
+    have all of them. */
+#define REPORT_LINES 20
+
+/** Percent, for the report. */
+#define PERCENT 100.0
+
+/** Multiplier for hashing statement addresses (Fibonacci hashing). */
+#define HASH_MULTIPLIER 11400714819323198485ULL
+
+/** Names for each kind of statement, indexed by StmtKind. */
+static char const *kindNames[] = { "print", "compound", "if", "while",
+                                   "push", "assign" };
+
+/** Everything we know about one statement in the program. */
+typedef struct {
+  /** Source line the statement starts on. */
+  int line;
+
+  /** What kind of statement it is. */
+  StmtKind kind;
+
+  /** Index of the site for the statement this one is nested in, or -1
+      for a top-level statement. */
+  int parent;
+
+  /** Number of times the statement was executed. */
+  long count;
+
+  /** Time spent in the statement, in nanoseconds, including the
+      statements nested in it. */
+  long long total;
+
+  /** Time spent in the statement itself, not counting the statements
+      nested in it. */
+  long long self;
+} Site;
+
+/** Entry in the table from statements to their sites. */
+typedef struct {
+  /** Statement we replaced the execute function for, or null if this
+      entry is empty. */
+  Stmt *stmt;
+
+  /** The statement's original execute function. */
+  void (*execute)( Stmt *stmt, Environment *env );
+
+  /** Index of the statement's site. */
+  int site;
+} Installed;
+
+/** A statement that's running right now. */
+typedef struct {
+  /** Index of the statement's site. */
+  int site;
+
+  /** Time the statement started. */
+  long long start;
+
+  /** Time spent so far in the statements nested inside it. */
+  long long child;
+} Frame;
+
+/** Name of the file to write folded stacks to. */
+static char *foldedName;
+
+/** List of all the statement sites. */
+static Site *sites;
+
+/** Number of sites. */
+static int siteCount;
+
+/** Capacity of the sites list. */
+static int siteCap;
+
+/** Hash table from statements to their original execute functions and
+    sites.  Nodes are reused when the syntax arena is reset, so a
+    statement installed at the same address as an old one just replaces
+    its entry. */
+static Installed *table;
+
+/** Number of entries used in the table. */
+static int tableCount;
+
+/** Capacity of the table, a power of two. */
+static int tableCap;
+
+/** Stack of statements that are running. */
+static Frame *frames;
+
+/** Number of statements running. */
+static int frameCount;
+
+/** Capacity of the frames stack. */
+static int frameCap;
+
+/** Read the clock.
+    @return current time, in nanoseconds.
+*/
+static long long now()
+{
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/** Find the table entry for a statement.
+    @param stmt statement to look for.
+    @return the statement's entry, or the empty entry where it belongs.
+*/
+static Installed *findStmt( Stmt *stmt )
+{
+  uint64_t hash = (uint64_t) (uintptr_t) stmt * HASH_MULTIPLIER;
+  int i = hash >> 32 & ( tableCap - 1 );
+  while ( table[ i ].stmt != NULL && table[ i ].stmt != stmt )
+    i = ( i + 1 ) & ( tableCap - 1 );
+  return &table[ i ];
+}
+
+/** Add a statement to the table, replacing any old entry for the same
+    address.
+    @param stmt statement being installed.
+    @param site index of the statement's site.
+*/
+static void addStmt( Stmt *stmt, int site )
+{
+  // Keep the table at most half full.
+  if ( ( tableCount + 1 ) * 2 > tableCap ) {
+    Installed *old = table;
+    int oldCap = tableCap;
+    tableCap = tableCap ? tableCap * DOUBLE_CAPACITY : INITIAL_CAPACITY;
+    table = (Installed *) calloc( tableCap, sizeof( Installed ) );
+    for ( int i = 0; i < oldCap; i++ )
+      if ( old[ i ].stmt )
+        *findStmt( old[ i ].stmt ) = old[ i ];
+    free( old );
+  }
+
+  Installed *entry = findStmt( stmt );
+  if ( entry->stmt == NULL )
+    tableCount++;
+  *entry = (Installed){ stmt, stmt->execute, site };
+}
+
+/** Execute function installed on every profiled statement.  It runs
+    the original execute function, keeping up with how long it takes.
+    @param stmt statement to execute.
+    @param env current values of all variables.
+*/
+static void executeProfiled( Stmt *stmt, Environment *env )
+{
+  // Copy what we need, in case the table changes while we run.
+  Installed entry = *findStmt( stmt );
+
+  if ( frameCount >= frameCap ) {
+    frameCap = frameCap ? frameCap * DOUBLE_CAPACITY : INITIAL_CAPACITY;
+    frames = (Frame *) realloc( frames, frameCap * sizeof( Frame ) );
+  }
+  frames[ frameCount++ ] = (Frame){ entry.site, now(), 0 };
+
+  entry.execute( stmt, env );
+
+  Frame *frame = &frames[ --frameCount ];
+  long long elapsed = now() - frame->start;
+  Site *site = &sites[ entry.site ];
+  site->count++;
+  site->total += elapsed;
+  site->self += elapsed - frame->child;
+  if ( frameCount > 0 )
+    frames[ frameCount - 1 ].child += elapsed;
+}
+
+/** Make a site for a statement and install the profiling execute
+    function on it and the statements nested in it.
+    @param stmt statement to install.
+    @param parent site for the statement stmt is nested in, or -1.
+*/
+static void installStmt( Stmt *stmt, int parent )
+{
+  // Don't install anything twice.
+  if ( stmt->execute == executeProfiled )
+    return;
+
+  if ( siteCount >= siteCap ) {
+    siteCap = siteCap ? siteCap * DOUBLE_CAPACITY : INITIAL_CAPACITY;
+    sites = (Site *) realloc( sites, siteCap * sizeof( Site ) );
+  }
+  int site = siteCount++;
+  sites[ site ] = (Site){ stmt->line, stmt->kind, parent, 0, 0, 0 };
+
+  addStmt( stmt, site );
+  stmt->execute = executeProfiled;
+
+  switch ( stmt->kind ) {
+  case CompoundKind: {
+    CompoundStmt *this = (CompoundStmt *) stmt;
+    for ( int i = 0; i < this->len; i++ )
+      installStmt( this->stmtList[ i ], site );
+    break;
+  }
+
+  case IfKind:
+  case WhileKind:
+    installStmt( ( (ConditionalStmt *) stmt )->body, site );
+    break;
+
+  default:
+    break;
+  }
+}
+
+void profileStmt( Stmt *stmt )
+{
+  installStmt( stmt, -1 );
+}
+
+/** Compare sites for sorting, with the most time spent in the statement
+    itself first.
+    @param a pointer to the index of the first site.
+    @param b pointer to the index of the second site.
+    @return negative, zero or positive, like strcmp().
+*/
+static int compareSites( void const *a, void const *b )
+{
+  Site const *s1 = &sites[ *(int const *) a ];
+  Site const *s2 = &sites[ *(int const *) b ];
+  if ( s1->self != s2->self )
+    return s1->self > s2->self ? -1 : 1;
+  return s1->line - s2->line;
+}
+
+/** Write the stack of statements leading to a site, outermost first,
+    with frames separated by semicolons.
+    @param fp file to write to.
+    @param site index of the site.
+*/
+static void writeStack( FILE *fp, int site )
+{
+  if ( sites[ site ].parent >= 0 ) {
+    writeStack( fp, sites[ site ].parent );
+    fputc( ';', fp );
+  }
+  fprintf( fp, "%s:%d", kindNames[ sites[ site ].kind ],
+           sites[ site ].line );
+}
+
+/** Print the profile report and write the folded stacks.  This runs at
+    exit. */
+static void reportProfile()
+{
+  // If we're exiting on an error, finish timing the statements that
+  // were still running.
+  long long end = now();
+  while ( frameCount > 0 ) {
+    Frame *frame = &frames[ --frameCount ];
+    Site *site = &sites[ frame->site ];
+    long long elapsed = end - frame->start;
+    site->count++;
+    site->total += elapsed;
+    site->self += elapsed - frame->child;
+    if ( frameCount > 0 )
+      frames[ frameCount - 1 ].child += elapsed;
+  }
+
+  // A loop's body runs once per iteration.
+  long *iterations = (long *) calloc( siteCount + 1, sizeof( long ) );
+  long long program = 0;
+  long executed = 0;
+  int ran = 0;
+  int *order = (int *) malloc( ( siteCount + 1 ) * sizeof( int ) );
+  for ( int i = 0; i < siteCount; i++ ) {
+    int parent = sites[ i ].parent;
+    if ( parent < 0 )
+      program += sites[ i ].total;
+    else if ( sites[ parent ].kind == WhileKind )
+      iterations[ parent ] = sites[ i ].count;
+    executed += sites[ i ].count;
+    if ( sites[ i ].count > 0 )
+      ran++;
+    order[ i ] = i;
+  }
+  qsort( order, siteCount, sizeof( int ), compareSites );
+
+  fprintf( stderr, "profile: %ld statements executed in %.3f ms\n",
+           executed, program / NSEC_PER_MSEC );
+  fprintf( stderr, "%6s  %-8s %12s %12s %12s %7s %12s\n", "line",
+           "stmt", "count", "total ms", "self ms", "self %", "iterations" );
+  int listed = 0;
+  for ( int i = 0; i < siteCount && listed < REPORT_LINES; i++ ) {
+    Site const *site = &sites[ order[ i ] ];
+    if ( site->count == 0 )
+      continue;
+    listed++;
+    fprintf( stderr, "%6d  %-8s %12ld %12.3f %12.3f %6.1f%%", site->line,
+             kindNames[ site->kind ], site->count,
+             site->total / NSEC_PER_MSEC, site->self / NSEC_PER_MSEC,
+             program ? site->self * PERCENT / program : 0.0 );
+    if ( site->kind == WhileKind )
+      fprintf( stderr, " %12ld", iterations[ order[ i ] ] );
+    fputc( '\n', stderr );
+  }
+  // Statements that never ran aren't listed anywhere.
+  if ( listed < ran )
+    fprintf( stderr, "(%d more statements in %s)\n", ran - listed,
+             foldedName );
+
+  // Folded stacks give the time spent in each statement itself, in
+  // nanoseconds, under the stack of statements it's nested in.
+  FILE *fp = fopen( foldedName, "w" );
+  if ( fp ) {
+    for ( int i = 0; i < siteCount; i++ )
+      if ( sites[ i ].self > 0 ) {
+        writeStack( fp, i );
+        fprintf( fp, " %lld\n", sites[ i ].self );
+      }
+    fclose( fp );
+  } else {
+    perror( foldedName );
+  }
+
+  free( iterations );
+  free( order );
+  free( sites );
+  free( table );
+  free( frames );
+  free( foldedName );
+}
+
+void startProfile( char const *foldedFile )
+{
+  foldedName = (char *) malloc( strlen( foldedFile ) + 1 );
+  strcpy( foldedName, foldedFile );
+  atexit( reportProfile );
+}
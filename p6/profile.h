@@ -0,0 +1,36 @@
+/**
+  @file profile.h
+  @author Adrian Chan (amchan)
+
+  Statement profiler for the tree-walking interpreter.  When profiling
+  is on, every statement's execute function is replaced with one that
+  counts executions and times them before calling the original.  When
+  it's off, nothing is installed, so it costs nothing.
+*/
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include "syntax.h"
+
+/** Suffix added to the program's file name to get the file for folded
+    stacks. */
+#define FOLDED_SUFFIX ".folded"
+
+/** Turn on profiling.  When the program exits (even on an error), a
+    report sorted by time spent in each statement is printed to stderr,
+    and the time for each stack of nested statements is written to a
+    file, one line per stack, in the folded format flame graph tools
+    read.
+    @param foldedFile name of the file to write the folded stacks to.
+*/
+void startProfile( char const *foldedFile );
+
+/** Install the profiling execute functions on the given statement and
+    all the statements nested inside it.  This must be done after the
+    statement is optimized and before it runs.
+    @param stmt top-level statement to profile.
+*/
+void profileStmt( Stmt *stmt );
+
+#endif
@@ -0,0 +1,40 @@
+/**
+  @file stats.c
+  @author Adrian Chan (amchan)
+  Counters for the work the runtime does.
+*/
+
+#include "stats.h"
+#include "kernel.h"
+
+RuntimeStats runtimeStats;
+
+void printStats( FILE *fp, int tokens, Arena const *arena )
+{
+  RuntimeStats const *s = &runtimeStats;
+  fprintf( fp, "{\n" );
+  fprintf( fp, "  \"tokens\": %d,\n", tokens );
+  fprintf( fp, "  \"kernels\": \"%s\",\n", kernelName() );
+  fprintf( fp, "  \"arena\": { \"highWater\": %zu, \"reserved\": %zu },\n",
+           arenaHighWater( arena ), arenaReserved( arena ) );
+  fprintf( fp, "  \"sequences\": { \"made\": %ld, \"freed\": %ld, "
+           "\"headerMallocs\": %ld },\n",
+           s->sequencesMade, s->sequencesFreed, s->headerMallocs );
+  fprintf( fp, "  \"elementArrays\": { \"handedOut\": %ld, \"inline\": %ld, "
+           "\"mallocs\": %ld },\n",
+           s->buffers, s->inlineBuffers, s->bufferMallocs );
+  fprintf( fp, "  \"refcounts\": { \"grabs\": %ld, \"releases\": %ld },\n",
+           s->grabs, s->releases );
+  fprintf( fp, "  \"bytesCopied\": { \"add\": %lld, \"mul\": %lld, "
+           "\"seqInit\": %lld, \"flatten\": %lld, \"copyOnWrite\": %lld, "
+           "\"grow\": %lld },\n",
+           s->addBytes, s->mulBytes, s->seqInitBytes, s->flattenBytes,
+           s->copyOnWriteBytes, s->growBytes );
+  fprintf( fp, "  \"growths\": { \"push\": %ld, \"append\": %ld, "
+           "\"widen\": %ld },\n",
+           s->pushGrowths, s->appendGrowths, s->widenings );
+  fprintf( fp, "  \"environment\": { \"lookups\": %ld, \"misses\": %ld, "
+           "\"stores\": %ld }\n",
+           s->lookups, s->lookupMisses, s->stores );
+  fprintf( fp, "}\n" );
+}
@@ -0,0 +1,95 @@
+/**
+  @file stats.h
+  @author Adrian Chan (amchan)
+
+  Counters for the work the runtime does: allocations, reference count
+  changes, copying and variable lookups.  They're always kept, since
+  bumping a counter is much cheaper than the work it counts, and
+  reported as JSON with --stats.
+*/
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdio.h>
+
+#include "arena.h"
+
+/** Counts of the work done by the runtime. */
+typedef struct {
+  /** Number of sequences made (headers handed out). */
+  long sequencesMade;
+
+  /** Number of sequences freed. */
+  long sequencesFreed;
+
+  /** Number of sequence headers that had to be allocated with malloc,
+      rather than reused from the pool. */
+  long headerMallocs;
+
+  /** Number of element arrays handed out, not counting inline storage. */
+  long buffers;
+
+  /** Number of sequences that started out using inline storage. */
+  long inlineBuffers;
+
+  /** Number of element arrays that had to be allocated with malloc or
+      realloc. */
+  long bufferMallocs;
+
+  /** Number of calls to grabSequence(). */
+  long grabs;
+
+  /** Number of calls to releaseSequence(). */
+  long releases;
+
+  /** Bytes of elements copied to concatenate sequences with +. */
+  long long addBytes;
+
+  /** Bytes of elements copied to repeat sequences with *. */
+  long long mulBytes;
+
+  /** Bytes of elements stored to build sequences from lists. */
+  long long seqInitBytes;
+
+  /** Bytes of elements copied to flatten ropes. */
+  long long flattenBytes;
+
+  /** Bytes of elements copied because a shared sequence was changed. */
+  long long copyOnWriteBytes;
+
+  /** Bytes of elements moved to a bigger array as a sequence grew. */
+  long long growBytes;
+
+  /** Number of times pushing one element had to grow a sequence. */
+  long pushGrowths;
+
+  /** Number of times appending elements had to grow a sequence. */
+  long appendGrowths;
+
+  /** Number of byte sequences widened to store ints. */
+  long widenings;
+
+  /** Number of variable lookups. */
+  long lookups;
+
+  /** Number of lookups past the end of the environment, for variables
+      that haven't been set yet, so they read as zero. */
+  long lookupMisses;
+
+  /** Number of variable stores. */
+  long stores;
+} RuntimeStats;
+
+/** Counts of the work done so far, for any part of the runtime to add to. */
+extern RuntimeStats runtimeStats;
+
+/** Write all the counters as a JSON object, along with the given
+    counts from the front end.
+    @param fp file to write to.
+    @param tokens number of tokens in the program's source.
+    @param arena arena the syntax trees were allocated from.
+*/
+void printStats( FILE *fp, int tokens, Arena const *arena );
+
+#endif
@@ -0,0 +1,157 @@
+/**
+  @file symbol.c
+  @author Adrian Chan (amchan)
+  Global table of interned symbols.
+*/
+
+#include "symbol.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Initial capacity for the symbol list and hash table.  The hash table
+    capacity is always a power of two. */
+#define INITIAL_CAPACITY 64
+
+/** Double the capacity of an array */
+#define DOUBLE_CAPACITY 2
+
+/** Marker for an empty hash table bucket. */
+#define EMPTY -1
+
+/** Text of the predefined symbols, in the order of their IDs. */
+static char const *const predefined[ FirstUserSym ] = {
+  "<number>", "<string>", "<char>", "<end>", "<error>",
+  "print", "if", "while", "push", "len",
+  "(", ")", "{", "}", "[", "]", ",", ";", "=",
+  "+", "-", "*", "/", "<", "==", "&&", "||"
+};
+
+/** Record for one interned symbol. */
+typedef struct {
+  /** Null-terminated copy of the symbol's text. */
+  char *name;
+
+  /** Length of the symbol's text. */
+  int len;
+
+  /** Hash of the symbol's text. */
+  unsigned int hash;
+} SymRec;
+
+/** List of all symbols, indexed by ID. */
+static SymRec *symbols;
+
+/** Number of symbols in the list. */
+static int symCount;
+
+/** Capacity of the symbol list. */
+static int symCap;
+
+/** Open-addressing hash table of symbol IDs, or EMPTY. */
+static int *table;
+
+/** Number of buckets in the hash table. */
+static int tableCap;
+
+/** FNV-1a hash of the given characters.
+    @param text characters to hash.
+    @param len number of characters.
+    @return hash code for the text.
+*/
+static unsigned int hashText( char const *text, int len )
+{
+  unsigned int h = 2166136261u;
+  for ( int i = 0; i < len; i++ ) {
+    h ^= (unsigned char) text[ i ];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/** Put a symbol ID in the first free bucket for its hash.
+    @param sym ID of the symbol to add.
+*/
+static void insertBucket( int sym )
+{
+  int pos = symbols[ sym ].hash & ( tableCap - 1 );
+  while ( table[ pos ] != EMPTY )
+    pos = ( pos + 1 ) & ( tableCap - 1 );
+  table[ pos ] = sym;
+}
+
+/** Grow the hash table and re-insert every symbol. */
+static void growTable()
+{
+  tableCap = tableCap ? tableCap * DOUBLE_CAPACITY : INITIAL_CAPACITY;
+  free( table );
+  table = (int *) malloc( tableCap * sizeof( int ) );
+  for ( int i = 0; i < tableCap; i++ )
+    table[ i ] = EMPTY;
+  for ( int i = 0; i < symCount; i++ )
+    insertBucket( i );
+}
+
+/** Add a new symbol to the table, without checking if it's already
+    there.
+    @param text characters of the symbol.
+    @param len number of characters.
+    @param hash hash of the characters.
+    @return ID of the new symbol.
+*/
+static int addSymbol( char const *text, int len, unsigned int hash )
+{
+  if ( symCount >= symCap ) {
+    symCap = symCap ? symCap * DOUBLE_CAPACITY : INITIAL_CAPACITY;
+    symbols = (SymRec *) realloc( symbols, symCap * sizeof( SymRec ) );
+  }
+
+  // Keep the hash table no more than half full.
+  if ( ( symCount + 1 ) * 2 > tableCap )
+    growTable();
+
+  SymRec *rec = &symbols[ symCount ];
+  rec->name = (char *) malloc( len + 1 );
+  memcpy( rec->name, text, len );
+  rec->name[ len ] = '\0';
+  rec->len = len;
+  rec->hash = hash;
+
+  insertBucket( symCount );
+  return symCount++;
+}
+
+/** Intern the predefined symbols, so they get the IDs in the enum. */
+static void initSymbols()
+{
+  for ( int i = 0; i < FirstUserSym; i++ )
+    addSymbol( predefined[ i ], strlen( predefined[ i ] ),
+               hashText( predefined[ i ], strlen( predefined[ i ] ) ) );
+}
+
+int internSymbol( char const *text, int len )
+{
+  if ( symCount == 0 )
+    initSymbols();
+
+  unsigned int hash = hashText( text, len );
+  int pos = hash & ( tableCap - 1 );
+  while ( table[ pos ] != EMPTY ) {
+    SymRec *rec = &symbols[ table[ pos ] ];
+    if ( rec->hash == hash && rec->len == len &&
+         memcmp( rec->name, text, len ) == 0 )
+      return table[ pos ];
+    pos = ( pos + 1 ) & ( tableCap - 1 );
+  }
+
+  return addSymbol( text, len, hash );
+}
+
+char const *symbolName( int sym )
+{
+  return symbols[ sym ].name;
+}
+
+int symbolLength( int sym )
+{
+  return symbols[ sym ].len;
+}
@@ -0,0 +1,56 @@
+/**
+  @file symbol.h
+  @author Adrian Chan (amchan)
+
+  Global table of interned symbols.  Keywords, operators and
+  identifiers are each given a small integer ID the first time they're
+  seen, so the parser can compare tokens with integer compares.
+*/
+
+#ifndef _SYMBOL_H_
+#define _SYMBOL_H_
+
+#include <stdbool.h>
+
+/** IDs for the symbols the parser knows about.  These are interned
+    first, in this order, so they always get these IDs.  The first five
+    aren't really symbols; they tell the parser what kind of literal a
+    token is, since literal text isn't interned, or mark the end of the
+    input or a token the lexer couldn't read. */
+enum {
+  NumberSym, StringSym, CharSym, EndSym, ErrorSym,
+
+  // Reserved words.
+  PrintSym, IfSym, WhileSym, PushSym, LenSym,
+
+  // Punctuation and operators.
+  LeftParenSym, RightParenSym, LeftBraceSym, RightBraceSym,
+  LeftBracketSym, RightBracketSym, CommaSym, SemicolonSym, AssignSym,
+  PlusSym, MinusSym, TimesSym, DivideSym, LessSym, EqualsSym, AndSym, OrSym,
+
+  /** Identifiers and any other symbols get IDs starting here. */
+  FirstUserSym
+};
+
+/** Return the ID for the symbol with the given text, adding it to the
+    table if it's not there yet.
+    @param text characters of the symbol (not necessarily null
+    terminated).
+    @param len number of characters in the symbol.
+    @return ID for this symbol.
+*/
+int internSymbol( char const *text, int len );
+
+/** Return the text of the symbol with the given ID.
+    @param sym symbol ID.
+    @return null-terminated text for the symbol.
+*/
+char const *symbolName( int sym );
+
+/** Return the number of characters in the symbol with the given ID.
+    @param sym symbol ID.
+    @return length of the symbol's text.
+*/
+int symbolLength( int sym );
+
+#endif
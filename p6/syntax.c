@@ -5,45 +5,39 @@
 */
 
 #include "syntax.h"
+#include "ops.h"
+#include "stats.h"
 #include <stdlib.h>
 #include <stdio.h>
-#include <string.h>
 
-/** Doule the capacity of an array */
-#define DOUBLE_CAPACITY 2
-//////////////////////////////////////////////////////////////////////
-// Error-reporting functions
+/** Arena new nodes are allocated from. */
+static Arena *nodeArena;
+
+/** Source line recorded in new nodes. */
+static int nodeLine;
 
-/** Report an error for a program with bad types, then exit. */
-static int reportTypeMismatch()
+void setSyntaxArena( Arena *arena )
 {
-  fprintf( stderr, "Type mismatch\n" );
-  exit( EXIT_FAILURE );
+  nodeArena = arena;
 }
 
-/** Require a given value to be an IntType value.  Exit with an error
-    message if not.
-    @param v value to check, passed by address.
- */
-static void requireIntType( Value const *v )
+void setSyntaxLine( int line )
 {
-  if ( v->vtype != IntType )
-    reportTypeMismatch();
+  nodeLine = line;
+}
+
+/** Allocate memory for a node from the syntax arena.
+    @param size number of bytes needed.
+    @return pointer to the new memory.
+*/
+static void *allocNode( size_t size )
+{
+  return arenaAlloc( nodeArena, size );
 }
 
 //////////////////////////////////////////////////////////////////////
 // LiteralInt
 
-/** Representation for a LiteralInt expression, a subclass of Expr that
-    evaluates to a constant value. */
-typedef struct {
-  Value (*eval)( Expr *expr, Environment *env );
-  void (*destroy)( Expr *expr );
-
-  /** Integer value this expression evaluates to. */
-  int val;
-} LiteralInt;
-
 /** Implementation of eval for LiteralInt expressions. */
 static Value evalLiteralInt( Expr *expr, Environment *env )
 {
@@ -51,25 +45,18 @@ static Value evalLiteralInt( Expr *expr, Environment *env )
   LiteralInt *this = (LiteralInt *)expr;
 
   // Return an int value containing a copy of the value we represent.
-  return (Value){ IntType, .ival = this->val };
-}
-
-/** Implementation of destroy for LiteralInt expressions. */
-static void destroyLiteralInt( Expr *expr )
-{
-  // This object is just one block of memory.  We can free it without
-  // even having to type-cast its pointer.
-  free( expr );
+  return intValue( this->val );
 }
 
 Expr *makeLiteralInt( int val )
 {
   // Allocate space for the LiteralInt object
-  LiteralInt *this = (LiteralInt *) malloc( sizeof( LiteralInt ) );
+  LiteralInt *this = allocNode( sizeof( LiteralInt ) );
 
-  // Remember the pointers to functions for evaluating and destroying ourself.
+  // Remember the pointer to the function for evaluating ourself.
   this->eval = evalLiteralInt;
-  this->destroy = destroyLiteralInt;
+  this->kind = LiteralIntKind;
+  this->line = nodeLine;
 
   // Remember the integer value we contain.
   this->val = val;
@@ -81,69 +68,64 @@ Expr *makeLiteralInt( int val )
 //////////////////////////////////////////////////////////////////////
 // SimpleExpr Struct
 
-/** Representation for an expression with either one or two
-    sub-expressionts.  With the right eval funciton, this struct should
-    be able to help implement any expression with either one or two
-    sub-expressiosn. */
-typedef struct {
-  Value (*eval)( Expr *expr, Environment *env );
-  void (*destroy)( Expr *oper );
-
-  /** The first sub-expression */
-  Expr *expr1;
-  
-  /** The second sub-expression, or NULL if it's not needed. */
-  Expr *expr2;
-} SimpleExpr;
-
-/** General-purpose function for freeing an expression represented by
-    SimpleExpr.  It frees the two sub-expressions, then frees the strucct
-    itself. */
-static void destroySimpleExpr( Expr *expr )
-{
-  // If this function gets called, expr must really be a SimpleExpr.
-  SimpleExpr *this = (SimpleExpr *)expr;
-
-  // Free the first sub-expression.
-  this->expr1->destroy( this->expr1 );
-
-  // Free the second one, if it exists.
-  if ( this->expr2 )
-    this->expr2->destroy( this->expr2 );
-
-  // Then the SimpleExpr struct itself.
-  free( this );
-}
-
 /** Helper funciton to construct a SimpleExpr representation and fill
     in the fields.
     @param first sub-expression in the expression.
     @param second sub-expression in the expression, or null if it only
     has one sub-expression.
     @param eval function implementing the eval mehod for this expression.
+    @param kind what kind of expression this is.
     @return new expression, as a poiner to Expr.
 */
 static Expr *buildSimpleExpr( Expr *expr1, Expr *expr2,
-                              Value (*eval)( Expr *, Environment * ) )
+                              Value (*eval)( Expr *, Environment * ),
+                              ExprKind kind )
 {
-  // Allocate space for a new SimpleExpr and fill in the pointer for
-  // its destroy function.
-  SimpleExpr *this = (SimpleExpr *) malloc( sizeof( SimpleExpr ) );
-  this->destroy = destroySimpleExpr;
+  // Allocate space for a new SimpleExpr.
+  SimpleExpr *this = allocNode( sizeof( SimpleExpr ) );
 
-  // Fill in the two parameters and the eval funciton.
+  // Fill in the two parameters, the eval funciton and the kind.
   this->eval = eval;
+  this->kind = kind;
+  this->line = nodeLine;
   this->expr1 = expr1;
   this->expr2 = expr2;
 
   return (Expr *) this;
 }
 
+/** Type of an eval function, for choosing between versions of one. */
+typedef Value (*EvalFunction)( Expr *expr, Environment *env );
+
+/** Quicken an arithmetic or comparison node the first time it runs.
+    Any given node almost always sees the same types every time, so if
+    its operands were both ints, it switches to a version that handles
+    just that case without calling out to the ops.  That version checks
+    the types on every call and switches to the generic version for good
+    if they ever change.  Operands of any other types go straight to the
+    generic version, which already tests the types only once before
+    getting to the sequence code.
+    @param this node that just ran for the first time.
+    @param v1 value of its left operand.
+    @param v2 value of its right operand.
+    @param intEval version of eval for two int operands.
+    @param genericEval version of eval for any operands.
+*/
+static void quicken( SimpleExpr *this, Value v1, Value v2,
+                     EvalFunction intEval, EvalFunction genericEval )
+{
+  if ( isInt( v1 ) && isInt( v2 ) )
+    this->eval = intEval;
+  else
+    this->eval = genericEval;
+}
+
 //////////////////////////////////////////////////////////////////////
 // Integer addition
 
-/** Implementation of the eval function for integer addition. */
-static Value evalAdd( Expr *expr, Environment *env )
+/** Generic implementation of eval for addition, for any types of
+    operands. */
+static Value evalAddGeneric( Expr *expr, Environment *env )
 {
   // If this function gets called, expr must really be a SimpleExpr.
   SimpleExpr *this = (SimpleExpr *)expr;
@@ -151,76 +133,50 @@ static Value evalAdd( Expr *expr, Environment *env )
   // Evaluate our left and right operands. 
   Value v1 = this->expr1->eval( this->expr1, env );
   Value v2 = this->expr2->eval( this->expr2, env );
-  
-  if (v1.vtype == IntType && v2.vtype == IntType) {
-    // Return the sum of the two expression values.
-    return (Value){ IntType, .ival = v1.ival + v2.ival };
-  }
-  
-  Sequence *s = makeSequence();
-  
-  if (v1.vtype == SeqType && v2.vtype == SeqType) {
-    for (int i = 0; i < v1.sval->len; i++) {
-      if (s->len == s->cap) {
-        s->cap *= DOUBLE_CAPACITY;
-        s->arr = realloc(s->arr, s->cap * sizeof(int));
-      }
-      s->arr[s->len] = v1.sval->arr[i];
-      s->len++;
-    }
-    
-    for (int i = 0; i < v2.sval->len; i++) {
-      if (s->len == s->cap) {
-        s->cap *= DOUBLE_CAPACITY;
-        s->arr = realloc(s->arr, s->cap * sizeof(int));
-      }
-      s->arr[s->len] = v2.sval->arr[i];
-      s->len++;
-    }
-    
-    releaseSequence(v1.sval);
-    releaseSequence(v2.sval);
-    
-    return (Value) {SeqType, .sval = s};
-  }
-  
-  Value seqVal = v1;
-  if (v1.vtype == IntType) {
-    seqVal = v2;
-    s->arr[s->len] = v1.ival;
-    s->len++;
-  }
-  
-  for (int i = 0; i < seqVal.sval->len; i++) {
-    if (s->len == s->cap) {
-      s->cap *= DOUBLE_CAPACITY;
-      s->arr = realloc(s->arr, s->cap * sizeof(int));
-    }
-    s->arr[s->len] = seqVal.sval->arr[i];
-    s->len++;
-  }
-  
-  if (v2.vtype == IntType) {
-    s->arr[s->len] = v2.ival;
-    s->len++;
-  }
-  
-  releaseSequence(seqVal.sval);
-  
-  return (Value) {SeqType, .sval = s};
+
+  // Return the sum (or concatenation) of the two expression values.
+  return addValues( v1, v2 );
+}
+
+/** Quickened implementation of eval for addition, for a node whose
+    operands have been ints. */
+static Value evalAddInt( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value v1 = this->expr1->eval( this->expr1, env );
+  Value v2 = this->expr2->eval( this->expr2, env );
+  if ( isInt( v1 ) && isInt( v2 ) )
+    return intValue( valueInt( v1 ) + valueInt( v2 ) );
+
+  // The guard failed, so this node sees other types.  Stop
+  // specializing it.
+  this->eval = evalAddGeneric;
+  return addValues( v1, v2 );
+}
+
+/** Implementation of eval for addition the first time it runs, choosing
+    the version to use from then on. */
+static Value evalAdd( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value v1 = this->expr1->eval( this->expr1, env );
+  Value v2 = this->expr2->eval( this->expr2, env );
+  quicken( this, v1, v2, evalAddInt, evalAddGeneric );
+  return addValues( v1, v2 );
 }
 
 Expr *makeAdd( Expr *left, Expr *right )
 {
   // Use the convenience function to build a SimpleExpr for addition
-  return buildSimpleExpr( left, right, evalAdd );
+  return buildSimpleExpr( left, right, evalAdd, AddKind );
 }
 
 //////////////////////////////////////////////////////////////////////
 // Integer subtracton
 
-/** Implementation of the eval function for integer subtraction. */
-static Value evalSub( Expr *expr, Environment *env )
+/** Generic implementation of eval for subtraction, for any types of
+    operands. */
+static Value evalSubGeneric( Expr *expr, Environment *env )
 {
   // If this function gets called, expr must really be a SimpleExpr.
   SimpleExpr *this = (SimpleExpr *)expr;
@@ -229,25 +185,49 @@ static Value evalSub( Expr *expr, Environment *env )
   Value v1 = this->expr1->eval( this->expr1, env );
   Value v2 = this->expr2->eval( this->expr2, env );
 
-  // Make sure the operands are both integers.
-  requireIntType( &v1 );
-  requireIntType( &v2 );
-
   // Return the difference of the two expression values.
-  return (Value){ IntType, .ival = v1.ival - v2.ival };
+  return subValues( v1, v2 );
+}
+
+/** Quickened implementation of eval for subtraction, for a node whose
+    operands have been ints. */
+static Value evalSubInt( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value v1 = this->expr1->eval( this->expr1, env );
+  Value v2 = this->expr2->eval( this->expr2, env );
+  if ( isInt( v1 ) && isInt( v2 ) )
+    return intValue( valueInt( v1 ) - valueInt( v2 ) );
+
+  // The guard failed, so this node sees other types.  Stop
+  // specializing it.
+  this->eval = evalSubGeneric;
+  return subValues( v1, v2 );
+}
+
+/** Implementation of eval for subtraction the first time it runs, choosing
+    the version to use from then on. */
+static Value evalSub( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value v1 = this->expr1->eval( this->expr1, env );
+  Value v2 = this->expr2->eval( this->expr2, env );
+  quicken( this, v1, v2, evalSubInt, evalSubGeneric );
+  return subValues( v1, v2 );
 }
 
 Expr *makeSub( Expr *left, Expr *right )
 {
   // Use the convenience function to build a SimpleExpr for subtraction.
-  return buildSimpleExpr( left, right, evalSub );
+  return buildSimpleExpr( left, right, evalSub, SubKind );
 }
 
 //////////////////////////////////////////////////////////////////////
 // Integer multiplication
 
-/** Implementation of the eval function for integer multiplication. */
-static Value evalMul( Expr *expr, Environment *env )
+/** Generic implementation of eval for multiplication, for any types of
+    operands. */
+static Value evalMulGeneric( Expr *expr, Environment *env )
 {
   // If this function gets called, expr must really be a SimpleExpr.
   SimpleExpr *this = (SimpleExpr *)expr;
@@ -255,48 +235,50 @@ static Value evalMul( Expr *expr, Environment *env )
   // Evaluate our left and right operands. 
   Value v1 = this->expr1->eval( this->expr1, env );
   Value v2 = this->expr2->eval( this->expr2, env );
-  
-  if (v1.vtype == IntType && v2.vtype == IntType) {
-    // Return the product of the two expression.
-    return (Value){ IntType, .ival = v1.ival * v2.ival };
-  }
-  
-  if (v1.vtype == SeqType && v2.vtype == SeqType) {
-    fprintf(stderr, "Type mismatch\n");
-    exit(1);
-  }
-  
-  Value intVal = v1.vtype == IntType ? v1 : v2;
-  Value seqVal = v1.vtype == IntType ? v2 : v1;
-  
-  Sequence *s = makeSequence();
-  for (int i = 0; i < intVal.ival; i++) {
-    for (int j = 0; j < seqVal.sval->len; j++) {
-      if (s->len == s->cap) {
-        s->cap *= DOUBLE_CAPACITY;
-        s->arr = realloc(s->arr, s->cap * sizeof(int));
-      }
-      
-      s->arr[s->len] = seqVal.sval->arr[j];
-      s->len++;
-    }
-  }
-  
-  releaseSequence(seqVal.sval);
-  return (Value){SeqType, .sval = s};
+
+  // Return the product (or repeated sequence) of the two expressions.
+  return mulValues( v1, v2 );
+}
+
+/** Quickened implementation of eval for multiplication, for a node whose
+    operands have been ints. */
+static Value evalMulInt( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value v1 = this->expr1->eval( this->expr1, env );
+  Value v2 = this->expr2->eval( this->expr2, env );
+  if ( isInt( v1 ) && isInt( v2 ) )
+    return intValue( valueInt( v1 ) * valueInt( v2 ) );
+
+  // The guard failed, so this node sees other types.  Stop
+  // specializing it.
+  this->eval = evalMulGeneric;
+  return mulValues( v1, v2 );
+}
+
+/** Implementation of eval for multiplication the first time it runs, choosing
+    the version to use from then on. */
+static Value evalMul( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value v1 = this->expr1->eval( this->expr1, env );
+  Value v2 = this->expr2->eval( this->expr2, env );
+  quicken( this, v1, v2, evalMulInt, evalMulGeneric );
+  return mulValues( v1, v2 );
 }
 
 Expr *makeMul( Expr *left, Expr *right )
 {
   // Use the convenience function to build a SimpleExpr for multiplication.
-  return buildSimpleExpr( left, right, evalMul );
+  return buildSimpleExpr( left, right, evalMul, MulKind );
 }
 
 //////////////////////////////////////////////////////////////////////
 // Integer division
 
-/** Implementation of the eval function for integer division. */
-static Value evalDiv( Expr *expr, Environment *env )
+/** Generic implementation of eval for division, for any types of
+    operands. */
+static Value evalDivGeneric( Expr *expr, Environment *env )
 {
   // If this function gets called, expr must really be a SimpleExpr.
   SimpleExpr *this = (SimpleExpr *)expr;
@@ -305,24 +287,41 @@ static Value evalDiv( Expr *expr, Environment *env )
   Value v1 = this->expr1->eval( this->expr1, env );
   Value v2 = this->expr2->eval( this->expr2, env );
 
-  // Make sure the operands are both integers.
-  requireIntType( &v1 );
-  requireIntType( &v2 );
+  // Return the quotient of the two expression.
+  return divValues( v1, v2 );
+}
 
-  // Catch it if we try to divide by zero.
-  if ( v2.ival == 0 ) {
-    fprintf( stderr, "Divide by zero\n" );
-    exit( EXIT_FAILURE );
-  }
+/** Quickened implementation of eval for division, for a node whose
+    operands have been ints. */
+static Value evalDivInt( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value v1 = this->expr1->eval( this->expr1, env );
+  Value v2 = this->expr2->eval( this->expr2, env );
+  if ( isInt( v1 ) && isInt( v2 ) && valueInt( v2 ) != 0 )
+    return intValue( valueInt( v1 ) / valueInt( v2 ) );
 
-  // Return the quotient of the two expression.
-  return (Value){ IntType, .ival = v1.ival / v2.ival };
+  // The guard failed, so this node sees other types (or a zero
+  // divisor, for the ops to report).  Stop specializing it.
+  this->eval = evalDivGeneric;
+  return divValues( v1, v2 );
+}
+
+/** Implementation of eval for division the first time it runs, choosing
+    the version to use from then on. */
+static Value evalDiv( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value v1 = this->expr1->eval( this->expr1, env );
+  Value v2 = this->expr2->eval( this->expr2, env );
+  quicken( this, v1, v2, evalDivInt, evalDivGeneric );
+  return divValues( v1, v2 );
 }
 
 Expr *makeDiv( Expr *left, Expr *right )
 {
   // Use the convenience function to build a SimpleExpr for division.
-  return buildSimpleExpr( left, right, evalDiv );
+  return buildSimpleExpr( left, right, evalDiv, DivKind );
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -336,7 +335,7 @@ static Value evalAnd( Expr *expr, Environment *env )
   // Evaluate the left operand; return immediately if it's false.
   Value v1 = this->expr1->eval( this->expr1, env );
   requireIntType( &v1 );
-  if ( v1.ival == 0 )
+  if ( valueInt( v1 ) == 0 )
     return v1;
   
   // Evaluate the right operand.
@@ -350,7 +349,7 @@ static Value evalAnd( Expr *expr, Environment *env )
 Expr *makeAnd( Expr *left, Expr *right )
 {
   // Use the convenience function to build a SimpleExpr for the logical and.
-  return buildSimpleExpr( left, right, evalAnd );
+  return buildSimpleExpr( left, right, evalAnd, AndKind );
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -364,7 +363,7 @@ static Value evalOr( Expr *expr, Environment *env )
   // Evaluate the left operand; return immediately if it's true.
   Value v1 = this->expr1->eval( this->expr1, env );
   requireIntType( &v1 );
-  if ( v1.ival )
+  if ( valueInt( v1 ) )
     return v1;
   
   // Evaluate the right operand
@@ -378,14 +377,15 @@ static Value evalOr( Expr *expr, Environment *env )
 Expr *makeOr( Expr *left, Expr *right )
 {
   // Use the convenience function to build a SimpleExpr for the logical or
-  return buildSimpleExpr( left, right, evalOr );
+  return buildSimpleExpr( left, right, evalOr, OrKind );
 }
 
 //////////////////////////////////////////////////////////////////////
 // Less-than comparison
 
-/** Implementation of eval for the less than operator. */
-static Value evalLess( Expr *expr, Environment *env )
+/** Generic implementation of eval for the less than operator, for any types of
+    operands. */
+static Value evalLessGeneric( Expr *expr, Environment *env )
 {
   // If this function gets called, expr must really be a SimpleExpr.
   SimpleExpr *this = (SimpleExpr *)expr;
@@ -394,44 +394,50 @@ static Value evalLess( Expr *expr, Environment *env )
   Value v1 = this->expr1->eval( this->expr1, env );
   Value v2 = this->expr2->eval( this->expr2, env );
 
-  // Make sure the operands are both the same type.
-  if ( v1.vtype != v2.vtype )
-    reportTypeMismatch();
-
-  if ( v1.vtype == IntType ) {
-    // Is v1 less than v2
-    return (Value){ IntType, .ival = v1.ival < v2.ival ? true : false };
-  } else {
-    // Replace with code to compare sequences.
-    int len1 = v1.sval->len;
-    int len2 = v2.sval->len;
-    int shortest = len1 < len2 ? len1 : len2;
-    for (int i = 0; i < shortest; i++) {
-      if (v1.sval->arr[i] != v2.sval->arr[i]) {
-        releaseSequence(v1.sval);
-        releaseSequence(v2.sval);
-        return (Value){ IntType, .ival = v1.sval->arr[i] < v2.sval->arr[i] ? true : false};
-        
-      }
-    }
-    releaseSequence(v1.sval);
-    releaseSequence(v2.sval);
-    return (Value){ IntType, .ival = len1 < len2 ? true : false};
-  }
+  // Is v1 less than v2
+  return lessValues( v1, v2 );
+}
+
+/** Quickened implementation of eval for the less than operator, for a node whose
+    operands have been ints. */
+static Value evalLessInt( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value v1 = this->expr1->eval( this->expr1, env );
+  Value v2 = this->expr2->eval( this->expr2, env );
+  if ( isInt( v1 ) && isInt( v2 ) )
+    return intValue( valueInt( v1 ) < valueInt( v2 ) );
+
+  // The guard failed, so this node sees other types.  Stop
+  // specializing it.
+  this->eval = evalLessGeneric;
+  return lessValues( v1, v2 );
+}
+
+/** Implementation of eval for the less than operator the first time it runs, choosing
+    the version to use from then on. */
+static Value evalLess( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value v1 = this->expr1->eval( this->expr1, env );
+  Value v2 = this->expr2->eval( this->expr2, env );
+  quicken( this, v1, v2, evalLessInt, evalLessGeneric );
+  return lessValues( v1, v2 );
 }
 
 Expr *makeLess( Expr *left, Expr *right )
 {
   // Use the convenience function to build a SimpleExpr for the less-than
   // comparison.
-  return buildSimpleExpr( left, right, evalLess );
+  return buildSimpleExpr( left, right, evalLess, LessKind );
 }
 
 //////////////////////////////////////////////////////////////////////
 // Equality comparison
 
-/** Eval function for an equality test. */
-static Value evalEquals( Expr *expr, Environment *env )
+/** Generic implementation of eval for an equality test, for any types of
+    operands. */
+static Value evalEqualsGeneric( Expr *expr, Environment *env )
 {
   // If this function gets called, expr must really be a SimpleExpr.
   SimpleExpr *this = (SimpleExpr *)expr;
@@ -440,107 +446,141 @@ static Value evalEquals( Expr *expr, Environment *env )
   Value v1 = this->expr1->eval( this->expr1, env );
   Value v2 = this->expr2->eval( this->expr2, env );
 
-  // Make sure the same type.
-  if ( v1.vtype == IntType && v2.vtype == IntType ) {
-    return (Value){ IntType, .ival = ( v1.ival == v2.ival ) };
-  } else {
-    // Replace with code to permit sequence-sequence comparison.
-    // A sequence can also be compared to an int, but they should
-    // never be considered equal.
-    
-    if (v1.vtype == IntType) {
-      releaseSequence(v2.sval);
-      return (Value){IntType, .ival = false};
-    } else if (v2.vtype == IntType) {
-      releaseSequence(v1.sval);
-      return (Value){IntType, .ival = false};
-    }
-    
-    if (v1.sval->len != v2.sval->len) {
-      releaseSequence(v1.sval);
-      releaseSequence(v2.sval);
-      return (Value){IntType, .ival = false};
-    }
-    
-    for (int i = 0; i < v1.sval->len; i++) {
-      if (v1.sval->arr[i] != v2.sval->arr[i]) {
-        releaseSequence(v1.sval);
-        releaseSequence(v2.sval);
-        return (Value){IntType, .ival = false};
-      }
-    }
-    
-    releaseSequence(v1.sval);
-    releaseSequence(v2.sval);
-    return (Value){IntType, .ival = true};
-    
-  }
+  // Are the two values the same?
+  return equalsValues( v1, v2 );
+}
+
+/** Quickened implementation of eval for an equality test, for a node whose
+    operands have been ints. */
+static Value evalEqualsInt( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value v1 = this->expr1->eval( this->expr1, env );
+  Value v2 = this->expr2->eval( this->expr2, env );
+  if ( isInt( v1 ) && isInt( v2 ) )
+    return intValue( valueInt( v1 ) == valueInt( v2 ) );
+
+  // The guard failed, so this node sees other types.  Stop
+  // specializing it.
+  this->eval = evalEqualsGeneric;
+  return equalsValues( v1, v2 );
+}
 
-  // Never reached.
-  return (Value){ IntType, .ival = 0 };
+/** Implementation of eval for an equality test the first time it runs, choosing
+    the version to use from then on. */
+static Value evalEquals( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value v1 = this->expr1->eval( this->expr1, env );
+  Value v2 = this->expr2->eval( this->expr2, env );
+  quicken( this, v1, v2, evalEqualsInt, evalEqualsGeneric );
+  return equalsValues( v1, v2 );
 }
 
 Expr *makeEquals( Expr *left, Expr *right )
 {
   // Use the convenience function to build a SimpleExpr for the equals test.
-  return buildSimpleExpr( left, right, evalEquals );
+  return buildSimpleExpr( left, right, evalEquals, EqualsKind );
 }
 
 //////////////////////////////////////////////////////////////////////
 // Sequence
 
-
-/** Representation for a SequenceExpr expression, a subclass of Expr that
-    evaluates to a Sequence value. */
-typedef struct {
-  Value (*eval)(Expr *expr, Environment *env);
-  void (*destroy)(Expr *expr);
-  
-  Expr **expList;
-  int len;
-  
-} SequenceExpr;
-
 /** Eval function for SequenceExpr */
 static Value evalSeq(Expr *expr, Environment *env)
 {
   SequenceExpr *this = (SequenceExpr *)expr;
   
-  Sequence *s = makeSequence();
-  for (int i = 0; i < this->len; i++) {
-    if (s->len == s->cap) {
-      s->cap *= DOUBLE_CAPACITY;
-      s->arr = realloc(s->arr, s->cap * sizeof(int));
-    }
-    s->arr[s->len++] = this->expList[i]->eval(this->expList[i], env).ival;
-  }
+  Sequence *s = makeSequenceCap(this->len);
+  runtimeStats.seqInitBytes += this->len * sizeof(int);
+  for (int i = 0; i < this->len; i++)
+    pushSequence(s, valueInt(this->expList[i]->eval(this->expList[i], env)));
   
-  return (Value){SeqType, .sval = s};
-
-}
-
-/** Destroy function for SequenceExpr */
-static void destroySeq(Expr *expr)
-{
-  SequenceExpr *this = (SequenceExpr*)expr;
-  for (int i = 0; i < this->len; i++) {
-    this->expList[i]->destroy(this->expList[i]);
-  }
-  free(this->expList);
-  free(expr);
+  return seqValue(s);
 }
 
 Expr *makeSeqInit(int len, Expr **elist) {
-  SequenceExpr *this = malloc(sizeof(SequenceExpr));
+  // Copy the list into the arena, right after the node.
+  SequenceExpr *this = allocNode(sizeof(SequenceExpr) + len * sizeof(Expr *));
   this->eval = evalSeq;
-  this->destroy = destroySeq;
+  this->kind = SeqInitKind;
+  this->line = nodeLine;
   
-  
-  this->expList = elist;
+  this->expList = (Expr **)(this + 1);
+  for (int i = 0; i < len; i++)
+    this->expList[i] = elist[i];
   this->len = len;
   
   return (Expr *)this;
 }
+//////////////////////////////////////////////////////////////////////
+// Built-in function call
+
+/** Eval function for CallExpr */
+static Value evalCall( Expr *expr, Environment *env )
+{
+  CallExpr *this = (CallExpr *) expr;
+
+  Value args[ MAX_BUILTIN_ARGS ];
+  for ( int i = 0; i < this->len; i++ )
+    args[ i ] = this->expList[ i ]->eval( this->expList[ i ], env );
+
+  return callBuiltin( this->fn, args );
+}
+
+Expr *makeCall( Builtin fn, int len, Expr **args )
+{
+  // Copy the arguments into the arena, right after the node.
+  CallExpr *this = allocNode( sizeof( CallExpr ) + len * sizeof( Expr * ) );
+  this->eval = evalCall;
+  this->kind = CallKind;
+  this->line = nodeLine;
+
+  this->expList = (Expr **)( this + 1 );
+  for ( int i = 0; i < len; i++ )
+    this->expList[ i ] = args[ i ];
+  this->len = len;
+  this->fn = fn;
+
+  return (Expr *) this;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Sequence literal
+
+/** Eval function for SeqLiteral */
+static Value evalSeqLiteral( Expr *expr, Environment *env )
+{
+  SeqLiteral *this = (SeqLiteral *) expr;
+
+  // Hand out another reference to our constant, rather than building a
+  // new sequence every time.
+  grabSequence( this->seq );
+  return seqValue( this->seq );
+}
+
+/** Release a SeqLiteral's constant when the arena it's in is reset. */
+static void releaseSeqLiteral( void *data )
+{
+  SeqLiteral *this = (SeqLiteral *) data;
+  releaseSequence( this->seq );
+}
+
+Expr *makeSeqLiteral( int len, int const *vals )
+{
+  SeqLiteral *this = allocNode( sizeof( SeqLiteral ) );
+  this->eval = evalSeqLiteral;
+  this->kind = SeqLiteralKind;
+  this->line = nodeLine;
+
+  // The constant isn't in the arena, so it's released when the arena
+  // is reset.
+  this->seq = makeConstSequence( len, vals );
+  arenaOnReset( nodeArena, releaseSeqLiteral, this );
+
+  return (Expr *) this;
+}
+
 //////////////////////////////////////////////////////////////////////
 //Sequence Index
 
@@ -548,26 +588,15 @@ Expr *makeSeqInit(int len, Expr **elist) {
 static Value evalSequenceIndex(Expr *expr, Environment *env)
 { 
   SimpleExpr *this = (SimpleExpr *)expr;
-  Sequence *s = this->expr1->eval(this->expr1, env).sval;
-  Value idVal = this->expr2->eval(this->expr2, env);
-  if (idVal.vtype != IntType) {
-    fprintf(stderr, "Type mismatch\n");
-    exit(1);
-  }
-  int id = idVal.ival;
-  if (id < 0 || id >= s->len) {
-    fprintf(stderr, "Index out of bounds\n");
-    exit(1);
-  }
-  
-  int val = s->arr[id];
-  releaseSequence(s);
-  return (Value){IntType, .ival = val};
+  Value seq = this->expr1->eval(this->expr1, env);
+  Value idx = this->expr2->eval(this->expr2, env);
+
+  return indexValue(seq, idx);
 }
 
 Expr *makeSequenceIndex(Expr *aexpr, Expr *iexpr)
 {
-  return buildSimpleExpr(aexpr, iexpr, evalSequenceIndex);
+  return buildSimpleExpr(aexpr, iexpr, evalSequenceIndex, IndexKind);
 }
 //////////////////////////////////////////////////////////////////////
 // Length
@@ -579,35 +608,17 @@ static Value evalLen(Expr *expr, Environment *env)
   
   Value val = this->expr1->eval(this->expr1, env);
   
-  if (val.vtype == IntType) {
-    fprintf(stderr, "Type mismatch\n");
-    exit(1);
-  }
-  int len = val.sval->len;
-  
-  releaseSequence(val.sval);
-  
-  return (Value){IntType, .ival = len};
+  return lenValue(val);
 }
 
 Expr *makeLen(Expr *expr)
 {
-  return buildSimpleExpr(expr, NULL, evalLen);
+  return buildSimpleExpr(expr, NULL, evalLen, LenKind);
 }
 
 //////////////////////////////////////////////////////////////////////
 // Variable in an expression
 
-/** Representation for an expression representing an occurrence of a
-    variable, subclass of Expr. */
-typedef struct {
-  Value (*eval)( Expr *expr, Environment *env );
-  void (*destroy)( Expr *expr );
-
-  /** Name of the variable. */
-  char name[ MAX_VAR_NAME + 1 ];
-} VariableExpr;
-
 /** Eval function for Variable */
 static Value evalVariable( Expr *expr, Environment *env )
 {
@@ -615,63 +626,28 @@ static Value evalVariable( Expr *expr, Environment *env )
   VariableExpr *this = (VariableExpr *) expr;
 
   // Get the value of this variable.
-  Value val = lookupVariable( env, this->name );
+  Value val = lookupVariable( env, this->slot );
   
-  if (val.vtype == SeqType) {
-      grabSequence(val.sval);
+  if (isSeq(val)) {
+      grabSequence(valueSeq(val));
   }
   
   return val;
 }
 
-/** Implementation of destroy for Variable. */
-static void destroyVariable( Expr *expr )
-{
-  free( expr );
-}
-
-Expr *makeVariable( char const *name )
+Expr *makeVariable( int slot )
 {
   // Allocate space for the Variable statement, and fill in its function
-  // pointers and a copy of the variable name.
-  VariableExpr *this = (VariableExpr *) malloc( sizeof( VariableExpr ) );
+  // pointers and the slot for the variable name.
+  VariableExpr *this = allocNode( sizeof( VariableExpr ) );
   this->eval = evalVariable;
-  this->destroy = destroyVariable;
-  strcpy( this->name, name );
+  this->kind = VariableKind;
+  this->line = nodeLine;
+  this->slot = slot;
 
   return (Expr *) this;
 }
 
-//////////////////////////////////////////////////////////////////////
-// SimpleStmt Struct
-
-/** Generic representation for a statement that contains one or two
-    expressions.  With different execute methods, this same struct
-    can be used to represent print and push statements. */
-typedef struct {
-  void (*execute)( Stmt *stmt, Environment *env );
-  void (*destroy)( Stmt *stmt );
-
-  /** First (or only) expression used by this statement. */
-  Expr *expr1;
-  /** Second expression used by this statement, or null */
-  Expr *expr2;
-} SimpleStmt;
-
-/** Generic destroy function for SimpleStmt, with either one
-    or two sub-expressions. */
-static void destroySimpleStmt( Stmt *stmt )
-{
-  // If this function gets called, stmt must really be a SimpleStmt.
-  SimpleStmt *this = (SimpleStmt *)stmt;
-
-  // Free our subexpression then the SimpleStmt object itself.
-  this->expr1->destroy( this->expr1 );
-  if ( this->expr2 )
-    this->expr2->destroy( this->expr2 );
-  free( this );
-}
-
 //////////////////////////////////////////////////////////////////////
 // Print Statement
 
@@ -681,31 +657,20 @@ static void executePrint( Stmt *stmt, Environment *env )
   // If this function gets called, stmt must really be a SimpleStmt.
   SimpleStmt *this = (SimpleStmt *)stmt;
 
-  // Evaluate our argument.
+  // Evaluate our argument and print it appropriately, based on its type.
   Value v = this->expr1->eval( this->expr1, env );
-
-  // Print the value of our expression appropriately, based on its type.
-  if ( v.vtype == IntType ) {
-    printf( "%d", v.ival );
-  } else {
-    // Replace with code to permit print a sequence as a string of
-    // ASCII character codes.
-    for (int i = 0; i < v.sval->len; i++) {
-      putchar(v.sval->arr[i]);
-    }
-        
-    releaseSequence(v.sval);
-  }
+  printValue( v );
 }
 
 Stmt *makePrint( Expr *expr )
 {
   // Allocate space for the SimpleStmt object
-  SimpleStmt *this = (SimpleStmt *) malloc( sizeof( SimpleStmt ) );
+  SimpleStmt *this = allocNode( sizeof( SimpleStmt ) );
 
-  // Remember the pointers to execute and destroy this statement.
+  // Remember the pointer to execute this statement.
   this->execute = executePrint;
-  this->destroy = destroySimpleStmt;
+  this->kind = PrintKind;
+  this->line = nodeLine;
 
   // Remember the expression for the thing we're supposed to print.
   this->expr1 = expr;
@@ -718,18 +683,6 @@ Stmt *makePrint( Expr *expr )
 //////////////////////////////////////////////////////////////////////
 // Compound Statement
 
-/** Representation for a compound statement, derived from Stmt. */
-typedef struct {
-  void (*execute)( Stmt *stmt, Environment *env );
-  void (*destroy)( Stmt *stmt );
-
-  /** Number of statements in the compound. */
-  int len;
-  
-  /** List of statements in the compound. */
-  Stmt **stmtList;
-} CompoundStmt;
-
 /** Implementation of execute for CompountStmt */
 static void executeCompound( Stmt *stmt, Environment *env )
 {
@@ -741,67 +694,28 @@ static void executeCompound( Stmt *stmt, Environment *env )
     this->stmtList[ i ]->execute( this->stmtList[ i ], env );
 }
 
-/** Implementation of destroy for CompountStmt */
-static void destroyCompound( Stmt *stmt )
-{
-  // If this function gets called, stmt must really be a CompoundStmt.
-  CompoundStmt *this = (CompoundStmt *)stmt;
-
-  // Free the list of statements inside this compond.
-  for ( int i = 0; i < this->len; i++ )
-    this->stmtList[ i ]->destroy( this->stmtList[ i ] );
-
-  // Then, free the array of pointers and the compund statement itself.
-  free( this->stmtList );
-  free( this );
-}
-
 Stmt *makeCompound( int len, Stmt **stmtList )
 {
-  // Allocate space for the CompoundStmt object
-  CompoundStmt *this = (CompoundStmt *) malloc( sizeof( CompoundStmt ) );
+  // Allocate space for the CompoundStmt object, with its list of
+  // statements right after it.
+  CompoundStmt *this =
+    allocNode( sizeof( CompoundStmt ) + len * sizeof( Stmt * ) );
 
-  // Remember the pointers to execute and destroy this statement.
+  // Remember the pointer to execute this statement.
   this->execute = executeCompound;
-  this->destroy = destroyCompound;
+  this->kind = CompoundKind;
+  this->line = nodeLine;
 
   // Remember the list of statements in the compound.
   this->len = len;
-  this->stmtList = stmtList;
+  this->stmtList = (Stmt **) ( this + 1 );
+  for ( int i = 0; i < len; i++ )
+    this->stmtList[ i ] = stmtList[ i ];
 
   // Return the result, as an instance of the Stmt interface.
   return (Stmt *) this;
 }
 
-///////////////////////////////////////////////////////////////////////
-// ConditioanlStatement (for while/if)
-
-/** Representation for either a while or if statement, subclass of Stmt. */
-typedef struct {
-  void (*execute)( Stmt *stmt, Environment *env );
-  void (*destroy)( Stmt *stmt );
-
-  // Condition to be checked before running the body.
-  Expr *cond;
-
-  // Body to execute if / while cond is true.
-  Stmt *body;
-} ConditionalStmt;
-
-/** Implementation of destroy for either while of if statements. */
-static void destroyConditional( Stmt *stmt )
-{
-  // If this function gets called, stmt must really be a ConditionalStmt.
-  ConditionalStmt *this = (ConditionalStmt *)stmt;
-
-  // Destroy the condition expression and the statement in the body.
-  this->cond->destroy( this->cond );
-  this->body->destroy( this->body );
-
-  // Then, free the ConditionalStmt struct.
-  free( this );
-}
-
 ///////////////////////////////////////////////////////////////////////
 // if statement
 
@@ -816,7 +730,7 @@ static void executeIf( Stmt *stmt, Environment *env )
   requireIntType( &result );
 
   // Execute the body if the condition evaluated to true.
-  if ( result.ival )
+  if ( valueInt( result ) )
     this->body->execute( this->body, env );
 }
 
@@ -824,11 +738,12 @@ Stmt *makeIf( Expr *cond, Stmt *body )
 {
   // Allocate an instance of ConditionalStmt
   ConditionalStmt *this =
-    (ConditionalStmt *) malloc( sizeof( ConditionalStmt ) );
+    allocNode( sizeof( ConditionalStmt ) );
 
-  // Functions to execute and destroy an if statement.
+  // Function to execute an if statement.
   this->execute = executeIf;
-  this->destroy = destroyConditional;
+  this->kind = IfKind;
+  this->line = nodeLine;
 
   // Fill in the condition and the body of the if.
   this->cond = cond;
@@ -852,7 +767,7 @@ static void executeWhile( Stmt *stmt, Environment *env )
   requireIntType( &result );
   
   // Execute the body while the condition evaluates to true.
-  while ( result.ival ) {
+  while ( valueInt( result ) ) {
     this->body->execute( this->body, env );
     
     // Get the value of the condition for the next iteration.
@@ -865,11 +780,12 @@ Stmt *makeWhile( Expr *cond, Stmt *body )
 {
   // Allocate an instance of ConditionalStmt
   ConditionalStmt *this =
-    (ConditionalStmt *) malloc( sizeof( ConditionalStmt ) );
+    allocNode( sizeof( ConditionalStmt ) );
 
-  // Functions to execute and destroy a while statement.
+  // Function to execute a while statement.
   this->execute = executeWhile;
-  this->destroy = destroyConditional;
+  this->kind = WhileKind;
+  this->line = nodeLine;
 
   // Fill in the condition and the body of the while.
   this->cond = cond;
@@ -885,27 +801,18 @@ Stmt *makeWhile( Expr *cond, Stmt *body )
 static void executePush(Stmt *stmt, Environment *env)
 {
   SimpleStmt *this = (SimpleStmt *) stmt;
-  Value val = this->expr1->eval(this->expr1, env);
-  
-  if (val.sval->len == val.sval->cap) {
-    val.sval->cap *= DOUBLE_CAPACITY;
-    val.sval->arr = realloc(val.sval->arr, val.sval->cap * sizeof(int));
-  }
+  Value seq = this->expr1->eval(this->expr1, env);
+  Value val = this->expr2->eval(this->expr2, env);
   
-  Value pushVal = this->expr2->eval(this->expr2, env);
-  if (pushVal.vtype != IntType) {
-    fprintf(stderr, "Type mismatch\n");
-    exit(1);
-  }
-  val.sval->arr[val.sval->len++] = pushVal.ival;
-  releaseSequence(val.sval);
+  pushValue(seq, val);
 }
 
 Stmt *makePush(Expr *s, Expr *v)
 {
-  SimpleStmt *this = malloc(sizeof(SimpleStmt));
+  SimpleStmt *this = allocNode(sizeof(SimpleStmt));
   this->execute = executePush;
-  this->destroy = destroySimpleStmt;
+  this->kind = PushKind;
+  this->line = nodeLine;
   
   this->expr1 = s;
   this->expr2 = v;
@@ -915,76 +822,428 @@ Stmt *makePush(Expr *s, Expr *v)
 ///////////////////////////////////////////////////////////////////////
 // assignment statement
 
-/** Representation of an assignment statement, a subclass of
-    Stmt. This representation should be suitable for assigning to a
-    variable or an element of a sequence.  */
-typedef struct {
-  void (*execute)( Stmt *stmt, Environment *env );
-  void (*destroy)( Stmt *stmt );
-
-  /** Name of the variable we're assigning to. */
-  char name[ MAX_VAR_NAME + 1 ];
-  
-  /** If we're assigning to an element of a sequence, this is the index
-      expression. Otherwise, it's zero. */
-  Expr *iexpr;
-
-  /** Expression for the right-hand side of the assignment (the source). */
-  Expr *expr;
-} AssignmentStmt;
-
-/** Implementation of destroy for assignment Statements. */
-static void destroyAssignment( Stmt *stmt )
-{
-  AssignmentStmt *this = (AssignmentStmt *)stmt;
-
-  // Destroy the source expression and the index (if there is one)
-  
-  this->expr->destroy( this->expr );
-  if ( this->iexpr )
-    this->iexpr->destroy( this->iexpr );
-  free( this );
-}
-
 /** Implementation of execute for assignment Statements. */
 static void executeAssignment( Stmt *stmt, Environment *env )
 {
   // If we get to this function, stmt must be an AssignmentStmt.
   AssignmentStmt *this = (AssignmentStmt *) stmt;
 
-  // Evaluate the right-hand side of the equals.
+  // Evaluate the right-hand side of the equals, and change the
+  // variable's value.
   Value result = this->expr->eval( this->expr, env );
+  setVariable( env, this->slot, result );
   
-  if ( this->iexpr ) {
-    // Replace with code to permit assigning to a sequence element.
-    Value val = lookupVariable(env, this->name);
-    val.sval->arr[this->iexpr->eval(this->iexpr, env).ival] = result.ival;
-  } else {
-    // It's a variable, change its value
-    setVariable( env, this->name, result );
+  if (isSeq(result)) {
+    releaseSequence(valueSeq(result));
   }
-  
-  if (result.vtype == SeqType) {
-    releaseSequence(result.sval);
+}
+
+/** Implementation of execute for assignments to one element of a
+    sequence. */
+static void executeStoreIndex( Stmt *stmt, Environment *env )
+{
+  AssignmentStmt *this = (AssignmentStmt *) stmt;
+  Value result = this->expr->eval( this->expr, env );
+  Value seq = lookupVariable( env, this->slot );
+  Value idx = this->iexpr->eval( this->iexpr, env );
+
+  // Store an int at an index in range right here, and leave anything
+  // else to the ops to report.
+  if ( isSeq( seq ) && isInt( idx ) &&
+       isInt( result ) && valueInt( idx ) >= 0 &&
+       valueInt( idx ) < valueSeq( seq )->len )
+    storeSequence( valueSeq( seq ), valueInt( idx ), valueInt( result ) );
+  else
+    storeIndexValue( seq, idx, result );
+
+  if (isSeq(result)) {
+    releaseSequence(valueSeq(result));
   }
 }
 
-Stmt *makeAssignment( char const *name, Expr *iexpr, Expr *expr )
+/** Implementation of execute for assignments of the form var = var + x,
+    which may be able to append to the variable's sequence in place. */
+static void executeAddAssignment( Stmt *stmt, Environment *env )
 {
-  // Allocate the AssignmentStmt representations.
-  AssignmentStmt *this =
-    (AssignmentStmt *) malloc( sizeof( AssignmentStmt ) );
+  AssignmentStmt *this = (AssignmentStmt *) stmt;
+
+  // Evaluate just the right-hand operand of the addition.
+  SimpleExpr *add = (SimpleExpr *) this->expr;
+  Value v = add->expr2->eval( add->expr2, env );
+
+  addAssignValue( env, this->slot, v );
+}
 
-  // Fill in functions to execute or destory this statement.
-  this->execute = executeAssignment;
-  this->destroy = destroyAssignment;
+bool isAddAssignment( int slot, Expr *iexpr, Expr *expr )
+{
+  return !iexpr && expr->kind == AddKind &&
+    ( (SimpleExpr *) expr )->expr1->kind == VariableKind &&
+    ( (VariableExpr *) ( (SimpleExpr *) expr )->expr1 )->slot == slot;
+}
 
-  // Get a copy of the destination variable name, the source
+Stmt *makeAssignment( int slot, Expr *iexpr, Expr *expr )
+{
+  // Allocate the AssignmentStmt representations.
+  AssignmentStmt *this =
+    allocNode( sizeof( AssignmentStmt ) );
+
+  // Fill in the function to execute this statement.  Storing in an
+  // element and adding to a variable get their own execute functions.
+  if ( iexpr )
+    this->execute = executeStoreIndex;
+  else if ( isAddAssignment( slot, iexpr, expr ) )
+    this->execute = executeAddAssignment;
+  else
+    this->execute = executeAssignment;
+  this->kind = AssignmentKind;
+  this->line = nodeLine;
+
+  // Get the slot for the destination variable, the source
   // expression and the sequence index (if it's non-null).
-  strcpy( this->name, name );
+  this->slot = slot;
   this->iexpr = iexpr;
   this->expr = expr;
 
   // Return this object, as an instance of Stmt.
   return (Stmt *) this;
 }
+///////////////////////////////////////////////////////////////////////
+// Loops over a sequence
+
+/** Implementation of eval for indexing a sequence in a guarded loop,
+    where the index is known to be in bounds. */
+static Value evalSequenceIndexInBounds( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value seq = this->expr1->eval( this->expr1, env );
+  Value idx = this->expr2->eval( this->expr2, env );
+  int val = sequenceElement( valueSeq( seq ), valueInt( idx ) );
+  releaseSequence( valueSeq( seq ) );
+  return intValue( val );
+}
+
+bool skipIndexChecks( Expr *expr )
+{
+  if ( expr->kind != IndexKind )
+    return false;
+  expr->eval = evalSequenceIndexInBounds;
+  return true;
+}
+
+/** Put the checks back in an expression and everything in it.
+    @param expr expression to restore.
+*/
+static void restoreExprChecks( Expr *expr )
+{
+  if ( expr->eval == evalSequenceIndexInBounds )
+    expr->eval = evalSequenceIndex;
+
+  if ( expr->kind == SeqInitKind || expr->kind == CallKind ) {
+    SequenceExpr *seq = (SequenceExpr *) expr;
+    for ( int i = 0; i < seq->len; i++ )
+      restoreExprChecks( seq->expList[ i ] );
+  } else if ( expr->kind != LiteralIntKind && expr->kind != SeqLiteralKind &&
+              expr->kind != VariableKind ) {
+    SimpleExpr *this = (SimpleExpr *) expr;
+    restoreExprChecks( this->expr1 );
+    if ( this->expr2 )
+      restoreExprChecks( this->expr2 );
+  }
+}
+
+/** Put the checks back in all the expressions in a statement.
+    @param stmt statement to restore.
+*/
+static void restoreStmtChecks( Stmt *stmt )
+{
+  switch ( stmt->kind ) {
+  case PrintKind:
+  case PushKind: {
+    SimpleStmt *this = (SimpleStmt *) stmt;
+    restoreExprChecks( this->expr1 );
+    if ( this->expr2 )
+      restoreExprChecks( this->expr2 );
+    break;
+  }
+
+  case AssignmentKind: {
+    AssignmentStmt *this = (AssignmentStmt *) stmt;
+    restoreExprChecks( this->expr );
+    if ( this->iexpr )
+      restoreExprChecks( this->iexpr );
+    break;
+  }
+
+  case CompoundKind: {
+    CompoundStmt *this = (CompoundStmt *) stmt;
+    for ( int i = 0; i < this->len; i++ )
+      restoreStmtChecks( this->stmtList[ i ] );
+    break;
+  }
+
+  case IfKind:
+  case WhileKind: {
+    ConditionalStmt *this = (ConditionalStmt *) stmt;
+    restoreExprChecks( this->cond );
+    restoreStmtChecks( this->body );
+    break;
+  }
+  }
+}
+
+/** Implementation of execute for a while loop of the form
+    while ( i < len a ), where i only goes up by one at a time.  The
+    condition shows that i is less than the length of a (which can only
+    grow) every time the body starts, so as long as i starts out
+    non-negative, the body can index a with i without any checks. */
+static void executeWhileGuarded( Stmt *stmt, Environment *env )
+{
+  ConditionalStmt *this = (ConditionalStmt *)stmt;
+
+  // The condition is a comparison, so it's always an int.
+  SimpleExpr *cond = (SimpleExpr *) this->cond;
+  Value start = lookupVariable( env, ( (VariableExpr *) cond->expr1 )->slot );
+  if ( !isInt( start ) || valueInt( start ) < 0 )
+    restoreStmtChecks( this->body );
+
+  while ( valueInt( this->cond->eval( this->cond, env ) ) )
+    this->body->execute( this->body, env );
+}
+
+void guardLoop( Stmt *stmt )
+{
+  stmt->execute = executeWhileGuarded;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Versions without type checks
+
+/** Implementation of eval for addition of operands known to be ints. */
+static Value evalAddUnchecked( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value v1 = this->expr1->eval( this->expr1, env );
+  Value v2 = this->expr2->eval( this->expr2, env );
+  return intValue( valueInt( v1 ) + valueInt( v2 ) );
+}
+
+/** Implementation of eval for subtraction of operands known to be
+    ints. */
+static Value evalSubUnchecked( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value v1 = this->expr1->eval( this->expr1, env );
+  Value v2 = this->expr2->eval( this->expr2, env );
+  return intValue( valueInt( v1 ) - valueInt( v2 ) );
+}
+
+/** Implementation of eval for multiplication of operands known to be
+    ints. */
+static Value evalMulUnchecked( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value v1 = this->expr1->eval( this->expr1, env );
+  Value v2 = this->expr2->eval( this->expr2, env );
+  return intValue( valueInt( v1 ) * valueInt( v2 ) );
+}
+
+/** Implementation of eval for division of operands known to be ints.
+    The divisor still has to be checked. */
+static Value evalDivUnchecked( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value v1 = this->expr1->eval( this->expr1, env );
+  Value v2 = this->expr2->eval( this->expr2, env );
+  if ( valueInt( v2 ) == 0 )
+    return divValues( v1, v2 );
+  return intValue( valueInt( v1 ) / valueInt( v2 ) );
+}
+
+/** Implementation of eval for a less than comparison of operands known
+    to be ints. */
+static Value evalLessUnchecked( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value v1 = this->expr1->eval( this->expr1, env );
+  Value v2 = this->expr2->eval( this->expr2, env );
+  return intValue( valueInt( v1 ) < valueInt( v2 ) );
+}
+
+/** Implementation of eval for an equality test of operands known to be
+    ints. */
+static Value evalEqualsUnchecked( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value v1 = this->expr1->eval( this->expr1, env );
+  Value v2 = this->expr2->eval( this->expr2, env );
+  return intValue( valueInt( v1 ) == valueInt( v2 ) );
+}
+
+/** Implementation of eval for a logical and of operands known to be
+    ints. */
+static Value evalAndUnchecked( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value v1 = this->expr1->eval( this->expr1, env );
+  if ( valueInt( v1 ) == 0 )
+    return v1;
+  return this->expr2->eval( this->expr2, env );
+}
+
+/** Implementation of eval for a logical or of operands known to be
+    ints. */
+static Value evalOrUnchecked( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value v1 = this->expr1->eval( this->expr1, env );
+  if ( valueInt( v1 ) )
+    return v1;
+  return this->expr2->eval( this->expr2, env );
+}
+
+/** Implementation of eval for indexing, when the operands are known to
+    be a sequence and an int.  The index still has to be checked. */
+static Value evalSequenceIndexUnchecked( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value seq = this->expr1->eval( this->expr1, env );
+  Value idx = this->expr2->eval( this->expr2, env );
+  if ( valueInt( idx ) < 0 || valueInt( idx ) >= valueSeq( seq )->len )
+    return indexValue( seq, idx );
+
+  int val = sequenceElement( valueSeq( seq ), valueInt( idx ) );
+  releaseSequence( valueSeq( seq ) );
+  return intValue( val );
+}
+
+/** Implementation of eval for len, when the operand is known to be a
+    sequence. */
+static Value evalLenUnchecked( Expr *expr, Environment *env )
+{
+  SimpleExpr *this = (SimpleExpr *)expr;
+  Value seq = this->expr1->eval( this->expr1, env );
+  int len = valueSeq( seq )->len;
+  releaseSequence( valueSeq( seq ) );
+  return intValue( len );
+}
+
+bool uncheckExpr( Expr *expr )
+{
+  EvalFunction eval;
+  switch ( expr->kind ) {
+  case AddKind:
+    eval = evalAddUnchecked;
+    break;
+  case SubKind:
+    eval = evalSubUnchecked;
+    break;
+  case MulKind:
+    eval = evalMulUnchecked;
+    break;
+  case DivKind:
+    eval = evalDivUnchecked;
+    break;
+  case LessKind:
+    eval = evalLessUnchecked;
+    break;
+  case EqualsKind:
+    eval = evalEqualsUnchecked;
+    break;
+  case AndKind:
+    eval = evalAndUnchecked;
+    break;
+  case OrKind:
+    eval = evalOrUnchecked;
+    break;
+  case IndexKind:
+    // An index known to be in bounds is already checked even less.
+    if ( expr->eval == evalSequenceIndexInBounds )
+      return true;
+    eval = evalSequenceIndexUnchecked;
+    break;
+  case LenKind:
+    eval = evalLenUnchecked;
+    break;
+  default:
+    return false;
+  }
+
+  expr->eval = eval;
+  return true;
+}
+
+/** Implementation of execute for an if statement whose condition is
+    known to be an int. */
+static void executeIfUnchecked( Stmt *stmt, Environment *env )
+{
+  ConditionalStmt *this = (ConditionalStmt *)stmt;
+  if ( valueInt( this->cond->eval( this->cond, env ) ) )
+    this->body->execute( this->body, env );
+}
+
+/** Implementation of execute for a while statement whose condition is
+    known to be an int. */
+static void executeWhileUnchecked( Stmt *stmt, Environment *env )
+{
+  ConditionalStmt *this = (ConditionalStmt *)stmt;
+  while ( valueInt( this->cond->eval( this->cond, env ) ) )
+    this->body->execute( this->body, env );
+}
+
+/** Implementation of execute for a push statement, when its operands
+    are known to be a sequence and an int. */
+static void executePushUnchecked( Stmt *stmt, Environment *env )
+{
+  SimpleStmt *this = (SimpleStmt *) stmt;
+  Value seq = this->expr1->eval( this->expr1, env );
+  Value val = this->expr2->eval( this->expr2, env );
+
+  // Pushing onto a literal needs a copy, which the ops know how to make.
+  if ( valueSeq( seq )->constant ) {
+    pushValue( seq, val );
+    return;
+  }
+
+  pushSequence( valueSeq( seq ), valueInt( val ) );
+  releaseSequence( valueSeq( seq ) );
+}
+
+/** Implementation of execute for an assignment of the form var = var +
+    x, when both the variable and x are known to be ints. */
+static void executeAddAssignmentUnchecked( Stmt *stmt, Environment *env )
+{
+  AssignmentStmt *this = (AssignmentStmt *) stmt;
+  SimpleExpr *add = (SimpleExpr *) this->expr;
+  Value v = add->expr2->eval( add->expr2, env );
+  Value cur = lookupVariable( env, this->slot );
+  setVariable( env, this->slot,
+               intValue( valueInt( cur ) + valueInt( v ) ) );
+}
+
+bool uncheckStmt( Stmt *stmt )
+{
+  switch ( stmt->kind ) {
+  case IfKind:
+    stmt->execute = executeIfUnchecked;
+    return true;
+
+  case WhileKind:
+    // A guarded loop already skips checking its condition.
+    if ( stmt->execute != executeWhileGuarded )
+      stmt->execute = executeWhileUnchecked;
+    return true;
+
+  case PushKind:
+    stmt->execute = executePushUnchecked;
+    return true;
+
+  case AssignmentKind:
+    if ( stmt->execute != executeAddAssignment )
+      return false;
+    stmt->execute = executeAddAssignmentUnchecked;
+    return true;
+
+  default:
+    return false;
+  }
+}
@@ -10,6 +10,20 @@
 #define _SYNTAX_H_
 
 #include "value.h"
+#include "ops.h"
+#include "arena.h"
+
+/** Set the arena that new expressions and statements are allocated
+    from.  Nodes don't have to be freed one at a time; they all go away
+    when the arena is reset, along with any constants they hold.
+    @param arena arena to allocate nodes from.
+*/
+void setSyntaxArena( Arena *arena );
+
+/** Set the source line recorded in new expressions and statements.
+    @param line line number for the nodes made from now on.
+*/
+void setSyntaxLine( int line );
 
 //////////////////////////////////////////////////////////////////////
 // Expr, an interface for an expression in the input program.
@@ -17,11 +31,18 @@
 /** A short name to use for the expression interface. */
 typedef struct ExprStruct Expr;
 
+/** Kinds of expression, so passes like the bytecode compiler can tell
+    what subclass of Expr they're looking at. */
+typedef enum { LiteralIntKind, AddKind, SubKind, MulKind, DivKind,
+               AndKind, OrKind, LessKind, EqualsKind, SeqInitKind,
+               SeqLiteralKind, IndexKind, LenKind, VariableKind,
+               CallKind } ExprKind;
+
 /** Representation for an Expr interface.  Classes implementing this
-    have these two fields as their first members.  They will set eval
+    have these three fields as their first members.  They will set eval
     to point to appropriate functions to evaluate the expression, based on
-    what kind of expression it is.  They will set destroy to
-    point to a function that frees memory for their type of expresson.
+    what kind of expression it is, and kind to say which subclass they
+    are.
 */
 struct ExprStruct {
   /** Pointer to a function to evaluate the given expression and
@@ -32,74 +53,64 @@ struct ExprStruct {
    */
   Value (*eval)( Expr *expr, Environment *env );
 
-  /** Free memory for this expression, including any subexpressions
-      it contains.
-      @param expr expression to free.
-  */
-  void (*destroy)( Expr *expr );
+  /** What kind of expression this is. */
+  ExprKind kind;
+
+  /** Source line the expression is on. */
+  int line;
 };
 
 /** Make a representation of a literal int value, a value that gives
     back a Value containing a particular int whever it is evaluated.
     @param val value this expression evaluates to.
-    @return a new, dynamically allocated expression that evaluates to
-    a Value contianing the given integer.
+    @return a new expression that evaluates to a Value contianing the
+    given integer.
  */
 Expr *makeLiteralInt( int val );
 
 /** Make an expression that adds up the values its two parameter
-    expressions evaluate to.  This new object will take ownership of
-    the memory pointed to by its two sub-expressions, and it will be
-    responsible for freeing that memory when it is destroyed.
+    expressions evaluate to.
     @param left first sub-expression we're adding.
     @param right second sub-expression we're adding.
-    @return pointer to a new, dynamically allocated subclass of Expr.
+    @return pointer to a new subclass of Expr, in the syntax arena.
  */
 Expr *makeAdd( Expr *left, Expr *right );
 
 /** Make an expression that subtracts its second operand from the
-    first. This new object will take ownership of the memory pointed
-    to by its two sub-expressions, freeing them when it is destroyed.
+    first.
     @param left first sub-expression we're subtracting
     @param right second sub-expression we're subtracting
-    @return pointer to a new, dynamically allocated subclass of Expr.
+    @return pointer to a new subclass of Expr, in the syntax arena.
  */
 Expr *makeSub( Expr *left, Expr *right );
 
-/** Make an expression that multiplies its two operands. This new
-    object will take ownership of the memory pointed to by its two
-    sub-expressions, freeing them when it is destroyed.
+/** Make an expression that multiplies its two operands.
     @param left first sub-expression we're multiplying
     @param right second sub-expression we're multiplying
-    @return pointer to a new, dynamically allocated subclass of Expr.
+    @return pointer to a new subclass of Expr, in the syntax arena.
  */
 Expr *makeMul( Expr *left, Expr *right );
 
 /** Make an expression that divides its first operand by the
-    second. This new object will take ownership of the memory pointed
-    to by its two sub-expressions, freeing them when it is destroyed.
+    second.
     @param left first sub-expression we're dividing
     @param right second sub-expression we're dividing
-    @return pointer to a new, dynamically allocated subclass of Expr.
+    @return pointer to a new subclass of Expr, in the syntax arena.
  */
 Expr *makeDiv( Expr *left, Expr *right );
 
-/** Make an expression that compares its two operands. This new object
-    will take ownership of the memory pointed to by its two
-    sub-expressions, freeing them when it is destroyed.
+/** Make an expression that compares its two operands.
     @param left first sub-expression we're dividing
     @param right second sub-expression we're dividing
-    @return pointer to a new, dynamically allocated subclass of Expr.
+    @return pointer to a new subclass of Expr, in the syntax arena.
  */
 Expr *makeEquals( Expr *left, Expr *right );
 
 /** Make an expression that compares its two operands as integers.  It
-    returns true if the first one is less than the second.  This new
-    object will take ownership of the memory pointed to by its two
-    sub-expressions, freeing them when it is destroyed.
+    returns true if the first one is less than the second.
     @param left first sub-expression we're dividing
     @param right second sub-expression we're dividing
-    @return pointer to a new, dynamically allocated subclass of Expr.
+    @return pointer to a new subclass of Expr, in the syntax arena.
  */
 Expr *makeLess( Expr *left, Expr *right );
 
@@ -107,7 +118,7 @@ Expr *makeLess( Expr *left, Expr *right );
     sub-expressions evaluate to true.
     @param left left-hand operand for the and.
     @param right right-hand operand for the and.
-    @return pointer to a new, dynamically allocated subclass of Expr.
+    @return pointer to a new subclass of Expr, in the syntax arena.
  */
 Expr *makeAnd( Expr *left, Expr *right );
 
@@ -115,37 +126,56 @@ Expr *makeAnd( Expr *left, Expr *right );
     sub-expressions evaluate to true.
     @param left left-hand operand for the or.
     @param right right-hand operand for the or.
-    @return pointer to a new, dynamically allocated subclass of Expr.
+    @return pointer to a new subclass of Expr, in the syntax arena.
  */
 Expr *makeOr( Expr *left, Expr *right );
 
 /** Make an expression that evaluates to a copy of the value of the
-    variable with the given name.  The variable's value will depend on
+    variable in the given slot.  The variable's value will depend on
     the Environment.
-    @param name Name of the variable 
-    @return pointer to a new, dynamically allocated subclass of Expr.
+    @param slot Slot for the variable, from variableSlot().
+    @return pointer to a new subclass of Expr, in the syntax arena.
  */
-Expr *makeVariable( char const *name );
+Expr *makeVariable( int slot );
 
 
 /** Make an expression that evaluates to a Sequence of of the values from the given
     expression list.
     @param len length of elist
-    @param elist list of expression in the Sequence
-    @return pointer to a new, dynamically allocated subclass of Expr.
+    @param elist list of expression in the Sequence.  This is copied, so
+    the caller still owns it.
+    @return pointer to a new subclass of Expr, in the syntax arena.
 */
 Expr *makeSeqInit(int len, Expr **elist);
 
+/** Make an expression for a sequence literal whose elements are all
+    known when it's parsed (like a string literal).  The sequence is
+    built once, as an immutable constant shared by every evaluation.
+    @param len number of elements.
+    @param vals values of the elements.
+    @return pointer to a new subclass of Expr, in the syntax arena.
+*/
+Expr *makeSeqLiteral( int len, int const *vals );
+
+/** Make an expression that calls a built-in function.
+    @param fn function to call.
+    @param len number of arguments, builtinArgCount( fn ).
+    @param args expressions for the arguments.  This is copied, so
+    the caller still owns it.
+    @return pointer to a new subclass of Expr, in the syntax arena.
+*/
+Expr *makeCall( Builtin fn, int len, Expr **args );
+
 /** Make an expression that evaluates to a value in a Sequence at a given index.
     @param aexp the sequence to be indexed
     @param iexp the index to get the value from
-    @return pointer to a new, dynamically allocated subclass of Expr.
+    @return pointer to a new subclass of Expr, in the syntax arena.
 */
 Expr *makeSequenceIndex(Expr *aexp, Expr *iexp);
 
 /** Make an expression that evaluates to the length of a given Sequence.
     @param expr the Sequence to be evaluated
-    @return pointer to a new, dynamically allocated subclass of Expr.
+    @return pointer to a new subclass of Expr, in the syntax arena.
 */
 Expr *makeLen(Expr *expr);
 //////////////////////////////////////////////////////////////////////
@@ -154,12 +184,17 @@ Expr *makeLen(Expr *expr);
 /** A short name to use for the statement interface. */
 typedef struct StmtStruct Stmt;
 
+/** Kinds of statement, so passes like the bytecode compiler can tell
+    what subclass of Stmt they're looking at. */
+typedef enum { PrintKind, CompoundKind, IfKind, WhileKind, PushKind,
+               AssignmentKind } StmtKind;
+
 /** Representation for the Stmt interface, a superclass for all types
-    of statements.  Classes implementing this have these two fields as
+    of statements.  Classes implementing this have these three fields as
     their first members.  They will set execute to point to an
     appropriate functions to execute the type of statement their
-    class represents, and they will set destroy to point to a function
-    that frees memory for their type of statement.
+    class represents, and they will set kind to say which subclass
+    they are.
 */
 struct StmtStruct {
   /** Pointer to a function to execute the given staement.
@@ -168,11 +203,11 @@ struct StmtStruct {
    */
   void (*execute)( Stmt *stmt, Environment *env );
 
-  /** Free memory for this statement, including any other statements and
-      expressions it contains.
-      @param stmt statement to free.
-  */
-  void (*destroy)( Stmt *stmt );
+  /** What kind of statement this is. */
+  StmtKind kind;
+
+  /** Source line the statement starts on. */
+  int line;
 };
 
 /** Make a statement that evaluates the given argument and prints it
@@ -184,29 +219,21 @@ Stmt *makePrint( Expr *arg );
 
 /** Make a compound statement, representing the sequence of statements
     @param len number of statements in stmtList.
-    @param stmtList list of statements making up this compound. The
-    compound statement will take ownership of this list of statements
-    and will be responsible for freeing all these statements when it
-    is destroyed.
+    @param stmtList list of statements making up this compound.  This
+    is copied, so the caller still owns the list.
     @return a new statement that executes all the statements in
     stmtList, in order.
  */
 Stmt *makeCompound( int len, Stmt **stmtList );
 
-/** Make a representation of an if statement.  This new object
-    will take ownership of the memory pointed to by cond and body
-    and will be responsible for freeing that memory when it is
-    destroyed.
+/** Make a representation of an if statement.
     @param cond Expression for the condition on this if statement.
     @param body Statement in the body of this if.
     @return A new statement object that can perform the if statement.
  */
 Stmt *makeIf( Expr *cond, Stmt *body );
 
-/** Make a representation of a while statement.  This new object
-    will take ownership of the memory pointed to by cond and body
-    and will be responsible for freeing that memory when it is
-    destroyed.
+/** Make a representation of a while statement.
     @param cond Expression for the condition on this if statement.
     @param body Statement in the body of this while.
     @return A new statement object that can perform the while statement.
@@ -223,12 +250,204 @@ Stmt *makePush(Expr *s, Expr *v);
 /** Make a representation of an assignment statement.  It is intended to
     work for assigning to a variable (if idx is null), or changing just
     one element in an array (if idx is non-null).
-    @param vname Name of the variable we're assigning to.
+    @param slot Slot for the variable we're assigning to.
     @param iexpr If this is an assignment to an array element, this is the
     index for the target element, or null if not.
     @param expr Expression on the right-hand side of the assignemnt.
     @return A new statement object that can perform the assignment.
  */
-Stmt *makeAssignment( char const *name, Expr *iexpr, Expr *expr );
+Stmt *makeAssignment( int slot, Expr *iexpr, Expr *expr );
+
+/** Return true if the given parts of an assignment have the form
+    var = var + x.  These assignments can append to the variable's
+    sequence in place, if it's not shared.
+    @param slot Slot for the variable we're assigning to.
+    @param iexpr Index expression, or null.
+    @param expr Expression on the right-hand side of the assignemnt.
+    @return true if this is an assignment that adds to the variable.
+ */
+bool isAddAssignment( int slot, Expr *iexpr, Expr *expr );
+
+/** Switch an expression to a version that doesn't check the types of
+    its operands at run time.  This is for passes that have proved what
+    those types will be: ints for arithmetic, comparisons, and and or,
+    a sequence and an int for indexing, and a sequence for len.  Other
+    checks, like for division by zero or an index out of bounds, are
+    still done.
+    @param expr expression whose operands are known to have those types.
+    @return true if expr has a version without type checks.
+*/
+bool uncheckExpr( Expr *expr );
+
+/** Switch a statement to a version that doesn't check types at run
+    time, like uncheckExpr().  The condition of an if or while must be
+    known to be an int, the operands of a push a sequence and an int,
+    and both sides of an assignment of the form var = var + x ints.
+    @param stmt statement whose operands are known to have those types.
+    @return true if stmt has a version without type checks.
+*/
+bool uncheckStmt( Stmt *stmt );
+
+/** Switch an expression indexing a sequence to a version that doesn't
+    check the types or the index at all.  This is for loops guarded by
+    guardLoop(), where a pass has proved the index is always less than
+    the length of the sequence.
+    @param expr index expression in the body of a guarded loop.
+    @return true if expr is an index expression.
+*/
+bool skipIndexChecks( Expr *expr );
+
+/** Guard a while loop with a condition of the form i < len a, where
+    the body only ever adds one to i.  Each time the loop starts, it
+    makes sure i is a non-negative int.  If it's not, the checks skipped
+    by skipIndexChecks() in the loop's body are put back, for good.
+    @param stmt while loop to guard.
+*/
+void guardLoop( Stmt *stmt );
+
+//////////////////////////////////////////////////////////////////////
+// Concrete representations.  These are only needed by code that has to
+// look inside the tree (like the bytecode compiler); everything else
+// should go through the Expr and Stmt interfaces.
+
+/** Representation for a LiteralInt expression, a subclass of Expr that
+    evaluates to a constant value. */
+typedef struct {
+  Value (*eval)( Expr *expr, Environment *env );
+  ExprKind kind;
+  int line;
+
+  /** Integer value this expression evaluates to. */
+  int val;
+} LiteralInt;
+
+/** Representation for an expression with either one or two
+    sub-expressionts.  With the right eval funciton, this struct should
+    be able to help implement any expression with either one or two
+    sub-expressiosn. */
+typedef struct {
+  Value (*eval)( Expr *expr, Environment *env );
+  ExprKind kind;
+  int line;
+
+  /** The first sub-expression */
+  Expr *expr1;
+  
+  /** The second sub-expression, or NULL if it's not needed. */
+  Expr *expr2;
+} SimpleExpr;
+
+/** Representation for a SequenceExpr expression, a subclass of Expr that
+    evaluates to a Sequence value. */
+typedef struct {
+  Value (*eval)(Expr *expr, Environment *env);
+  ExprKind kind;
+  int line;
+  
+  /** Expressions for the elements of the sequence. */
+  Expr **expList;
+
+  /** Number of elements in expList. */
+  int len;
+} SequenceExpr;
+
+/** Representation for a call to a built-in function, a subclass of
+    Expr.  It starts like a SequenceExpr, so passes can walk its
+    arguments the same way. */
+typedef struct {
+  Value (*eval)(Expr *expr, Environment *env);
+  ExprKind kind;
+  int line;
+
+  /** Expressions for the arguments. */
+  Expr **expList;
+
+  /** Number of arguments in expList. */
+  int len;
+
+  /** Function to call. */
+  Builtin fn;
+} CallExpr;
+
+/** Representation for a sequence literal, a subclass of Expr that
+    evaluates to a shared constant sequence. */
+typedef struct {
+  Value (*eval)( Expr *expr, Environment *env );
+  ExprKind kind;
+  int line;
+
+  /** Constant this expression evaluates to. */
+  Sequence *seq;
+} SeqLiteral;
+
+/** Representation for an expression representing an occurrence of a
+    variable, subclass of Expr. */
+typedef struct {
+  Value (*eval)( Expr *expr, Environment *env );
+  ExprKind kind;
+  int line;
+
+  /** Slot for the variable, resolved when it was parsed. */
+  int slot;
+} VariableExpr;
+
+/** Generic representation for a statement that contains one or two
+    expressions.  With different execute methods, this same struct
+    can be used to represent print and push statements. */
+typedef struct {
+  void (*execute)( Stmt *stmt, Environment *env );
+  StmtKind kind;
+  int line;
+
+  /** First (or only) expression used by this statement. */
+  Expr *expr1;
+  /** Second expression used by this statement, or null */
+  Expr *expr2;
+} SimpleStmt;
+
+/** Representation for a compound statement, derived from Stmt. */
+typedef struct {
+  void (*execute)( Stmt *stmt, Environment *env );
+  StmtKind kind;
+  int line;
+
+  /** Number of statements in the compound. */
+  int len;
+  
+  /** List of statements in the compound. */
+  Stmt **stmtList;
+} CompoundStmt;
+
+/** Representation for either a while or if statement, subclass of Stmt. */
+typedef struct {
+  void (*execute)( Stmt *stmt, Environment *env );
+  StmtKind kind;
+  int line;
+
+  // Condition to be checked before running the body.
+  Expr *cond;
+
+  // Body to execute if / while cond is true.
+  Stmt *body;
+} ConditionalStmt;
+
+/** Representation of an assignment statement, a subclass of
+    Stmt. This representation should be suitable for assigning to a
+    variable or an element of a sequence.  */
+typedef struct {
+  void (*execute)( Stmt *stmt, Environment *env );
+  StmtKind kind;
+  int line;
+
+  /** Slot for the variable we're assigning to. */
+  int slot;
+  
+  /** If we're assigning to an element of a sequence, this is the index
+      expression. Otherwise, it's zero. */
+  Expr *iexpr;
+
+  /** Expression for the right-hand side of the assignment (the source). */
+  Expr *expr;
+} AssignmentStmt;
 
 #endif
@@ -96,11 +96,11 @@ testInterpreter() {
   TESTNO=$1
   ESTATUS=$2
 
-  echo "Test $TESTNO"
+  echo "Test $TESTNO $FLAGS"
   rm -f output.txt stderr.txt
 
-  echo "   ./interpret prog-$TESTNO.txt > output.txt 2> stderr.txt"
-  ./interpret prog-$TESTNO.txt > output.txt 2> stderr.txt
+  echo "   ./interpret $FLAGS prog-$TESTNO.txt > output.txt 2> stderr.txt"
+  ./interpret $FLAGS prog-$TESTNO.txt > output.txt 2> stderr.txt
   ASTATUS=$?
 
   if ! checkStatus "$ESTATUS" "$ASTATUS" ||
@@ -115,31 +115,100 @@ testInterpreter() {
   return 0
 }
 
+# Test one program translated to C with --emit-c, built against the
+# runtime library and run on its own.
+testTranslated() {
+  TESTNO=$1
+  ESTATUS=$2
+
+  echo "Test $TESTNO translated to C"
+  rm -f output.txt stderr.txt prog-$TESTNO prog-$TESTNO.c
+
+  echo "   ./interpret --emit-c prog-$TESTNO.txt > prog-$TESTNO.c"
+  ./interpret --emit-c prog-$TESTNO.txt > prog-$TESTNO.c
+  gcc -O2 -std=c99 -I. prog-$TESTNO.c libp6.a -o prog-$TESTNO
+  if [ ! -x prog-$TESTNO ]; then
+      fail "FAILED - translated prog-$TESTNO.c didn't compile"
+      return 1
+  fi
+
+  echo "   ./prog-$TESTNO > output.txt 2> stderr.txt"
+  ./prog-$TESTNO > output.txt 2> stderr.txt
+  ASTATUS=$?
+  rm -f prog-$TESTNO prog-$TESTNO.c
+
+  if ! checkStatus "$ESTATUS" "$ASTATUS" ||
+     ! checkFile "Stdout output" "expected-$TESTNO.txt" "output.txt" ||
+     ! checkFileOrEmpty "Stderr output" "message-$TESTNO.txt" "stderr.txt"
+  then
+      FAIL=1
+      return 1
+  fi
+
+  echo "Test $TESTNO PASS"
+  return 0
+}
+
+# Run all the test inputs, passing the given options to the interpreter,
+# or with the given test function instead of testInterpreter.
+testAll() {
+  FLAGS="$1"
+  RUNTEST="${2:-testInterpreter}"
+
+  $RUNTEST 01 0
+  $RUNTEST 02 0
+  $RUNTEST 03 0
+  $RUNTEST 04 0
+  $RUNTEST 05 0
+  $RUNTEST 06 0
+  $RUNTEST 07 0
+  $RUNTEST 08 0
+  $RUNTEST 09 0
+  $RUNTEST 10 0
+  $RUNTEST 11 0
+  $RUNTEST 12 0
+  $RUNTEST 13 0
+  $RUNTEST 14 0
+  $RUNTEST 15 0
+  $RUNTEST 16 1
+  $RUNTEST 17 1
+  $RUNTEST 18 1
+  $RUNTEST 19 1
+  $RUNTEST 20 0
+  $RUNTEST 21 0
+  $RUNTEST 22 0
+  $RUNTEST 23 1
+  $RUNTEST 24 0
+  $RUNTEST 25 0
+  $RUNTEST 26 0
+  $RUNTEST 27 1
+  $RUNTEST 28 0
+  $RUNTEST ec-1 0
+  $RUNTEST ec-2 0
+}
+
 # Get a clean build of the project.
 make clean
 make
+make libp6.a
 
-# Run against the test inputs.
+# Run against the test inputs, on the bytecode VM and on the tree-walker,
+# with and without optimization, with hot loops compiled to native code,
+# and with the whole program cached.
 if [ -x interpret ]; then
-    testInterpreter 01 0
-    testInterpreter 02 0
-    testInterpreter 03 0
-    testInterpreter 04 0
-    testInterpreter 05 0
-    testInterpreter 06 0
-    testInterpreter 07 0
-    testInterpreter 08 0
-    testInterpreter 09 0
-    testInterpreter 10 0
-    testInterpreter 11 0
-    testInterpreter 12 0
-    testInterpreter 13 0
-    testInterpreter 14 0
-    testInterpreter 15 0
-    testInterpreter 16 1
-    testInterpreter 17 1
-    testInterpreter 18 1
-    testInterpreter 19 1
+    testAll ""
+    testAll "--tree"
+    testAll "--jit"
+    testAll "-O0"
+
+    # Run from the compiled cache, once to write it and once to read it.
+    rm -f prog-*.txt.p6c
+    testAll "--cache"
+    testAll "--cache"
+    rm -f prog-*.txt.p6c
+
+    # Translate to C, then build and run that.
+    testAll "" testTranslated
 else
     fail "Since your program didn't compile, we couldn't test it"
 fi
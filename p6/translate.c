@@ -0,0 +1,788 @@
+/**
+  @file translate.c
+  @author Adrian Chan (amchan)
+  Ahead-of-time translation of a program to C.
+*/
+
+#include "translate.h"
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+
+/** Initial capacity for the resizable arrays */
+#define INITIAL_CAPACITY 64
+
+/** Double the capacity of an array */
+#define DOUBLE_CAPACITY 2
+
+/** Number of elements written on each line of a constant's list. */
+#define ELEMENTS_PER_LINE 12
+
+/** Helpers at the start of every translated program.  They're small
+    enough for the C compiler to inline, and the ones that can fail
+    leave reporting the error to the ops, so the messages match the
+    interpreter's. */
+static char const *prelude =
+  "/** Get a new reference to a variable's value. */\n"
+  "static inline Value loadValue( Value v )\n"
+  "{\n"
+  "  if ( isSeq( v ) )\n"
+  "    grabSequence( valueSeq( v ) );\n"
+  "  return v;\n"
+  "}\n"
+  "\n"
+  "/** Get a new reference to a literal's constant. */\n"
+  "static inline Value constValue( Sequence *seq )\n"
+  "{\n"
+  "  grabSequence( seq );\n"
+  "  return seqValue( seq );\n"
+  "}\n"
+  "\n"
+  "/** Release a value, if it's a sequence. */\n"
+  "static inline void releaseValue( Value v )\n"
+  "{\n"
+  "  if ( isSeq( v ) )\n"
+  "    releaseSequence( valueSeq( v ) );\n"
+  "}\n"
+  "\n"
+  "/** Get an int from a value, exiting if it's a sequence. */\n"
+  "static inline int toInt( Value v )\n"
+  "{\n"
+  "  requireIntType( &v );\n"
+  "  return valueInt( v );\n"
+  "}\n"
+  "\n"
+  "/** Assign a value to a variable, taking over the reference. */\n"
+  "static inline void assignValue( Value *var, Value v )\n"
+  "{\n"
+  "  storeValue( var, v );\n"
+  "  releaseValue( v );\n"
+  "}\n"
+  "\n"
+  "/** Int arithmetic, wrapping around like the interpreter. */\n"
+  "static inline int addInts( int a, int b )\n"
+  "{\n"
+  "  return (int) ( (unsigned int) a + (unsigned int) b );\n"
+  "}\n"
+  "\n"
+  "static inline int subInts( int a, int b )\n"
+  "{\n"
+  "  return (int) ( (unsigned int) a - (unsigned int) b );\n"
+  "}\n"
+  "\n"
+  "static inline int mulInts( int a, int b )\n"
+  "{\n"
+  "  return (int) ( (unsigned int) a * (unsigned int) b );\n"
+  "}\n"
+  "\n"
+  "static inline int divInts( int a, int b )\n"
+  "{\n"
+  "  if ( b == 0 )\n"
+  "    divValues( intValue( a ), intValue( b ) );\n"
+  "  return a / b;\n"
+  "}\n"
+  "\n"
+  "/** Get an element of the sequence in a variable. */\n"
+  "static inline int indexVariable( Value seq, int idx )\n"
+  "{\n"
+  "  if ( isSeq( seq ) && idx >= 0 && idx < valueSeq( seq )->len )\n"
+  "    return sequenceElement( valueSeq( seq ), idx );\n"
+  "  return valueInt( indexValue( loadValue( seq ), intValue( idx ) ) );\n"
+  "}\n"
+  "\n"
+  "/** Get the length of the sequence in a variable. */\n"
+  "static inline int lenVariable( Value seq )\n"
+  "{\n"
+  "  return valueInt( lenValue( loadValue( seq ) ) );\n"
+  "}\n"
+  "\n"
+  "/** Store an int in an element of the sequence in a variable. */\n"
+  "static inline void storeInt( Value seq, int idx, int val )\n"
+  "{\n"
+  "  if ( isSeq( seq ) && idx >= 0 && idx < valueSeq( seq )->len )\n"
+  "    storeSequence( valueSeq( seq ), idx, val );\n"
+  "  else\n"
+  "    storeIndexValue( seq, intValue( idx ), intValue( val ) );\n"
+  "}\n";
+
+/** State of a translation. */
+typedef struct {
+  /** Statements of the translated main function, so far. */
+  char *code;
+
+  /** Number of characters in code. */
+  int len;
+
+  /** Capacity of code. */
+  int cap;
+
+  /** Indentation level for the next line of code. */
+  int indent;
+
+  /** Number of temporaries used so far, to give each a new name. */
+  int temps;
+
+  /** For each variable slot, true if the variable might hold a
+      sequence.  The others are C int locals. */
+  bool *seqVars;
+
+  /** Constants for the sequence literals in the program. */
+  Sequence **consts;
+
+  /** Number of constants in the list. */
+  int constCount;
+
+  /** Capacity of the list of constants. */
+  int constCap;
+} Translator;
+
+/** Make a string from a format, like sprintf().
+    @param fmt format for the string.
+    @param ... values for the format.
+    @return new, dynamically allocated string.
+*/
+static char *format( char const *fmt, ... )
+{
+  va_list args;
+  va_start( args, fmt );
+  int len = vsnprintf( NULL, 0, fmt, args );
+  va_end( args );
+
+  char *str = (char *) malloc( len + 1 );
+  va_start( args, fmt );
+  vsnprintf( str, len + 1, fmt, args );
+  va_end( args );
+  return str;
+}
+
+/** Add text to the end of the code.
+    @param t translation to add to.
+    @param text text to add.
+*/
+static void append( Translator *t, char const *text )
+{
+  int len = strlen( text );
+  if ( t->len + len + 1 > t->cap ) {
+    t->cap = t->cap * DOUBLE_CAPACITY + len + 1;
+    t->code = (char *) realloc( t->code, t->cap );
+  }
+  memcpy( t->code + t->len, text, len + 1 );
+  t->len += len;
+}
+
+/** Add an indented line of code.
+    @param t translation to add to.
+    @param fmt format for the line, without the newline.
+    @param ... values for the format.
+*/
+static void line( Translator *t, char const *fmt, ... )
+{
+  for ( int i = 0; i < t->indent; i++ )
+    append( t, "  " );
+
+  va_list args;
+  va_start( args, fmt );
+  int len = vsnprintf( NULL, 0, fmt, args );
+  va_end( args );
+
+  char text[ len + 2 ];
+  va_start( args, fmt );
+  vsnprintf( text, len + 1, fmt, args );
+  va_end( args );
+  strcpy( text + len, "\n" );
+  append( t, text );
+}
+
+/** Make a name for a new temporary.
+    @param t translation it's for.
+    @return the name, dynamically allocated.
+*/
+static char *newTemp( Translator *t )
+{
+  return format( "t%d", t->temps++ );
+}
+
+/** Return the index of a literal's constant, adding it to the list if
+    it's not there yet.
+    @param t translation the literal is in.
+    @param seq the literal's constant.
+    @return index of the constant.
+*/
+static int constIndex( Translator *t, Sequence *seq )
+{
+  for ( int i = 0; i < t->constCount; i++ )
+    if ( t->consts[ i ] == seq )
+      return i;
+
+  if ( t->constCount >= t->constCap ) {
+    t->constCap = t->constCap ? t->constCap * DOUBLE_CAPACITY :
+      INITIAL_CAPACITY;
+    t->consts = (Sequence **) realloc( t->consts,
+                                       t->constCap * sizeof( Sequence * ) );
+  }
+  t->consts[ t->constCount ] = seq;
+  return t->constCount++;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Types
+
+/** Return true if an expression always gives an int (or an error).
+    @param t translation the expression is in.
+    @param expr expression to check.
+    @return true if expr can't give a sequence.
+*/
+static bool isIntExpr( Translator *t, Expr *expr )
+{
+  switch ( expr->kind ) {
+  case SeqLiteralKind:
+  case SeqInitKind:
+    return false;
+
+  case VariableKind:
+    return !t->seqVars[ ( (VariableExpr *) expr )->slot ];
+
+  case AddKind:
+  case MulKind:
+    // These give a sequence if either operand is one.
+    return isIntExpr( t, ( (SimpleExpr *) expr )->expr1 ) &&
+      isIntExpr( t, ( (SimpleExpr *) expr )->expr2 );
+
+  case CallKind:
+    return builtinGivesInt( ( (CallExpr *) expr )->fn );
+
+  default:
+    return true;
+  }
+}
+
+/** Find the variables that might be assigned a sequence in a statement.
+    @param t translation with the variables found so far.
+    @param stmt statement to look at.
+    @return true if any new ones were found.
+*/
+static bool findSeqVars( Translator *t, Stmt *stmt )
+{
+  bool changed = false;
+  switch ( stmt->kind ) {
+  case AssignmentKind: {
+    // Storing in an element doesn't change what the variable holds.
+    AssignmentStmt *this = (AssignmentStmt *) stmt;
+    if ( !this->iexpr && !t->seqVars[ this->slot ] &&
+         !isIntExpr( t, this->expr ) )
+      changed = t->seqVars[ this->slot ] = true;
+    break;
+  }
+
+  case CompoundKind: {
+    CompoundStmt *this = (CompoundStmt *) stmt;
+    for ( int i = 0; i < this->len; i++ )
+      changed = findSeqVars( t, this->stmtList[ i ] ) || changed;
+    break;
+  }
+
+  case IfKind:
+  case WhileKind:
+    changed = findSeqVars( t, ( (ConditionalStmt *) stmt )->body );
+    break;
+
+  default:
+    break;
+  }
+  return changed;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Expressions
+
+// Translating an expression adds statements for the parts that have to
+// happen in order, like calls that might report an error, and returns a
+// C expression for the rest.  The C expression can't fail or change
+// anything that matters, so it can be used after statements for other
+// expressions that should come later.
+
+static char *valueExpr( Translator *t, Expr *expr );
+
+/** Translate a call to a built-in function.
+    @param t translation to add to.
+    @param call call to translate.
+    @return name of a temporary holding the function's result,
+    dynamically allocated.
+*/
+static char *callExpr( Translator *t, CallExpr *call )
+{
+  static char const *fnNames[ BuiltinCount ] = {
+    [ SliceBuiltin ] = "SliceBuiltin", [ SumBuiltin ] = "SumBuiltin",
+    [ MinBuiltin ] = "MinBuiltin", [ MaxBuiltin ] = "MaxBuiltin",
+    [ FindBuiltin ] = "FindBuiltin", [ CountBuiltin ] = "CountBuiltin",
+    [ SortBuiltin ] = "SortBuiltin", [ ReverseBuiltin ] = "ReverseBuiltin",
+    [ FillBuiltin ] = "FillBuiltin"
+  };
+
+  char *args[ MAX_BUILTIN_ARGS ];
+  for ( int i = 0; i < call->len; i++ )
+    args[ i ] = valueExpr( t, call->expList[ i ] );
+
+  char *temp = newTemp( t );
+  line( t, "Value %s = callBuiltin( %s, (Value const[]){", temp,
+        fnNames[ call->fn ] );
+  t->indent++;
+  for ( int i = 0; i < call->len; i++ ) {
+    line( t, "%s%s", args[ i ], i + 1 < call->len ? "," : "" );
+    free( args[ i ] );
+  }
+  t->indent--;
+  line( t, "} );" );
+  return temp;
+}
+
+/** Translate an expression that's needed as an int.  If it gives a
+    sequence, the translated code reports a type mismatch.
+    @param t translation to add to.
+    @param expr expression to translate.
+    @return C expression for the int, dynamically allocated.
+*/
+static char *intExpr( Translator *t, Expr *expr )
+{
+  char *temp = NULL;
+  switch ( expr->kind ) {
+  case LiteralIntKind: {
+    // The most negative int can't be written as a literal in C.
+    int val = ( (LiteralInt *) expr )->val;
+    return val == INT_MIN ? format( "( %d - 1 )", val + 1 ) :
+      format( "%d", val );
+  }
+
+  case VariableKind: {
+    int slot = ( (VariableExpr *) expr )->slot;
+    if ( !t->seqVars[ slot ] )
+      return format( "v%d", slot );
+    temp = newTemp( t );
+    line( t, "int %s = toInt( v%d );", temp, slot );
+    return temp;
+  }
+
+  case AndKind:
+  case OrKind: {
+    // The right operand is only evaluated if the left one doesn't
+    // decide the result.
+    SimpleExpr *this = (SimpleExpr *) expr;
+    char *left = intExpr( t, this->expr1 );
+    temp = newTemp( t );
+    line( t, "int %s = %s;", temp, left );
+    free( left );
+
+    int mark = t->len;
+    t->indent++;
+    char *right = intExpr( t, this->expr2 );
+    t->indent--;
+
+    if ( t->len == mark ) {
+      char *result = expr->kind == AndKind ?
+        format( "( %s ? %s : 0 )", temp, right ) :
+        format( "( %s ? %s : %s )", temp, temp, right );
+      free( temp );
+      free( right );
+      return result;
+    }
+
+    // Move the right operand's statements into a block that only runs
+    // when they're needed.
+    char *stmts = format( "%s", t->code + mark );
+    t->len = mark;
+    t->code[ mark ] = '\0';
+    line( t, expr->kind == AndKind ? "if ( %s ) {" : "if ( !%s ) {", temp );
+    append( t, stmts );
+    t->indent++;
+    line( t, "%s = %s;", temp, right );
+    t->indent--;
+    line( t, "}" );
+    free( stmts );
+    free( right );
+    return temp;
+  }
+
+  case IndexKind:
+  case LenKind: {
+    SimpleExpr *this = (SimpleExpr *) expr;
+    char *seq;
+    bool variable = this->expr1->kind == VariableKind;
+    if ( variable ) {
+      // A variable's sequence can be used without a new reference.
+      int slot = ( (VariableExpr *) this->expr1 )->slot;
+      seq = t->seqVars[ slot ] ? format( "v%d", slot ) :
+        format( "intValue( v%d )", slot );
+    } else
+      seq = valueExpr( t, this->expr1 );
+
+    temp = newTemp( t );
+    if ( expr->kind == LenKind ) {
+      line( t, variable ? "int %s = lenVariable( %s );" :
+            "int %s = valueInt( lenValue( %s ) );", temp, seq );
+    } else {
+      bool intIdx = variable && isIntExpr( t, this->expr2 );
+      char *idx = intIdx ? intExpr( t, this->expr2 ) :
+        valueExpr( t, this->expr2 );
+      if ( intIdx )
+        line( t, "int %s = indexVariable( %s, %s );", temp, seq, idx );
+      else if ( variable )
+        line( t, "int %s = valueInt( indexValue( loadValue( %s ), %s ) );",
+              temp, seq, idx );
+      else
+        line( t, "int %s = valueInt( indexValue( %s, %s ) );", temp, seq,
+              idx );
+      free( idx );
+    }
+    free( seq );
+    return temp;
+  }
+
+  case CallKind: {
+    if ( !builtinGivesInt( ( (CallExpr *) expr )->fn ) )
+      break;
+    char *val = callExpr( t, (CallExpr *) expr );
+    temp = newTemp( t );
+    line( t, "int %s = valueInt( %s );", temp, val );
+    free( val );
+    return temp;
+  }
+
+  default:
+    break;
+  }
+
+  // Anything that might be a sequence is computed as a value, then
+  // checked.
+  if ( !isIntExpr( t, expr ) ) {
+    char *val = valueExpr( t, expr );
+    temp = newTemp( t );
+    line( t, "int %s = toInt( %s );", temp, val );
+    free( val );
+    return temp;
+  }
+
+  SimpleExpr *this = (SimpleExpr *) expr;
+  static char const *opNames[] = {
+    [ AddKind ] = "add", [ SubKind ] = "sub", [ MulKind ] = "mul",
+    [ DivKind ] = "div", [ LessKind ] = "less", [ EqualsKind ] = "equals"
+  };
+
+  // With an operand that might be a sequence, the ops check the types.
+  if ( !isIntExpr( t, this->expr1 ) || !isIntExpr( t, this->expr2 ) ) {
+    char *left = valueExpr( t, this->expr1 );
+    char *right = valueExpr( t, this->expr2 );
+    temp = newTemp( t );
+    line( t, "int %s = valueInt( %sValues( %s, %s ) );", temp,
+          opNames[ expr->kind ], left, right );
+    free( left );
+    free( right );
+    return temp;
+  }
+
+  char *left = intExpr( t, this->expr1 );
+  char *right = intExpr( t, this->expr2 );
+  char *result;
+  switch ( expr->kind ) {
+  case DivKind:
+    // Division can fail, so it happens right here.
+    result = newTemp( t );
+    line( t, "int %s = divInts( %s, %s );", result, left, right );
+    break;
+
+  case LessKind:
+    result = format( "( %s < %s )", left, right );
+    break;
+
+  case EqualsKind:
+    result = format( "( %s == %s )", left, right );
+    break;
+
+  default:
+    result = format( "%sInts( %s, %s )", opNames[ expr->kind ], left, right );
+    break;
+  }
+  free( left );
+  free( right );
+  return result;
+}
+
+/** Translate an expression that's needed as a value.
+    @param t translation to add to.
+    @param expr expression to translate.
+    @return C expression for the value, holding its own reference if it's
+    a sequence, dynamically allocated.
+*/
+static char *valueExpr( Translator *t, Expr *expr )
+{
+  if ( isIntExpr( t, expr ) ) {
+    char *val = intExpr( t, expr );
+    char *result = format( "intValue( %s )", val );
+    free( val );
+    return result;
+  }
+
+  switch ( expr->kind ) {
+  case VariableKind:
+    return format( "loadValue( v%d )", ( (VariableExpr *) expr )->slot );
+
+  case SeqLiteralKind:
+    return format( "constValue( c%d )",
+                   constIndex( t, ( (SeqLiteral *) expr )->seq ) );
+
+  case SeqInitKind: {
+    SequenceExpr *this = (SequenceExpr *) expr;
+    char *temp = newTemp( t );
+    if ( this->len == 0 ) {
+      line( t, "Value %s = seqInitValues( 0, NULL );", temp );
+      return temp;
+    }
+
+    char *elems[ this->len ];
+    for ( int i = 0; i < this->len; i++ )
+      elems[ i ] = valueExpr( t, this->expList[ i ] );
+    line( t, "Value %s = seqInitValues( %d, (Value const[]){", temp,
+          this->len );
+    t->indent++;
+    for ( int i = 0; i < this->len; i++ ) {
+      line( t, "%s%s", elems[ i ], i + 1 < this->len ? "," : "" );
+      free( elems[ i ] );
+    }
+    t->indent--;
+    line( t, "} );" );
+    return temp;
+  }
+
+  case CallKind:
+    return callExpr( t, (CallExpr *) expr );
+
+  default: {
+    // An addition or multiplication that might involve a sequence.
+    SimpleExpr *this = (SimpleExpr *) expr;
+    char *left = valueExpr( t, this->expr1 );
+    char *right = valueExpr( t, this->expr2 );
+    char *temp = newTemp( t );
+    line( t, "Value %s = %sValues( %s, %s );", temp,
+          expr->kind == AddKind ? "add" : "mul", left, right );
+    free( left );
+    free( right );
+    return temp;
+  }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+// Statements
+
+/** Translate a statement.
+    @param t translation to add to.
+    @param stmt statement to translate.
+*/
+static void translateStmt( Translator *t, Stmt *stmt )
+{
+  switch ( stmt->kind ) {
+  case PrintKind: {
+    Expr *arg = ( (SimpleStmt *) stmt )->expr1;
+    bool isInt = isIntExpr( t, arg );
+    char *val = isInt ? intExpr( t, arg ) : valueExpr( t, arg );
+    line( t, isInt ? "outputInt( %s );" : "printValue( %s );", val );
+    free( val );
+    break;
+  }
+
+  case PushKind: {
+    SimpleStmt *this = (SimpleStmt *) stmt;
+    char *seq = valueExpr( t, this->expr1 );
+    char *val = valueExpr( t, this->expr2 );
+    line( t, "pushValue( %s, %s );", seq, val );
+    free( seq );
+    free( val );
+    break;
+  }
+
+  case AssignmentKind: {
+    AssignmentStmt *this = (AssignmentStmt *) stmt;
+    int slot = this->slot;
+    bool seqVar = t->seqVars[ slot ];
+
+    if ( this->iexpr ) {
+      // The new value is evaluated before the index.
+      char *seq = seqVar ? format( "v%d", slot ) :
+        format( "intValue( v%d )", slot );
+      if ( isIntExpr( t, this->expr ) && isIntExpr( t, this->iexpr ) ) {
+        char *val = intExpr( t, this->expr );
+        char *idx = intExpr( t, this->iexpr );
+        line( t, "storeInt( %s, %s, %s );", seq, idx, val );
+        free( val );
+        free( idx );
+      } else {
+        char *val = valueExpr( t, this->expr );
+        char *temp = newTemp( t );
+        line( t, "Value %s = %s;", temp, val );
+        char *idx = valueExpr( t, this->iexpr );
+        line( t, "storeIndexValue( %s, %s, %s );", seq, idx, temp );
+        line( t, "releaseValue( %s );", temp );
+        free( val );
+        free( temp );
+        free( idx );
+      }
+      free( seq );
+    } else if ( isAddAssignment( slot, this->iexpr, this->expr ) ) {
+      // Only the right-hand operand of the addition is evaluated.
+      Expr *operand = ( (SimpleExpr *) this->expr )->expr2;
+      if ( seqVar ) {
+        char *val = valueExpr( t, operand );
+        line( t, "addAssignTo( &v%d, %s );", slot, val );
+        free( val );
+      } else {
+        char *val = intExpr( t, operand );
+        line( t, "v%d = addInts( v%d, %s );", slot, slot, val );
+        free( val );
+      }
+    } else if ( seqVar ) {
+      char *val = valueExpr( t, this->expr );
+      line( t, "assignValue( &v%d, %s );", slot, val );
+      free( val );
+    } else {
+      char *val = intExpr( t, this->expr );
+      line( t, "v%d = %s;", slot, val );
+      free( val );
+    }
+    break;
+  }
+
+  case CompoundKind: {
+    CompoundStmt *this = (CompoundStmt *) stmt;
+    for ( int i = 0; i < this->len; i++ )
+      translateStmt( t, this->stmtList[ i ] );
+    break;
+  }
+
+  case IfKind: {
+    ConditionalStmt *this = (ConditionalStmt *) stmt;
+    char *cond = intExpr( t, this->cond );
+    line( t, "if ( %s ) {", cond );
+    free( cond );
+    t->indent++;
+    translateStmt( t, this->body );
+    t->indent--;
+    line( t, "}" );
+    break;
+  }
+
+  case WhileKind: {
+    // A condition that needs statements of its own is checked at the
+    // top of the body.
+    ConditionalStmt *this = (ConditionalStmt *) stmt;
+    int mark = t->len;
+    t->indent++;
+    char *cond = intExpr( t, this->cond );
+    t->indent--;
+    if ( t->len == mark ) {
+      line( t, "while ( %s ) {", cond );
+      t->indent++;
+    } else {
+      char *stmts = format( "%s", t->code + mark );
+      t->len = mark;
+      t->code[ mark ] = '\0';
+      line( t, "for ( ;; ) {" );
+      append( t, stmts );
+      t->indent++;
+      line( t, "if ( !%s )", cond );
+      line( t, "  break;" );
+      free( stmts );
+    }
+    free( cond );
+    translateStmt( t, this->body );
+    t->indent--;
+    line( t, "}" );
+    break;
+  }
+  }
+}
+
+/** Write a string as a C string literal.
+    @param fp file to write to.
+    @param str string to write.
+*/
+static void writeString( FILE *fp, char const *str )
+{
+  fputc( '"', fp );
+  for ( ; *str; str++ ) {
+    if ( *str == '\n' )
+      fputs( "\\n", fp );
+    else {
+      if ( *str == '"' || *str == '\\' )
+        fputc( '\\', fp );
+      fputc( *str, fp );
+    }
+  }
+  fputc( '"', fp );
+}
+
+void translateProgram( FILE *fp, char const *filename, int len,
+                       Stmt **stmts, char const *error )
+{
+  Translator t = { NULL, 0, 0, 1, 0, NULL, NULL, 0, 0 };
+  append( &t, "" );
+
+  // Work out which variables might hold sequences; the rest can be C
+  // ints.  Finding one can make an assignment to another one a
+  // sequence, so keep going until there are no more.
+  int vars = variableCount();
+  t.seqVars = (bool *) calloc( vars + 1, sizeof( bool ) );
+  bool changed = true;
+  while ( changed ) {
+    changed = false;
+    for ( int i = 0; i < len; i++ )
+      changed = findSeqVars( &t, stmts[ i ] ) || changed;
+  }
+
+  for ( int i = 0; i < len; i++ )
+    translateStmt( &t, stmts[ i ] );
+
+  fprintf( fp, "/**\n  Translated from %s by interpret --emit-c.\n*/\n\n",
+           filename );
+  fprintf( fp, "#include <stdio.h>\n#include <stdlib.h>\n\n" );
+  fprintf( fp, "#include \"ops.h\"\n#include \"output.h\"\n\n" );
+  fprintf( fp, "%s\nint main()\n{\n", prelude );
+
+  // Constants for the literals.
+  for ( int i = 0; i < t.constCount; i++ ) {
+    Sequence *seq = t.consts[ i ];
+    fprintf( fp, "  Sequence *c%d = makeConstSequence( %d, (int const[]){",
+             i, seq->len );
+    for ( int j = 0; j < seq->len; j++ )
+      fprintf( fp, "%s%s%d", j ? "," : "",
+               j % ELEMENTS_PER_LINE ? " " : "\n    ", sequenceElement( seq, j ) );
+    fprintf( fp, "%s } );\n", seq->len ? "" : " 0" );
+  }
+
+  // Every variable starts out as zero.
+  for ( int i = 0; i < vars; i++ ) {
+    fprintf( fp, t.seqVars[ i ] ? "  Value v%d = intValue( 0 );"
+             : "  int v%d = 0;", i );
+    fprintf( fp, "  // %s\n", variableName( i ) );
+  }
+  fprintf( fp, "\n%s", t.code );
+
+  if ( error[ 0 ] != '\0' ) {
+    fprintf( fp, "\n  fputs( " );
+    writeString( fp, error );
+    fprintf( fp, ", stderr );\n  exit( EXIT_FAILURE );\n" );
+  }
+
+  // Free everything, like the interpreter does.
+  fprintf( fp, "\n" );
+  for ( int i = 0; i < vars; i++ )
+    if ( t.seqVars[ i ] )
+      fprintf( fp, "  releaseValue( v%d );\n", i );
+  for ( int i = 0; i < t.constCount; i++ )
+    fprintf( fp, "  releaseSequence( c%d );\n", i );
+  fprintf( fp, "  freeSequencePools();\n  return EXIT_SUCCESS;\n}\n" );
+
+  free( t.code );
+  free( t.seqVars );
+  free( t.consts );
+}
@@ -0,0 +1,31 @@
+/**
+  @file translate.h
+  @author Adrian Chan (amchan)
+
+  Ahead-of-time translation of a program to a standalone C translation
+  unit.  Variables that only ever hold ints become C int locals, and
+  arithmetic on them is plain C.  Everything that might involve a
+  sequence calls the same ops the interpreter uses, so the translated
+  program links against the runtime library (libp6.a) and its output
+  and error messages match the interpreter's.
+*/
+
+#ifndef _TRANSLATE_H_
+#define _TRANSLATE_H_
+
+#include <stdio.h>
+
+#include "syntax.h"
+
+/** Write a C program that does what the given statements do.
+    @param fp file to write the C source to.
+    @param filename name of the program being translated, for a comment.
+    @param len number of statements in the program.
+    @param stmts the program's statements, already optimized.
+    @param error message for a syntax error after the last statement, to
+    report when the translated program gets there, or an empty string.
+*/
+void translateProgram( FILE *fp, char const *filename, int len,
+                       Stmt **stmts, char const *error );
+
+#endif
@@ -4,9 +4,13 @@
   Represents different types of values that can be computed by the programming language.
 */
 #include "value.h"
+#include "symbol.h"
+#include "stats.h"
+#include "kernel.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 #include <assert.h>
 
 
@@ -15,35 +19,981 @@
 
 /** Double the capacity of an array */
 #define DOUBLE_CAPACITY 2
+
+/** Small leaves at the ends of a rope are merged into one leaf up to
+    this length, so building a string a little at a time doesn't make
+    a leaf for every piece. */
+#define ROPE_LEAF_LENGTH 128
+
+/** Ropes that get deeper than this are rebalanced. */
+#define MAX_ROPE_DEPTH 48
+
+//////////////////////////////////////////////////////////////////////
+// Element widths.
+
+/** Width of the elements of a sequence that holds ints. */
+#define INT_WIDTH ( (int) sizeof( int ) )
+
+/** True if a value can be stored in a byte sequence. */
+#define fitsByte( val ) ( (unsigned int) ( val ) <= UCHAR_MAX )
+
+/** The wider of two sequences' element widths. */
+#define widerOf( a, b ) \
+  ( ( a )->width > ( b )->width ? ( a )->width : ( b )->width )
+
+/** Number of elements of a sequence's width that fit inline. */
+#define inlineCapacity( seq ) \
+  ( (int) sizeof( ( seq )->inlineArr ) / ( seq )->width )
+
+/** Copy elements from one array to another, widening them from bytes
+    to ints if the destination is wider.  The destination is never
+    narrower than the source.
+    @param dest array to copy to.
+    @param destWidth width of the elements of dest.
+    @param src array to copy from.
+    @param srcWidth width of the elements of src.
+    @param len number of elements to copy.
+*/
+static void copyWidening( void *dest, int destWidth, void const *src,
+                          int srcWidth, int len )
+{
+  if ( destWidth == srcWidth ) {
+    memcpy( dest, src, (size_t) len * destWidth );
+    return;
+  }
+
+  widenBytes( (int *) dest, (unsigned char const *) src, len );
+}
+
+/** Return one element of a sequence stored in an array.
+    @param seq sequence that isn't a rope.
+    @param idx index of the element.
+    @return value of the element.
+*/
+static int elementAt( Sequence const *seq, int idx )
+{
+  if ( seq->width == BYTE_WIDTH )
+    return ( (unsigned char const *) seq->arr )[ idx ];
+  return ( (int const *) seq->arr )[ idx ];
+}
+
+/** Change one element of a sequence stored in an array.  The value
+    must fit in the sequence's width.
+    @param seq sequence that isn't a rope.
+    @param idx index of the element.
+    @param val new value for the element.
+*/
+static void setElementAt( Sequence *seq, int idx, int val )
+{
+  if ( seq->width == BYTE_WIDTH )
+    ( (unsigned char *) seq->arr )[ idx ] = val;
+  else
+    ( (int *) seq->arr )[ idx ] = val;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Pools for sequence memory.  Sequences are made and freed constantly
+// for temporary values, so freed headers and small element arrays are
+// kept on free lists and reused instead of going back to malloc.
+
+/** Size in bytes of the smallest pooled element array. */
+#define SMALLEST_POOLED 32
+
+/** Number of pooled array sizes, each twice the size of the last. */
+#define POOL_CLASSES 5
+
+/** Size in bytes of the largest pooled element array.  Larger ones are
+    allocated with malloc and grown with realloc. */
+#define LARGEST_POOLED ( SMALLEST_POOLED << ( POOL_CLASSES - 1 ) )
+
+/** Free list of unused sequence headers, linked through their shared
+    field. */
+static Sequence *headerPool;
+
+/** Free lists of unused element arrays for each size class, linked
+    through their first few bytes. */
+static void *bufferPool[ POOL_CLASSES ];
+
+/** Return the size class for an element array of the given size.
+    @param size size of the array in bytes, a pooled size.
+    @return index of its free list.
+*/
+static int poolClass( int size )
+{
+  int class = 0;
+  while ( ( SMALLEST_POOLED << class ) < size )
+    class++;
+  return class;
+}
+
+/** Make sure a sequence length fits in an int, reporting an error and
+    exiting if it doesn't.
+    @param len length, computed in a type wide enough not to overflow.
+    @return len, as an int.
+*/
+static int checkLength( long long len )
+{
+  if ( len > INT_MAX ) {
+    fprintf( stderr, "Sequence too long\n" );
+    exit( EXIT_FAILURE );
+  }
+  return len;
+}
+
+/** Return double the given capacity, or the largest capacity a
+    sequence can have if that's smaller.
+    @param cap capacity to double.
+    @return new capacity.
+*/
+static int doubleCapacity( int cap )
+{
+  return cap > INT_MAX / DOUBLE_CAPACITY ? INT_MAX : cap * DOUBLE_CAPACITY;
+}
+
+/** Get an element array with room for at least the given number of
+    elements.
+    @param cap pointer to the capacity needed.  This is updated to the
+    capacity of the array that's returned.
+    @param width width of each element.
+    @return new array, either reused from a pool or from malloc.
+*/
+static void *allocElements( int *cap, int width )
+{
+  runtimeStats.buffers++;
+  size_t size = (size_t) *cap * width;
+  if ( size > LARGEST_POOLED ) {
+    runtimeStats.bufferMallocs++;
+    return malloc( size );
+  }
+
+  int class = poolClass( size );
+  *cap = ( SMALLEST_POOLED << class ) / width;
+  void *arr = bufferPool[ class ];
+  if ( arr ) {
+    bufferPool[ class ] = *(void **) arr;
+    return arr;
+  }
+
+  runtimeStats.bufferMallocs++;
+  return malloc( SMALLEST_POOLED << class );
+}
+
+/** Free the element array a sequence owns, unless it's inline.
+    @param seq sequence with its own array.
+*/
+static void freeElements( Sequence *seq )
+{
+  if ( seq->arr == seq->inlineArr )
+    return;
+
+  size_t size = (size_t) seq->cap * seq->width;
+  if ( size > LARGEST_POOLED ) {
+    free( seq->arr );
+    return;
+  }
+
+  int class = poolClass( size );
+  *(void **) seq->arr = bufferPool[ class ];
+  bufferPool[ class ] = seq->arr;
+}
+
+/** Move a sequence's elements to a bigger array.  The sequence must
+    own its array.
+    @param seq sequence to grow.
+    @param cap number of elements it needs room for.
+*/
+static void growElements( Sequence *seq, int cap )
+{
+  int width = seq->width;
+
+  // Big arrays can just be resized in place.
+  if ( (size_t) seq->cap * width > LARGEST_POOLED &&
+       seq->arr != seq->inlineArr ) {
+    // Count it as moved, even though realloc may not have to.
+    runtimeStats.growBytes += (size_t) seq->len * width;
+    runtimeStats.buffers++;
+    runtimeStats.bufferMallocs++;
+    seq->arr = realloc( seq->arr, (size_t) cap * width );
+    seq->cap = cap;
+    return;
+  }
+
+  void *arr = allocElements( &cap, width );
+  memcpy( arr, seq->arr, (size_t) seq->len * width );
+  runtimeStats.growBytes += (size_t) seq->len * width;
+  freeElements( seq );
+  seq->arr = arr;
+  seq->cap = cap;
+}
+
+/** Change a byte sequence to store its elements as ints, so it can
+    hold any value.  The sequence must own its array.
+    @param seq byte sequence to widen.
+    @param cap number of elements it needs room for.
+*/
+static void widenSequence( Sequence *seq, int cap )
+{
+  runtimeStats.widenings++;
+  runtimeStats.growBytes += seq->len;
+
+  // Short sequences can stay inline.  Widen from the back, so no byte
+  // is overwritten before it's read.
+  if ( cap <= INLINE_CAPACITY && seq->arr == seq->inlineArr ) {
+    unsigned char const *bytes = (unsigned char const *) seq->arr;
+    for ( int i = seq->len - 1; i >= 0; i-- )
+      seq->inlineArr[ i ] = bytes[ i ];
+    seq->width = INT_WIDTH;
+    seq->cap = INLINE_CAPACITY;
+    return;
+  }
+
+  int *arr = (int *) allocElements( &cap, INT_WIDTH );
+  widenBytes( arr, (unsigned char const *) seq->arr, seq->len );
+  freeElements( seq );
+  seq->arr = arr;
+  seq->cap = cap;
+  seq->width = INT_WIDTH;
+}
+
+void freeSequencePools()
+{
+  while ( headerPool ) {
+    Sequence *seq = headerPool;
+    headerPool = seq->shared;
+    free( seq );
+  }
+
+  for ( int i = 0; i < POOL_CLASSES; i++ ) {
+    while ( bufferPool[ i ] ) {
+      void *arr = bufferPool[ i ];
+      bufferPool[ i ] = *(void **) arr;
+      free( arr );
+    }
+  }
+}
+
 //////////////////////////////////////////////////////////////////////
 // Sequence.
 
-Sequence *makeSequence()
+/** Allocate a sequence with no elements and a reference count of one.
+    @return pointer to the new sequence.
+*/
+static Sequence *allocSequence()
 {
-  Sequence *seq = malloc(sizeof(Sequence));
-  seq->cap = INITIAL_CAPACITY;
-  seq->arr = malloc(seq->cap * sizeof(int));
+  runtimeStats.sequencesMade++;
+  Sequence *seq = headerPool;
+  if ( seq )
+    headerPool = seq->shared;
+  else {
+    runtimeStats.headerMallocs++;
+    seq = (Sequence *) malloc( sizeof( Sequence ) );
+  }
+
+  seq->arr = NULL;
+  seq->cap = 0;
   seq->len = 0;
+  seq->width = BYTE_WIDTH;
   seq->ref = 0;
-  
+  seq->constant = false;
+  seq->shared = NULL;
+  seq->left = NULL;
+  seq->right = NULL;
+  seq->depth = 0;
+
   grabSequence(seq);
-  
+  return seq;
+}
+
+/** Create an empty sequence with room for the given number of elements
+    of the given width.
+    @param cap number of elements the sequence should have room for.
+    @param width width of its elements.
+    @return pointer to the new, dynamically allocated sequence.
+*/
+static Sequence *makeSequenceWidth( int cap, int width )
+{
+  Sequence *seq = allocSequence();
+  seq->width = width;
+
+  // Short sequences start out using storage inside the header.
+  if ( cap <= inlineCapacity( seq ) ) {
+    runtimeStats.inlineBuffers++;
+    seq->arr = seq->inlineArr;
+    seq->cap = inlineCapacity( seq );
+  } else {
+    seq->arr = allocElements( &cap, width );
+    seq->cap = cap;
+  }
+  return seq;
+}
+
+Sequence *makeSequence()
+{
+  return makeSequenceCap( 0 );
+}
+
+Sequence *makeSequenceCap( int cap )
+{
+  // Every sequence starts out storing bytes, until it gets an element
+  // that doesn't fit.
+  return makeSequenceWidth( cap, BYTE_WIDTH );
+}
+
+Sequence *makeConstSequence( int len, int const *vals )
+{
+  Sequence *seq = makeSequenceCap( len );
+  appendSequence( seq, vals, len );
+  seq->constant = true;
+  return seq;
+}
+
+/** Make a rope for the concatenation of two immutable sequences.
+    @param left immutable sequence for the front.  The rope takes over
+    the caller's reference to it.
+    @param right immutable sequence for the back.  The rope takes over
+    the caller's reference to it.
+    @param constant true if the rope itself should be immutable.
+    @return pointer to the new, dynamically allocated rope.
+*/
+static Sequence *makeRope( Sequence *left, Sequence *right, bool constant )
+{
+  Sequence *seq = allocSequence();
+  seq->len = checkLength( (long long) left->len + right->len );
+  seq->width = widerOf( left, right );
+  seq->constant = constant;
+  seq->left = left;
+  seq->right = right;
+  seq->depth = 1 + ( left->depth > right->depth ? left->depth :
+                     right->depth );
+  return seq;
+}
+
+Sequence *shareSequence( Sequence *constant )
+{
+  // A rope's parts are already immutable, so they can be shared as is.
+  if ( constant->left ) {
+    grabSequence( constant->left );
+    grabSequence( constant->right );
+    return makeRope( constant->left, constant->right, false );
+  }
+
+  Sequence *seq = allocSequence();
+  seq->arr = constant->arr;
+  seq->cap = constant->len;
+  seq->len = constant->len;
+  seq->width = constant->width;
+
+  // Hold a reference to the constant while we're using its elements.
+  seq->shared = constant;
+  grabSequence(constant);
   return seq;
 }
 
 void freeSequence( Sequence *seq )
 {
-  free(seq->arr);
-  free(seq);
+  runtimeStats.sequencesFreed++;
+  if ( seq->left ) {
+    releaseSequence(seq->left);
+    releaseSequence(seq->right);
+  } else if ( seq->shared )
+    releaseSequence(seq->shared);
+  else
+    freeElements(seq);
+
+  // Keep the header for the next sequence.
+  seq->shared = headerPool;
+  headerPool = seq;
+}
+
+/** Copy all the elements of a sequence into the given array, without
+    flattening it.
+    @param seq sequence to copy from.
+    @param dest array with room for all the elements of seq.
+    @param width width of the elements of dest, at least as wide as
+    the elements of seq.
+*/
+static void copyElements( Sequence const *seq, void *dest, int width )
+{
+  while ( seq->left ) {
+    copyElements( seq->left, dest, width );
+    dest = (char *) dest + (size_t) seq->left->len * width;
+    seq = seq->right;
+  }
+  copyWidening( dest, width, seq->arr, seq->width, seq->len );
+}
+
+/** Turn a rope into a sequence stored in its own array.  This doesn't
+    change the elements, so it's fine to do to an immutable rope.
+    @param seq sequence to flatten.
+*/
+static void flattenSequence( Sequence *seq )
+{
+  if ( !seq->left )
+    return;
+
+  int cap = seq->len;
+  void *arr = allocElements( &cap, seq->width );
+  copyElements( seq, arr, seq->width );
+  runtimeStats.flattenBytes += (size_t) seq->len * seq->width;
+  seq->arr = arr;
+  seq->cap = cap;
+
+  releaseSequence( seq->left );
+  releaseSequence( seq->right );
+  seq->left = seq->right = NULL;
+  seq->depth = 0;
+}
+
+int const *sequenceElements( Sequence *seq )
+{
+  assert( seq->width == INT_WIDTH );
+  flattenSequence( seq );
+  return (int const *) seq->arr;
+}
+
+unsigned char const *sequenceBytes( Sequence *seq )
+{
+  assert( seq->width == BYTE_WIDTH );
+  flattenSequence( seq );
+  return (unsigned char const *) seq->arr;
+}
+
+int sequenceElement( Sequence *seq, int idx )
+{
+  flattenSequence( seq );
+  return elementAt( seq, idx );
+}
+
+int compareSequences( Sequence *a, Sequence *b )
+{
+  flattenSequence( a );
+  flattenSequence( b );
+
+  int shortest = a->len < b->len ? a->len : b->len;
+  if ( a->width == BYTE_WIDTH && b->width == BYTE_WIDTH ) {
+    // Bytes are unsigned, so memcmp orders them the same way we do.
+    int result = memcmp( a->arr, b->arr, shortest );
+    if ( result )
+      return result;
+  } else {
+    // Find the first difference in bulk if both hold ints.
+    int i = 0;
+    if ( a->width == INT_WIDTH && b->width == INT_WIDTH )
+      i = mismatchInts( (int const *) a->arr, (int const *) b->arr,
+                        shortest );
+    for ( ; i < shortest; i++ ) {
+      int x = elementAt( a, i );
+      int y = elementAt( b, i );
+      if ( x != y )
+        return x < y ? -1 : 1;
+    }
+  }
+
+  return ( a->len > b->len ) - ( a->len < b->len );
+}
+
+/** Return an immutable sequence with the same elements as the given
+    one, for use as part of a rope.  This never copies elements.  A
+    sequence with its own array hands the array over to a new constant
+    and shares it from then on, copying it if it's changed later.
+    @param seq sequence to get an immutable version of.
+    @return immutable sequence, with a reference for the caller.
+*/
+static Sequence *freezeSequence( Sequence *seq )
+{
+  if ( seq->constant ) {
+    grabSequence( seq );
+    return seq;
+  }
+
+  if ( seq->left ) {
+    grabSequence( seq->left );
+    grabSequence( seq->right );
+    return makeRope( seq->left, seq->right, true );
+  }
+
+  if ( !seq->shared ) {
+    Sequence *constant = allocSequence();
+    constant->arr = seq->arr;
+    constant->cap = seq->cap;
+    constant->len = seq->len;
+    constant->width = seq->width;
+    constant->constant = true;
+
+    // Inline elements have to move with the array.
+    if ( seq->arr == seq->inlineArr ) {
+      memcpy( constant->inlineArr, seq->inlineArr, sizeof( seq->inlineArr ) );
+      constant->arr = constant->inlineArr;
+      seq->arr = constant->arr;
+    }
+
+    // The constant starts out with a reference for seq.
+    seq->shared = constant;
+    seq->cap = seq->len;
+  }
+
+  grabSequence( seq->shared );
+  return seq->shared;
+}
+
+/** Add every leaf of a rope to the end of a resizable list.
+    @param seq rope or leaf to add the leaves of.
+    @param list pointer to the list of leaves.
+    @param len pointer to the number of leaves in the list.
+    @param cap pointer to the capacity of the list.
+*/
+static void collectLeaves( Sequence *seq, Sequence ***list, int *len, int *cap )
+{
+  while ( seq->left ) {
+    collectLeaves( seq->left, list, len, cap );
+    seq = seq->right;
+  }
+
+  if ( *len >= *cap ) {
+    *cap = *cap ? *cap * DOUBLE_CAPACITY : INITIAL_CAPACITY;
+    *list = realloc( *list, *cap * sizeof( Sequence * ) );
+  }
+  ( *list )[ ( *len )++ ] = seq;
+}
+
+/** Build a balanced, immutable rope out of a range of leaves.
+    @param leaves list of leaves.
+    @param lo index of the first leaf to use.
+    @param hi index just past the last leaf to use.
+    @return new immutable rope or leaf, with a reference for the caller.
+*/
+static Sequence *buildRope( Sequence **leaves, int lo, int hi )
+{
+  if ( hi - lo == 1 ) {
+    grabSequence( leaves[ lo ] );
+    return leaves[ lo ];
+  }
+
+  int mid = lo + ( hi - lo ) / 2;
+  return makeRope( buildRope( leaves, lo, mid ),
+                   buildRope( leaves, mid, hi ), true );
+}
+
+/** Join two immutable sequences, keeping the result balanced.
+    @param a immutable sequence for the front.  Takes over the caller's
+    reference.
+    @param b immutable sequence for the back.  Takes over the caller's
+    reference.
+    @return immutable concatenation, with a reference for the caller.
+*/
+static Sequence *joinSequences( Sequence *a, Sequence *b )
+{
+  // Merge short pieces into the leaf at the end they're being added
+  // to, so a rope built a few elements at a time doesn't get deep.
+  if ( !b->left && a->left && !a->right->left &&
+       a->right->len + b->len <= ROPE_LEAF_LENGTH ) {
+    Sequence *leaf = makeSequenceWidth( a->right->len + b->len,
+                                        widerOf( a->right, b ) );
+    extendSequence( leaf, a->right );
+    extendSequence( leaf, b );
+    leaf->constant = true;
+
+    grabSequence( a->left );
+    Sequence *seq = makeRope( a->left, leaf, true );
+    releaseSequence( a );
+    releaseSequence( b );
+    return seq;
+  }
+
+  if ( !a->left && b->left && !b->left->left &&
+       a->len + b->left->len <= ROPE_LEAF_LENGTH ) {
+    Sequence *leaf = makeSequenceWidth( a->len + b->left->len,
+                                        widerOf( a, b->left ) );
+    extendSequence( leaf, a );
+    extendSequence( leaf, b->left );
+    leaf->constant = true;
+
+    grabSequence( b->right );
+    Sequence *seq = makeRope( leaf, b->right, true );
+    releaseSequence( a );
+    releaseSequence( b );
+    return seq;
+  }
+
+  Sequence *seq = makeRope( a, b, true );
+  if ( seq->depth <= MAX_ROPE_DEPTH )
+    return seq;
+
+  // Too deep, rebuild it as a balanced tree over the same leaves.
+  Sequence **leaves = NULL;
+  int len = 0, cap = 0;
+  collectLeaves( seq, &leaves, &len, &cap );
+  Sequence *balanced = buildRope( leaves, 0, len );
+  free( leaves );
+  releaseSequence( seq );
+  return balanced;
+}
+
+/** Return a mutable sequence with the elements of an immutable one.
+    @param seq immutable sequence.  Takes over the caller's reference.
+    @return new mutable sequence, with a reference for the caller.
+*/
+static Sequence *mutableSequence( Sequence *seq )
+{
+  Sequence *result = shareSequence( seq );
+  releaseSequence( seq );
+  return result;
+}
+
+Sequence *concatSequences( Sequence *a, Sequence *b )
+{
+  int len = checkLength( (long long) a->len + b->len );
+  if ( len < ROPE_MIN_LENGTH ) {
+    Sequence *seq = makeSequenceWidth( len, widerOf( a, b ) );
+    copyElements( a, seq->arr, seq->width );
+    copyElements( b, (char *) seq->arr + a->len * seq->width, seq->width );
+    seq->len = len;
+    return seq;
+  }
+
+  return mutableSequence( joinSequences( freezeSequence( a ),
+                                         freezeSequence( b ) ) );
+}
+
+/** Make a sequence stored in its own array that's the given number of
+    copies of seq.  It's sized once, and then filled by doubling.
+    @param seq sequence to repeat.
+    @param count number of copies.
+    @return pointer to the new, dynamically allocated sequence.
+*/
+static Sequence *repeatElements( Sequence *seq, int count )
+{
+  int len = checkLength( (long long) seq->len * count );
+  Sequence *result = makeSequenceWidth( len, seq->width );
+
+  // With nothing to repeat, there's no room for even one copy.
+  if ( len == 0 )
+    return result;
+
+  copyElements( seq, result->arr, result->width );
+  repeatBytes( result->arr, (size_t) seq->len * seq->width, count );
+  runtimeStats.mulBytes += (size_t) len * seq->width;
+  result->len = len;
+  return result;
+}
+
+Sequence *repeatSequence( Sequence *seq, int count )
+{
+  if ( checkLength( (long long) seq->len * count ) < ROPE_MIN_LENGTH )
+    return repeatElements( seq, count );
+
+  // Start with a piece that's at least a leaf long, so the rope
+  // doesn't need a node for every few elements.
+  int factor = 1;
+  while ( count % 2 == 0 && seq->len * factor < ROPE_LEAF_LENGTH ) {
+    factor *= 2;
+    count /= 2;
+  }
+
+  Sequence *piece;
+  if ( factor > 1 ) {
+    piece = repeatElements( seq, factor );
+    piece->constant = true;
+  } else
+    piece = freezeSequence( seq );
+
+  // Build the result by doubling, so it only needs about log count
+  // ropes, all sharing the same piece.
+  Sequence *result = NULL;
+  while ( count > 0 ) {
+    if ( count % 2 ) {
+      grabSequence( piece );
+      result = result ? joinSequences( result, piece ) : piece;
+    }
+    count /= 2;
+    if ( count > 0 ) {
+      grabSequence( piece );
+      piece = joinSequences( piece, piece );
+    }
+  }
+  releaseSequence( piece );
+
+  return mutableSequence( result );
+}
+
+/** Copy-on-write for sequences that share their elements with a
+    constant or are stored as a rope.  Give the sequence its own copy
+    of its elements, so it can be changed.
+    @param seq sequence that's about to be changed.
+*/
+static void ownSequence( Sequence *seq )
+{
+  assert( !seq->constant );
+  flattenSequence( seq );
+  if ( !seq->shared )
+    return;
+
+  // Leave room to grow, since we're about to change it.
+  size_t size = (size_t) seq->len * seq->width;
+  runtimeStats.copyOnWriteBytes += size;
+  int cap = doubleCapacity( seq->len );
+  if ( cap <= inlineCapacity( seq ) ) {
+    seq->cap = inlineCapacity( seq );
+    memcpy( seq->inlineArr, seq->arr, size );
+    seq->arr = seq->inlineArr;
+  } else {
+    void *arr = allocElements( &cap, seq->width );
+    memcpy( arr, seq->arr, size );
+    seq->arr = arr;
+    seq->cap = cap;
+  }
+
+  releaseSequence( seq->shared );
+  seq->shared = NULL;
+}
+
+/** Make sure a sequence has room for more elements, growing it once,
+    to at least double the old capacity so repeated appends take
+    amortized linear time.  The sequence must own its array.
+    @param seq sequence to make room in.
+    @param len number of elements about to be added.
+*/
+static void reserveElements( Sequence *seq, int len )
+{
+  int needed = checkLength( (long long) seq->len + len );
+  if ( needed > seq->cap ) {
+    runtimeStats.appendGrowths++;
+    int cap = doubleCapacity( seq->cap );
+    growElements( seq, cap < needed ? needed : cap );
+  }
+}
+
+void appendSequence( Sequence *seq, int const *vals, int len )
+{
+  ownSequence( seq );
+
+  // A byte sequence has to be widened if any new value won't fit.
+  if ( seq->width == BYTE_WIDTH ) {
+    for ( int i = 0; i < len; i++ ) {
+      if ( !fitsByte( vals[ i ] ) ) {
+        widenSequence( seq, checkLength( (long long) seq->len + len ) );
+        break;
+      }
+    }
+  }
+
+  reserveElements( seq, len );
+  if ( seq->width == BYTE_WIDTH ) {
+    unsigned char *bytes = (unsigned char *) seq->arr + seq->len;
+    for ( int i = 0; i < len; i++ )
+      bytes[ i ] = vals[ i ];
+  } else
+    memcpy( (int *) seq->arr + seq->len, vals, len * sizeof( int ) );
+  seq->len += len;
+}
+
+void extendSequence( Sequence *seq, Sequence const *src )
+{
+  ownSequence( seq );
+  if ( src->width > seq->width && src->len > 0 )
+    widenSequence( seq, checkLength( (long long) seq->len + src->len ) );
+
+  reserveElements( seq, src->len );
+  copyElements( src, (char *) seq->arr + (size_t) seq->len * seq->width,
+                seq->width );
+  seq->len += src->len;
+}
+
+void storeSequence( Sequence *seq, int idx, int val )
+{
+  ownSequence( seq );
+  if ( seq->width == BYTE_WIDTH && !fitsByte( val ) )
+    widenSequence( seq, seq->cap );
+  setElementAt( seq, idx, val );
+}
+
+void pushSequence( Sequence *seq, int val )
+{
+  ownSequence( seq );
+  if ( seq->width == BYTE_WIDTH && !fitsByte( val ) )
+    widenSequence( seq, seq->cap );
+  if ( seq->len == seq->cap ) {
+    runtimeStats.pushGrowths++;
+    checkLength( (long long) seq->len + 1 );
+    growElements( seq, doubleCapacity( seq->cap ) );
+  }
+  setElementAt( seq, seq->len++, val );
+}
+
+//////////////////////////////////////////////////////////////////////
+// Whole-sequence operations, for the built-in functions.
+
+/** Number of bits in each digit of the radix sort. */
+#define RADIX_BITS 8
+
+/** Number of different values a digit of the radix sort can have. */
+#define RADIX_BUCKETS ( 1 << RADIX_BITS )
+
+/** Return one digit of an int's sort key.  Flipping the sign bit makes
+    the keys of negative ints come before the others as unsigned values.
+    @param val int to get a digit of.
+    @param shift number of bits below the digit.
+    @return value of the digit.
+*/
+static int radixDigit( int val, int shift )
+{
+  return ( ( (unsigned int) val ^ ( 1u << ( INT_WIDTH * CHAR_BIT - 1 ) ) )
+           >> shift ) & ( RADIX_BUCKETS - 1 );
+}
+
+/** Sort an array of ints with a least-significant-digit radix sort.
+    Passes where every element has the same digit are skipped, so small
+    values only take one or two passes.
+    @param arr array to sort in place.
+    @param len number of elements in arr, at least one.
+*/
+static void radixSort( int *arr, int len )
+{
+  int *temp = (int *) malloc( len * sizeof( int ) );
+  int *src = arr;
+  int *dest = temp;
+  for ( int shift = 0; shift < INT_WIDTH * CHAR_BIT; shift += RADIX_BITS ) {
+    int starts[ RADIX_BUCKETS + 1 ] = { 0 };
+    for ( int i = 0; i < len; i++ )
+      starts[ radixDigit( src[ i ], shift ) + 1 ]++;
+    if ( starts[ radixDigit( src[ 0 ], shift ) + 1 ] == len )
+      continue;
+
+    for ( int d = 1; d <= RADIX_BUCKETS; d++ )
+      starts[ d ] += starts[ d - 1 ];
+    for ( int i = 0; i < len; i++ )
+      dest[ starts[ radixDigit( src[ i ], shift ) ]++ ] = src[ i ];
+
+    int *swap = src;
+    src = dest;
+    dest = swap;
+  }
+
+  if ( src != arr )
+    memcpy( arr, src, len * sizeof( int ) );
+  free( temp );
+}
+
+Sequence *sliceSequence( Sequence *seq, int lo, int hi )
+{
+  flattenSequence( seq );
+  Sequence *result = makeSequenceWidth( hi - lo, seq->width );
+  memcpy( result->arr, (char *) seq->arr + (size_t) lo * seq->width,
+          (size_t) ( hi - lo ) * seq->width );
+  result->len = hi - lo;
+  return result;
+}
+
+int sumSequence( Sequence *seq )
+{
+  flattenSequence( seq );
+  if ( seq->width == BYTE_WIDTH )
+    return sumBytes( (unsigned char const *) seq->arr, seq->len );
+  return sumInts( (int const *) seq->arr, seq->len );
+}
+
+void sequenceRange( Sequence *seq, int *min, int *max )
+{
+  flattenSequence( seq );
+  if ( seq->width == BYTE_WIDTH )
+    rangeBytes( (unsigned char const *) seq->arr, seq->len, min, max );
+  else
+    rangeInts( (int const *) seq->arr, seq->len, min, max );
+}
+
+int findInSequence( Sequence *seq, int val )
+{
+  flattenSequence( seq );
+  if ( seq->width == BYTE_WIDTH ) {
+    if ( !fitsByte( val ) )
+      return -1;
+    unsigned char const *bytes = (unsigned char const *) seq->arr;
+    unsigned char const *found = memchr( bytes, val, seq->len );
+    return found ? found - bytes : -1;
+  }
+  return findInts( (int const *) seq->arr, seq->len, val );
+}
+
+int countInSequence( Sequence *seq, int val )
+{
+  flattenSequence( seq );
+  if ( seq->width == BYTE_WIDTH )
+    return fitsByte( val ) ?
+      countBytes( (unsigned char const *) seq->arr, seq->len, val ) : 0;
+  return countInts( (int const *) seq->arr, seq->len, val );
+}
+
+Sequence *sortSequence( Sequence *seq )
+{
+  flattenSequence( seq );
+  Sequence *result = makeSequenceWidth( seq->len, seq->width );
+  result->len = seq->len;
+  if ( seq->len == 0 )
+    return result;
+
+  if ( seq->width == BYTE_WIDTH ) {
+    // Bytes only take one counting pass, then a run for each value.
+    int counts[ UCHAR_MAX + 1 ] = { 0 };
+    unsigned char const *bytes = (unsigned char const *) seq->arr;
+    for ( int i = 0; i < seq->len; i++ )
+      counts[ bytes[ i ] ]++;
+
+    unsigned char *dest = (unsigned char *) result->arr;
+    for ( int val = 0; val <= UCHAR_MAX; val++ ) {
+      memset( dest, val, counts[ val ] );
+      dest += counts[ val ];
+    }
+    return result;
+  }
+
+  memcpy( result->arr, seq->arr, seq->len * sizeof( int ) );
+  radixSort( (int *) result->arr, seq->len );
+  return result;
+}
+
+Sequence *reverseSequence( Sequence *seq )
+{
+  flattenSequence( seq );
+  Sequence *result = makeSequenceWidth( seq->len, seq->width );
+  result->len = seq->len;
+  int last = seq->len - 1;
+  if ( seq->width == BYTE_WIDTH ) {
+    unsigned char const *src = (unsigned char const *) seq->arr;
+    unsigned char *dest = (unsigned char *) result->arr;
+    for ( int i = 0; i <= last; i++ )
+      dest[ last - i ] = src[ i ];
+  } else {
+    int const *src = (int const *) seq->arr;
+    int *dest = (int *) result->arr;
+    for ( int i = 0; i <= last; i++ )
+      dest[ last - i ] = src[ i ];
+  }
+  return result;
+}
+
+Sequence *fillSequence( int len, int val )
+{
+  Sequence *seq = makeSequenceWidth( len, fitsByte( val ) ? BYTE_WIDTH :
+                                     INT_WIDTH );
+  seq->len = len;
+  if ( seq->width == BYTE_WIDTH )
+    memset( seq->arr, val, len );
+  else if ( len > 0 ) {
+    *(int *) seq->arr = val;
+    repeatBytes( seq->arr, sizeof( int ), len );
+  }
+  return seq;
 }
 
 void grabSequence( Sequence *seq )
 {
+  runtimeStats.grabs++;
   seq->ref += 1;
 }
 
 void releaseSequence( Sequence *seq )
 {
+  runtimeStats.releases++;
   seq->ref -= 1;
 
   if ( seq->ref <= 0 ) {
@@ -55,83 +1005,148 @@ void releaseSequence( Sequence *seq )
 }
 
 //////////////////////////////////////////////////////////////////////
-// Environment.
+// Variable slots.
+
+/** Symbol for each variable, indexed by slot. */
+static int *slotSyms;
+
+/** Number of slots handed out so far. */
+static int slotCount;
 
-typedef struct {
-  char name[ MAX_VAR_NAME + 1 ];
-  Value val;
-} VarRec;
+/** Capacity of the slotSyms array. */
+static int slotCap;
+
+/** Slot for each symbol, indexed by symbol ID, or -1 if that symbol
+    hasn't been used as a variable. */
+static int *symSlots;
+
+/** Number of entries in the symSlots array. */
+static int symSlotCap;
+
+int variableSlot( int sym )
+{
+  // Make sure there's an entry for this symbol.
+  if ( sym >= symSlotCap ) {
+    int cap = symSlotCap ? symSlotCap : INITIAL_CAPACITY;
+    while ( cap <= sym )
+      cap *= DOUBLE_CAPACITY;
+    symSlots = (int *) realloc( symSlots, cap * sizeof( int ) );
+    for ( int i = symSlotCap; i < cap; i++ )
+      symSlots[ i ] = -1;
+    symSlotCap = cap;
+  }
+
+  if ( symSlots[ sym ] >= 0 )
+    return symSlots[ sym ];
+
+  if ( slotCount >= slotCap ) {
+    slotCap = slotCap ? slotCap * DOUBLE_CAPACITY : INITIAL_CAPACITY;
+    slotSyms = (int *) realloc( slotSyms, slotCap * sizeof( int ) );
+  }
+  slotSyms[ slotCount ] = sym;
+  symSlots[ sym ] = slotCount;
+  return slotCount++;
+}
+
+char const *variableName( int slot )
+{
+  return symbolName( slotSyms[ slot ] );
+}
+
+int variableCount()
+{
+  return slotCount;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Environment.
 
 // Hidden implementation of the environment.
 struct EnvironmentStruct {
-  VarRec *vlist;
+  /** Values of the variables, indexed by slot. */
+  Value *vals;
 
-  // Number of name/value pairs.
+  // Number of slots with room in vals.
   int len;
-
-  // Capacity of the name/value list.
-  int capacity;
 };
 
 Environment *makeEnvironment()
 {
   Environment *env = (Environment *) malloc( sizeof( Environment ) );
-  env->capacity = INITIAL_CAPACITY;
   env->len = 0;
-  env->vlist = (VarRec *) malloc( sizeof( VarRec ) * env->capacity );
+  env->vals = NULL;
   return env;
 }
 
-Value lookupVariable( Environment *env, char const *name )
+Value lookupVariable( Environment *env, int slot )
 {
-  // Linear search for a variable name, not too efficient.
-  for ( int i = 0; i < env->len; i++ )
-    if ( strcmp( env->vlist[ i ].name, name ) == 0 )
-      return env->vlist[ i ].val;
+  // Slots are resolved when the program is parsed, so a lookup only
+  // ever has to look at one entry.
+  runtimeStats.lookups++;
+  if ( slot < env->len )
+    return env->vals[ slot ];
+  runtimeStats.lookupMisses++;
 
   // Return zero for uninitialized variables.
-  return (Value){ IntType, .ival = 0 };
+  return intValue( 0 );
 }
 
-void setVariable( Environment *env, char const *name, Value value )
+/** Make room in the environment for every slot that's been handed
+    out, with the new ones starting out as zero.
+    @param env Environment to grow.
+*/
+static void growEnvironment( Environment *env )
 {
-  int pos = 0;
-  while ( pos < env->len && strcmp( env->vlist[ pos ].name, name ) != 0 )
-    pos++;
-
-  if ( pos >= env->len ) {
-    if ( env->len >= env->capacity ) {
-      env->capacity *= DOUBLE_CAPACITY;
-      env->vlist = (VarRec *) realloc( env->vlist, sizeof( VarRec ) * env->capacity );
-    }
+  int len = variableCount();
+  if ( len > env->len ) {
+    env->vals = (Value *) realloc( env->vals, sizeof( Value ) * len );
+    for ( int i = env->len; i < len; i++ )
+      env->vals[ i ] = intValue( 0 );
+    env->len = len;
   }
+}
 
-  // Is this a new variable, or one that already existed?
-  if ( pos == env->len ) {
-    pos = env->len++;
-    strcpy( env->vlist[ pos ].name, name );
-  } else {
-    Value val = lookupVariable(env, name);
-    if (val.vtype == SeqType) {
-      releaseSequence(val.sval);
-    }
+void setVariable( Environment *env, int slot, Value value )
+{
+  if ( slot >= env->len )
+    growEnvironment( env );
+  storeValue( &env->vals[ slot ], value );
+}
+
+void storeValue( Value *var, Value value )
+{
+  runtimeStats.stores++;
+  if (isSeq(value)) {
+    // A variable can't hold a constant, since a script could change
+    // it.  It gets a sequence that shares the constant's elements.
+    if (valueSeq(value)->constant)
+      value = seqValue(shareSequence(valueSeq(value)));
+    else
+      grabSequence(valueSeq(value));
   }
-  
-  if (value.vtype == SeqType) {
-      grabSequence(value.sval);
+
+  // Release the old value, if it was a sequence.
+  Value old = *var;
+  if (isSeq(old)) {
+    releaseSequence(valueSeq(old));
   }
   
-  env->vlist[ pos ].val = value;
+  *var = value;
+}
+
+Value *variableValues( Environment *env )
+{
+  growEnvironment( env );
+  return env->vals;
 }
 
 void freeEnvironment( Environment *env )
 {
   for (int i = 0; i < env->len; i++) {
-    if (env->vlist[i].val.vtype == SeqType) {
-      releaseSequence(env->vlist[i].val.sval);
+    if (isSeq(env->vals[i])) {
+      releaseSequence(valueSeq(env->vals[i]));
     }
   }
-  free( env->vlist );
+  free( env->vals );
   free( env );
 }
-
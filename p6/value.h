@@ -10,28 +10,239 @@
 #define _VALUE_H_
 
 #include <stdbool.h>
+#include <stdint.h>
+
+/** A short name to use for the Sequence type. */
+typedef struct SequenceStruct Sequence;
+
+/** Sequences with up to this many elements keep them in the header,
+    without a separate array. */
+#define INLINE_CAPACITY 4
 
 /** Representation for a seqeunce of integers.  One type of value supported
     by the language. */
-typedef struct {
-  int *arr;
+struct SequenceStruct {
+  /** Elements of the sequence, each width bytes long. */
+  void *arr;
   int cap;
   int len;
 
+  /** Size of each element in bytes.  This is 1 for a byte sequence,
+      whose elements are all from 0 to 255 and are stored as unsigned
+      chars, like most strings; otherwise it's sizeof( int ).  A byte
+      sequence is widened the first time it gets an element that
+      doesn't fit. */
+  int width;
+
   /** Reference count for the sequence. */
   int ref;
-} Sequence;
+
+  /** True if this is an immutable constant for a literal in the
+      program.  Constants are shared by every evaluation of the
+      literal, so they're never changed or stored in a variable. */
+  bool constant;
+
+  /** If non-null, this sequence doesn't have its own copy of its
+      elements yet; arr points into this constant's elements instead.
+      The elements are copied the first time this sequence is changed. */
+  Sequence *shared;
+
+  /** If non-null, this sequence is a rope, the concatenation of the
+      immutable left and right sequences.  A rope has no arr of its
+      own until something needs its elements in one contiguous array. */
+  Sequence *left;
+  Sequence *right;
+
+  /** Height of the rope, zero for a sequence stored in an array. */
+  int depth;
+
+  /** Storage for the elements of a short sequence; arr points here
+      until the sequence outgrows it.  It holds INLINE_CAPACITY ints, or
+      four times as many bytes. */
+  int inlineArr[ INLINE_CAPACITY ];
+};
+
+/** Width of the elements of a byte sequence. */
+#define BYTE_WIDTH 1
+
+/** Concatenations shorter than this are just copied into a new array,
+    longer ones are built as a rope. */
+#define ROPE_MIN_LENGTH 256
 
 /** Create an empty sequence.
     @return pointer to the new, dynamically allocated sequence.
 */
 Sequence *makeSequence();
 
+/** Create an empty sequence with room for the given number of elements.
+    @param cap number of elements the sequence should have room for.
+    @return pointer to the new, dynamically allocated sequence.
+*/
+Sequence *makeSequenceCap( int cap );
+
+/** Create an immutable constant sequence with the given elements.
+    @param len number of elements.
+    @param vals values of the elements.
+    @return pointer to the new, dynamically allocated constant.
+*/
+Sequence *makeConstSequence( int len, int const *vals );
+
+/** Create a new sequence with the same elements as the given constant.
+    The new sequence shares the constant's elements until it's changed.
+    @param constant constant sequence to share elements with.
+    @return pointer to the new, dynamically allocated sequence.
+*/
+Sequence *shareSequence( Sequence *constant );
+
+/** Create a new sequence that's the concatenation of the two given
+    sequences.  Long results are built as a rope that shares the
+    elements of a and b rather than copying them.  The caller still
+    holds its references to a and b.
+    @param a sequence for the front of the result.
+    @param b sequence for the back of the result.
+    @return pointer to the new, dynamically allocated sequence.
+*/
+Sequence *concatSequences( Sequence *a, Sequence *b );
+
+/** Create a new sequence that's the given number of copies of seq.
+    Short results are copied into one array; long ones are built as a
+    rope that shares each copy.  The caller still holds its reference
+    to seq.
+    @param seq sequence to repeat.
+    @param count number of copies, at least zero.
+    @return pointer to the new, dynamically allocated sequence.
+*/
+Sequence *repeatSequence( Sequence *seq, int count );
+
+/** Return the elements of the given sequence in one contiguous array,
+    flattening it first if it's a rope.  The sequence must not be a byte
+    sequence.
+    @param seq sequence to get the elements of.
+    @return pointer to the elements, valid until seq is changed or freed.
+*/
+int const *sequenceElements( Sequence *seq );
+
+/** Return the elements of the given byte sequence in one contiguous
+    array, flattening it first if it's a rope.
+    @param seq byte sequence to get the elements of.
+    @return pointer to the elements, valid until seq is changed or freed.
+*/
+unsigned char const *sequenceBytes( Sequence *seq );
+
+/** Return one element of the given sequence, whatever its width.
+    @param seq sequence to get an element of.
+    @param idx index of the element, which must be in bounds.
+    @return value of the element.
+*/
+int sequenceElement( Sequence *seq, int idx );
+
+/** Compare two sequences element by element, then by length.
+    @param a first sequence to compare.
+    @param b second sequence to compare.
+    @return negative if a comes before b, positive if it comes after,
+    or zero if they have the same elements.
+*/
+int compareSequences( Sequence *a, Sequence *b );
+
+/** Create a new sequence with the elements of seq from index lo up to,
+    but not including, index hi.  The caller still holds its reference
+    to seq.
+    @param seq sequence to copy part of.
+    @param lo index of the first element to copy.
+    @param hi index just past the last element to copy, with
+    0 <= lo <= hi <= seq->len.
+    @return pointer to the new, dynamically allocated sequence.
+*/
+Sequence *sliceSequence( Sequence *seq, int lo, int hi );
+
+/** Add up the elements of a sequence, wrapping around like int
+    addition.
+    @param seq sequence to add up.
+    @return sum of the elements, zero if there aren't any.
+*/
+int sumSequence( Sequence *seq );
+
+/** Find the smallest and largest elements of a sequence.
+    @param seq sequence with at least one element.
+    @param min gets the smallest element.
+    @param max gets the largest element.
+*/
+void sequenceRange( Sequence *seq, int *min, int *max );
+
+/** Find the first element of a sequence equal to a value.
+    @param seq sequence to search.
+    @param val value to look for.
+    @return index of the first element equal to val, or -1 if none is.
+*/
+int findInSequence( Sequence *seq, int val );
+
+/** Count the elements of a sequence equal to a value.
+    @param seq sequence to search.
+    @param val value to count.
+    @return number of elements equal to val.
+*/
+int countInSequence( Sequence *seq, int val );
+
+/** Create a new sequence with the elements of seq in increasing order.
+    The caller still holds its reference to seq.
+    @param seq sequence to sort.
+    @return pointer to the new, dynamically allocated sequence.
+*/
+Sequence *sortSequence( Sequence *seq );
+
+/** Create a new sequence with the elements of seq in reverse order.
+    The caller still holds its reference to seq.
+    @param seq sequence to reverse.
+    @return pointer to the new, dynamically allocated sequence.
+*/
+Sequence *reverseSequence( Sequence *seq );
+
+/** Create a new sequence with every element set to the same value.
+    @param len number of elements, at least zero.
+    @param val value for every element.
+    @return pointer to the new, dynamically allocated sequence.
+*/
+Sequence *fillSequence( int len, int val );
+
 /** Free all the memory used to store the given sequence.
     @param seq sequence to free.
 */
 void freeSequence( Sequence *seq );
 
+/** Add an int to the end of the given sequence, growing its capacity if
+    needed.  The sequence must not be a constant.
+    @param seq sequence to add to.
+    @param val value to add to the end of the sequence.
+*/
+void pushSequence( Sequence *seq, int val );
+
+/** Add a list of ints to the end of the given sequence, growing its
+    capacity at most once.  The sequence must not be a constant.
+    @param seq sequence to add to.
+    @param vals values to add to the end of the sequence.
+    @param len number of values to add.
+*/
+void appendSequence( Sequence *seq, int const *vals, int len );
+
+/** Add the elements of one sequence to the end of another, growing its
+    capacity at most once.  The sequence must not be a constant.
+    @param seq sequence to add to.
+    @param src sequence whose elements are added.  This must not be seq.
+*/
+void extendSequence( Sequence *seq, Sequence const *src );
+
+/** Change one element of the given sequence.  The sequence must not be
+    a constant.
+    @param seq sequence to change.
+    @param idx index of the element to change.
+    @param val new value for the element.
+*/
+void storeSequence( Sequence *seq, int idx, int val );
+
+/** Free the memory held in the pools of unused sequence headers and
+    element arrays. */
+void freeSequencePools();
+
 /** Add one to the reference count for the given sequence.
     @param seq sequence in which to increate the reference count.
 */
@@ -46,33 +257,83 @@ void releaseSequence( Sequence *seq );
 //////////////////////////////////////////////////////////////////////
 // Value Representat
 
-/** Type of value in our langauge */
+/** Type of value in our langauge.  These are also the tags in the low
+    bit of a Value. */
 typedef enum { IntType, SeqType } ValType;
 
 /** A short name to use for the Value interface. */
 typedef struct ValueStruct Value;
 
 /** Representation of a value in our programming language, either an int
-    or a sequence of ints.
+    or a sequence of ints, packed in one 64-bit word so it's passed and
+    returned in a single register.  An int is stored in the high 32 bits,
+    with the low bits zero.  A sequence is its pointer with the low bit
+    set; sequences are at least 8-byte aligned, so that bit is free.
+    An all-zero word is the int zero.  Use the macros below to make and
+    take apart values, rather than the bits directly.
 */
 struct ValueStruct {
-  ValType vtype;
-  
-  union {
-    /** If this value is just one int, this is its value. */
-    int ival;
-
-    /** If this value is a sequence, this is its value. */
-    Sequence *sval;
-  };
+  /** The tagged word. */
+  uint64_t bits;
 };
 
+/** Number of bits the int in a value is shifted over. */
+#define VALUE_INT_SHIFT 32
+
+// These make and take apart values.  They're macros, not functions, so
+// they cost nothing even in a build without optimization.  Each one
+// evaluates its argument exactly once.
+
+/** Make a value holding an int. */
+#define intValue( val ) \
+  ( (Value){ (uint64_t) (uint32_t) ( val ) << VALUE_INT_SHIFT } )
+
+/** Make a value holding a sequence, without changing its reference
+    count. */
+#define seqValue( seq ) ( (Value){ (uint64_t) (uintptr_t) ( seq ) | SeqType } )
+
+/** Type of a value, IntType or SeqType. */
+#define valueType( v ) ( (ValType) ( ( v ).bits & SeqType ) )
+
+/** True if a value holds an int. */
+#define isInt( v ) ( ( ( v ).bits & SeqType ) == IntType )
+
+/** True if a value holds a sequence. */
+#define isSeq( v ) ( ( ( v ).bits & SeqType ) == SeqType )
+
+/** The int in a value that holds one. */
+#define valueInt( v ) ( (int32_t) ( ( v ).bits >> VALUE_INT_SHIFT ) )
+
+/** The sequence in a value that holds one. */
+#define valueSeq( v ) \
+  ( (Sequence *) (uintptr_t) ( ( v ).bits & ~(uint64_t) SeqType ) )
+
 //////////////////////////////////////////////////////////////////////
-// Environment, a mapping from variables names to their value.
+// Environment, a mapping from variables to their value.
 
 // Maximum length of an identifier (variable) name.
 #define MAX_VAR_NAME 20
 
+/** Return the slot for the variable with the given name.  Every
+    variable name is given a small, dense slot number the first time
+    it's seen, so the parser can resolve names once and the Environment
+    can store values in a flat array indexed by slot.
+    @param sym interned symbol for the variable name.
+    @return slot number for this variable.
+*/
+int variableSlot( int sym );
+
+/** Return the name of the variable stored in the given slot.
+    @param slot slot number returned by variableSlot().
+    @return name of the variable.
+*/
+char const *variableName( int slot );
+
+/** Return the number of variable slots handed out so far.
+    @return number of variable slots.
+*/
+int variableCount();
+
 /**
    Short typename for the Environment structure.  Its definition is an
    implementation detail of the language, not visible to client code.
@@ -87,24 +348,42 @@ typedef struct EnvironmentStruct Environment;
 Environment *makeEnvironment();
 
 
-/** Lookup the variable with the given name in the environment and
-    return its value.  If the variable doesn't have a value, this
-    function returns null.
+/** Lookup the variable in the given slot and return its value.  If the
+    variable doesn't have a value yet, this returns an int zero.
     @param env Environment object in which to lookup the variable.
-    @param name requested variable name.
-    @return the variable's value.  This is a pointer into the
-    environment's representation and should not be directly freed or
-    modified by the caller.
+    @param slot slot number for the requested variable.
+    @return the variable's value.  If this is a sequence, the
+    environment still holds the reference to it, so it should not be
+    released by the caller.
 */
-Value lookupVariable( Environment *env, char const *name );
+Value lookupVariable( Environment *env, int slot );
 
-/** In the given environment, set the named variable to store the given
-    value.
-    @param env Environment in which to store the variable name / value.
-    @param name of the variable to set the value for.
+/** In the given environment, set the variable in the given slot to
+    store the given value.
+    @param env Environment in which to store the value.
+    @param slot slot number for the variable to set the value for.
     @param value new value for this variable.
 */
-void setVariable( Environment *env, char const *name, Value value );
+void setVariable( Environment *env, int slot, Value value );
+
+/** Store a value in a variable kept outside any environment, like a
+    local in a program translated to C.  It works just like
+    setVariable(): the variable gets its own reference to a sequence,
+    and its old sequence, if any, is released.
+    @param var variable to store the value in.
+    @param value new value for the variable.
+*/
+void storeValue( Value *var, Value value );
+
+/** Return the environment's array of variable values, indexed by slot,
+    with room for every slot handed out so far.  This is for code that
+    works on the values directly, like compiled loops.  The array can
+    move the next time a variable is set, so it's only good until then.
+    @param env Environment to get the values from.
+    @return values of all the variables, with zero for the ones that
+    haven't been set.
+*/
+Value *variableValues( Environment *env );
 
 /** Free all the memory associated with this environment.
     @param env environment to free memory for.